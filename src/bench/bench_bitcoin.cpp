@@ -5,6 +5,8 @@
 #include <bench/bench.h>
 
 #include <clientversion.h>
+#include <crypto/Lyra2Z/SpongeDispatch.h>
+#include <crypto/scrypt.h>
 #include <crypto/sha256.h>
 #include <fs.h>
 #include <util/strencodings.h>
@@ -62,6 +64,8 @@ int main(int argc, char** argv)
     ArgsManager argsman;
     SetupBenchArgs(argsman);
     SHA256AutoDetect();
+    Lyra2SpongeAutoDetect();
+    scrypt_detect_multi();
     std::string error;
     if (!argsman.ParseParameters(argc, argv, error)) {
         tfm::format(std::cerr, "Error parsing command line arguments: %s\n", error);
@@ -0,0 +1,102 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <kernel/cs_main.h>
+#include <kernel/mempool_entry.h>
+#include <node/miner.h>
+#include <random.h>
+#include <test/util/script.h>
+#include <test/util/setup_common.h>
+#include <txmempool.h>
+#include <validation.h>
+
+#include <vector>
+
+/** Transactions added to the mempool between two template updates. */
+static constexpr size_t TEMPLATE_UPDATE_ADDED{20};
+
+/** Add a transaction to the mempool spending value from prev_hash, returning its txid. */
+static uint256 AddTx(CTxMemPool& pool, const uint256& prev_hash, CAmount value, CAmount fee) EXCLUSIVE_LOCKS_REQUIRED(cs_main, pool.cs)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = CScript() << OP_1;
+    tx.vin[0].prevout = COutPoint{prev_hash, 0};
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    tx.vout[0].nValue = value - fee;
+    LockPoints lp;
+    pool.addUnchecked(CTxMemPoolEntry(MakeTransactionRef(tx), fee, /*time=*/0, /*entry_height=*/1, /*spends_coinbase=*/false, /*sigops_cost=*/4, lp));
+    return tx.GetHash();
+}
+
+/**
+ * Fill the mempool with mempool_size transactions, a quarter of them spending
+ * the one before, then time either assembling a template from scratch or
+ * updating one for TEMPLATE_UPDATE_ADDED more, as getblocktemplate does while
+ * the tip stays the same. Each update starts from a copy of the same template.
+ * The transactions spend coins added to the UTXO set, so that both can end in
+ * TestBlockValidity() as they do in getblocktemplate, or skip it.
+ */
+static void BlockTemplate(benchmark::Bench& bench, size_t mempool_size, bool update, bool test_block_validity)
+{
+    const auto testing_setup{MakeNoLogFileContext<const TestingSetup>()};
+    CTxMemPool& pool{*testing_setup->m_node.mempool};
+    Chainstate& chainstate{testing_setup->m_node.chainman->ActiveChainstate()};
+    node::BlockAssembler::Options options;
+    options.test_block_validity = test_block_validity;
+
+    FastRandomContext det_rand{true};
+    uint256 prev_hash;
+    CAmount prev_value;
+    const auto fill{[&](size_t count) EXCLUSIVE_LOCKS_REQUIRED(cs_main, pool.cs) {
+        std::vector<uint256> txids;
+        for (size_t i = 0; i < count; ++i) {
+            if (txids.empty() || det_rand.randrange(4) != 0) {
+                prev_hash = det_rand.rand256();
+                prev_value = 10 * COIN;
+                chainstate.CoinsTip().AddCoin(COutPoint{prev_hash, 0}, Coin{CTxOut{prev_value, CScript() << OP_TRUE}, /*nHeightIn=*/1, /*fCoinBaseIn=*/false}, /*possible_overwrite=*/false);
+            }
+            const CAmount fee{1000 + static_cast<CAmount>(det_rand.randrange(9000))};
+            prev_hash = AddTx(pool, prev_hash, prev_value, fee);
+            prev_value -= fee;
+            txids.push_back(prev_hash);
+        }
+        return txids;
+    }};
+
+    LOCK(cs_main);
+    WITH_LOCK(pool.cs, return fill(mempool_size));
+    const auto base{node::BlockAssembler{chainstate, &pool, options}.CreateNewBlock(P2WSH_OP_TRUE)};
+    const auto added{WITH_LOCK(pool.cs, return fill(TEMPLATE_UPDATE_ADDED))};
+
+    bench.run([&] {
+        if (update) {
+            auto block_template{node::BlockAssembler{chainstate, &pool, options}.UpdateBlock(std::make_unique<node::CBlockTemplate>(*base), added)};
+            assert(block_template);
+        } else {
+            auto block_template{node::BlockAssembler{chainstate, &pool, options}.CreateNewBlock(P2WSH_OP_TRUE)};
+            assert(block_template);
+        }
+    });
+}
+
+static void BlockTemplateCreate1000(benchmark::Bench& bench) { BlockTemplate(bench, 1000, /*update=*/false, /*test_block_validity=*/false); }
+static void BlockTemplateCreate10000(benchmark::Bench& bench) { BlockTemplate(bench, 10000, /*update=*/false, /*test_block_validity=*/false); }
+static void BlockTemplateUpdate1000(benchmark::Bench& bench) { BlockTemplate(bench, 1000, /*update=*/true, /*test_block_validity=*/false); }
+static void BlockTemplateUpdate10000(benchmark::Bench& bench) { BlockTemplate(bench, 10000, /*update=*/true, /*test_block_validity=*/false); }
+static void BlockTemplateCreateValid1000(benchmark::Bench& bench) { BlockTemplate(bench, 1000, /*update=*/false, /*test_block_validity=*/true); }
+static void BlockTemplateCreateValid10000(benchmark::Bench& bench) { BlockTemplate(bench, 10000, /*update=*/false, /*test_block_validity=*/true); }
+static void BlockTemplateUpdateValid1000(benchmark::Bench& bench) { BlockTemplate(bench, 1000, /*update=*/true, /*test_block_validity=*/true); }
+static void BlockTemplateUpdateValid10000(benchmark::Bench& bench) { BlockTemplate(bench, 10000, /*update=*/true, /*test_block_validity=*/true); }
+
+BENCHMARK(BlockTemplateCreate1000, benchmark::PriorityLevel::HIGH);
+BENCHMARK(BlockTemplateCreate10000, benchmark::PriorityLevel::HIGH);
+BENCHMARK(BlockTemplateUpdate1000, benchmark::PriorityLevel::HIGH);
+BENCHMARK(BlockTemplateUpdate10000, benchmark::PriorityLevel::HIGH);
+BENCHMARK(BlockTemplateCreateValid1000, benchmark::PriorityLevel::HIGH);
+BENCHMARK(BlockTemplateCreateValid10000, benchmark::PriorityLevel::HIGH);
+BENCHMARK(BlockTemplateUpdateValid1000, benchmark::PriorityLevel::HIGH);
+BENCHMARK(BlockTemplateUpdateValid10000, benchmark::PriorityLevel::HIGH);
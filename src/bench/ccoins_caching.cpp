@@ -4,12 +4,20 @@
 
 #include <bench/bench.h>
 #include <coins.h>
+#include <flatmap.h>
 #include <policy/policy.h>
+#include <random.h>
 #include <script/signingprovider.h>
 #include <test/util/transaction_utils.h>
 
+#include <cassert>
+#include <functional>
+#include <unordered_map>
 #include <vector>
 
+/** Coins added to a map and erased again per run of the coins map benchmarks. */
+static constexpr size_t COINS_MAP_ENTRIES{100'000};
+
 // Microbenchmark for simple accesses to a CCoinsViewCache database. Note from
 // laanwj, "replicating the actual usage patterns of the client is hard though,
 // many times micro-benchmarks of the database showed completely different
@@ -50,4 +58,58 @@ static void CCoinsCaching(benchmark::Bench& bench)
     ECC_Stop();
 }
 
+
+/**
+ * Add COINS_MAP_ENTRIES coins to a map, then look them up and erase them
+ * again in another order, as the coins cache does with outputs created and
+ * later spent during IBD. Compares the std::unordered_map used for CCoinsMap,
+ * whose nodes come from a PoolResource, with the same map allocating every
+ * node on its own, and with the open addressing map of USE_FLAT_COINS_MAP.
+ */
+template <typename Map>
+static void CoinsMapChurn(benchmark::Bench& bench, Map& map)
+{
+    FastRandomContext det_rand{true};
+    std::vector<COutPoint> added;
+    for (size_t i = 0; i < COINS_MAP_ENTRIES; ++i) {
+        added.emplace_back(det_rand.rand256(), i % 4);
+    }
+    std::vector<COutPoint> spent{added};
+    Shuffle(spent.begin(), spent.end(), det_rand);
+
+    bench.batch(COINS_MAP_ENTRIES).unit("coin").run([&] {
+        for (const COutPoint& outpoint : added) {
+            map.try_emplace(outpoint);
+        }
+        for (const COutPoint& outpoint : spent) {
+            const auto it{map.find(outpoint)};
+            assert(it != map.end());
+            map.erase(it);
+        }
+    });
+}
+
+static void CCoinsMapStdAllocator(benchmark::Bench& bench)
+{
+    std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> map;
+    CoinsMapChurn(bench, map);
+}
+
+static void CCoinsMapPoolAllocator(benchmark::Bench& bench)
+{
+    CCoinsMapMemoryResource resource;
+    std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher, std::equal_to<COutPoint>, CCoinsMapAllocator> map{0, SaltedOutpointHasher{}, std::equal_to<COutPoint>{}, &resource};
+    CoinsMapChurn(bench, map);
+}
+
+static void CCoinsMapFlat(benchmark::Bench& bench)
+{
+    CCoinsMapMemoryResource resource;
+    FlatHashMap<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher, std::equal_to<COutPoint>, CCoinsMapAllocator> map{0, SaltedOutpointHasher{}, std::equal_to<COutPoint>{}, &resource};
+    CoinsMapChurn(bench, map);
+}
+
 BENCHMARK(CCoinsCaching, benchmark::PriorityLevel::HIGH);
+BENCHMARK(CCoinsMapStdAllocator, benchmark::PriorityLevel::HIGH);
+BENCHMARK(CCoinsMapPoolAllocator, benchmark::PriorityLevel::HIGH);
+BENCHMARK(CCoinsMapFlat, benchmark::PriorityLevel::HIGH);
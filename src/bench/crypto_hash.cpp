@@ -4,8 +4,11 @@
 
 
 #include <bench/bench.h>
+#include <crypto/Lyra2Z/Lyra2.h>
+#include <crypto/Lyra2Z/Lyra2Z.h>
 #include <crypto/muhash.h>
 #include <crypto/ripemd160.h>
+#include <crypto/scrypt.h>
 #include <crypto/sha1.h>
 #include <crypto/sha256.h>
 #include <crypto/sha3.h>
@@ -15,6 +18,8 @@
 #include <random.h>
 #include <uint256.h>
 
+#include <memory>
+
 /* Number of bytes to hash per iteration */
 static const uint64_t BUFFER_SIZE = 1000*1000;
 
@@ -139,6 +144,62 @@ static void MuHashDiv(benchmark::Bench& bench)
     });
 }
 
+static void LYRA2Z_Alloc(benchmark::Bench& bench)
+{
+    uint256 hash;
+    uint256 in{GetRandHash()};
+    bench.run([&] {
+        LYRA2(hash.begin(), 32, in.begin(), 32, in.begin(), 32, 8, LYRA2Z_NROWS, LYRA2Z_NCOLS);
+    });
+}
+
+static void LYRA2Z_Ctx(benchmark::Bench& bench)
+{
+    uint256 hash;
+    uint256 in{GetRandHash()};
+    auto ctx{std::make_unique<lyra2z_ctx>()};
+    bench.run([&] {
+        LYRA2_ctx(ctx.get(), hash.begin(), 32, in.begin(), 32, in.begin(), 32, 8);
+    });
+}
+
+static void LYRA2Z_80b(benchmark::Bench& bench)
+{
+    uint256 hash;
+    std::vector<uint8_t> in(80, 0);
+    bench.run([&] {
+        lyra2z_hash((const char*)in.data(), (char*)hash.begin());
+        in[0] = hash.begin()[0];
+    });
+}
+
+static void SCRYPT_80b(benchmark::Bench& bench)
+{
+    uint256 hash;
+    std::vector<char> in(80, 0);
+    bench.run([&] {
+        scrypt_1024_1_1_256(in.data(), (char*)hash.begin());
+        in[0] = hash.begin()[0];
+    });
+}
+
+static void SCRYPT_80b_multi8(benchmark::Bench& bench)
+{
+    std::vector<uint256> hashes(8);
+    std::vector<std::vector<char>> in(8, std::vector<char>(80, 0));
+    std::vector<const char*> in_ptrs;
+    std::vector<char*> out_ptrs;
+    for (size_t i = 0; i < 8; ++i) {
+        in[i][1] = i;
+        in_ptrs.push_back(in[i].data());
+        out_ptrs.push_back((char*)hashes[i].begin());
+    }
+    bench.batch(8).unit("hash").run([&] {
+        scrypt_1024_1_1_256_multi(in_ptrs.data(), out_ptrs.data(), 8);
+        for (size_t i = 0; i < 8; ++i) in[i][0] = hashes[i].begin()[0];
+    });
+}
+
 static void MuHashPrecompute(benchmark::Bench& bench)
 {
     MuHash3072 acc;
@@ -162,6 +223,12 @@ BENCHMARK(SHA256D64_1024, benchmark::PriorityLevel::HIGH);
 BENCHMARK(FastRandom_32bit, benchmark::PriorityLevel::HIGH);
 BENCHMARK(FastRandom_1bit, benchmark::PriorityLevel::HIGH);
 
+BENCHMARK(LYRA2Z_Alloc, benchmark::PriorityLevel::HIGH);
+BENCHMARK(LYRA2Z_Ctx, benchmark::PriorityLevel::HIGH);
+BENCHMARK(LYRA2Z_80b, benchmark::PriorityLevel::HIGH);
+BENCHMARK(SCRYPT_80b, benchmark::PriorityLevel::HIGH);
+BENCHMARK(SCRYPT_80b_multi8, benchmark::PriorityLevel::HIGH);
+
 BENCHMARK(MuHash, benchmark::PriorityLevel::HIGH);
 BENCHMARK(MuHashMul, benchmark::PriorityLevel::HIGH);
 BENCHMARK(MuHashDiv, benchmark::PriorityLevel::HIGH);
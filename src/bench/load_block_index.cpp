@@ -0,0 +1,80 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <node/blockstorage.h>
+#include <sync.h>
+#include <test/util/setup_common.h>
+#include <txdb.h>
+#include <validation.h>
+#include <versionbits.h>
+
+#include <vector>
+
+/** Block index entries in the synthetic database. */
+static constexpr size_t BLOCK_INDEX_ENTRIES{1'000'000};
+/** Entries per WriteBatchSync while filling the database. */
+static constexpr size_t BLOCK_INDEX_WRITE_BATCH{10'000};
+
+/**
+ * LoadBlockIndexGuts() reads every block index entry at startup. Fill an
+ * in-memory block tree database with a chain of synthetic entries, all with
+ * valid PoW checksums, and measure reading them back into a BlockMap. This is
+ * the part of the restart time that grows with the chain.
+ */
+static void LoadBlockIndexGuts(benchmark::Bench& bench)
+{
+    const auto testing_setup{MakeNoLogFileContext<const BasicTestingSetup>(CBaseChainParams::REGTEST)};
+    const Consensus::Params& consensus{Params().GetConsensus()};
+    CBlockTreeDB block_tree_db{/*nCacheSize=*/8 << 20, /*fMemory=*/true};
+
+    {
+        std::vector<CBlockIndex> entries(BLOCK_INDEX_ENTRIES);
+        std::vector<uint256> hashes(BLOCK_INDEX_ENTRIES);
+        std::vector<const CBlockIndex*> batch;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            CBlockIndex& entry{entries[i]};
+            entry.pprev = i > 0 ? &entries[i - 1] : nullptr;
+            entry.nHeight = i;
+            entry.nStatus = BLOCK_VALID_SCRIPTS | BLOCK_HAVE_DATA | BLOCK_HAVE_UNDO;
+            entry.nFile = i / 1000;
+            entry.nDataPos = (i % 1000) * 1000;
+            entry.nUndoPos = (i % 1000) * 100;
+            entry.nTx = 1 + i % 3000;
+            entry.nVersion = VERSIONBITS_TOP_BITS;
+            entry.nTime = 1524650028 + i * 150;
+            entry.nBits = 0x1b0404cb;
+            entry.nNonce = i;
+            hashes[i] = entry.GetBlockHeader().GetHash();
+            entry.phashBlock = &hashes[i];
+            batch.push_back(&entry);
+            if (batch.size() == BLOCK_INDEX_WRITE_BATCH) {
+                block_tree_db.WriteBatchSync({}, 0, batch);
+                batch.clear();
+            }
+        }
+        block_tree_db.WriteBatchSync({}, 0, batch);
+    }
+
+    bench.epochs(3).epochIterations(1).batch(BLOCK_INDEX_ENTRIES).unit("entry").run([&] {
+        LOCK(cs_main);
+        node::BlockMap::allocator_type::ResourceType resource;
+        node::BlockMap block_index{0, BlockHasher{}, node::BlockMap::key_equal{}, &resource};
+        std::vector<CBlockIndex*> missing_checksum;
+        const bool loaded{block_tree_db.LoadBlockIndexGuts(
+            consensus,
+            [&](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) -> CBlockIndex* {
+                if (hash.IsNull()) return nullptr;
+                const auto [it, inserted]{block_index.try_emplace(hash)};
+                if (inserted) it->second.phashBlock = &it->first;
+                return &it->second;
+            },
+            BlockIndexPoWCheck::NONE, missing_checksum)};
+        assert(loaded && missing_checksum.empty() && block_index.size() == BLOCK_INDEX_ENTRIES);
+    });
+}
+
+BENCHMARK(LoadBlockIndexGuts, benchmark::PriorityLevel::HIGH);
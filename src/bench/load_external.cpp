@@ -4,9 +4,22 @@
 
 #include <bench/bench.h>
 #include <bench/data.h>
+#include <arith_uint256.h>
 #include <chainparams.h>
+#include <consensus/merkle.h>
+#include <node/blockstorage.h>
+#include <pow.h>
+#include <test/util/script.h>
 #include <test/util/setup_common.h>
 #include <validation.h>
+#include <versionbits.h>
+
+#include <vector>
+
+/** Blocks in each chain loaded by LoadExternalBlockFileChain. */
+static constexpr size_t LOAD_CHAIN_BLOCKS{2000};
+/** Distinct chains mined for LoadExternalBlockFileChain, one per epoch. */
+static constexpr size_t LOAD_CHAINS{3};
 
 /**
  * The LoadExternalBlockFile() function is used during -reindex and -loadblock.
@@ -60,4 +73,58 @@ static void LoadExternalBlockFile(benchmark::Bench& bench)
     fs::remove(blkfile);
 }
 
+/**
+ * LoadExternalBlockFile() on a block file of new regtest blocks that all
+ * connect, so that every block is deserialized, checked and accepted as in a
+ * reindex. Each epoch loads a different chain, mined up front with the
+ * minimum difficulty, so that none of the blocks is known yet.
+ */
+static void LoadExternalBlockFileChain(benchmark::Bench& bench)
+{
+    const auto testing_setup{MakeNoLogFileContext<const TestingSetup>(CBaseChainParams::REGTEST, {"-checkblockindex=0"})};
+    const CChainParams& params{testing_setup->m_node.chainman->GetParams()};
+    const Consensus::Params& consensus{params.GetConsensus()};
+    StopScriptCheckWorkerThreads();
+    StartScriptCheckWorkerThreads(std::max(GetNumCores() - 1, 1));
+
+    for (size_t c = 0; c < LOAD_CHAINS; ++c) {
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        CBlock block;
+        block.hashPrevBlock = params.GenesisBlock().GetHash();
+        block.nTime = params.GenesisBlock().nTime;
+        for (size_t height = 1; height <= LOAD_CHAIN_BLOCKS; ++height) {
+            CMutableTransaction coinbase_tx;
+            coinbase_tx.vin.resize(1);
+            coinbase_tx.vin[0].scriptSig = CScript() << height << OP_0 << c;
+            coinbase_tx.vout.resize(1);
+            coinbase_tx.vout[0].scriptPubKey = P2WSH_OP_TRUE;
+            coinbase_tx.vout[0].nValue = GetBlockSubsidy(height, consensus);
+            block.vtx = {MakeTransactionRef(std::move(coinbase_tx))};
+            block.nVersion = VERSIONBITS_TOP_BITS | VERSIONBITS_FORK_LYRA2Z;
+            block.hashMerkleRoot = BlockMerkleRoot(block);
+            block.nTime += 3 * consensus.nPowTargetSpacing;
+            block.nBits = UintToArith256(consensus.powLimit).GetCompact();
+            block.nNonce = 0;
+            while (!CheckProofOfWork(block.GetPoWHash(), block.nBits, consensus)) ++block.nNonce;
+            ss << params.MessageStart() << static_cast<uint32_t>(::GetSerializeSize(block, CLIENT_VERSION)) << block;
+            block.hashPrevBlock = block.GetHash();
+        }
+        FILE* file{fsbridge::fopen(node::GetBlockPosFilename(FlatFilePos(1 + c, 0)), "wb")};
+        if (fwrite(ss.data(), 1, ss.size(), file) != ss.size()) {
+            throw std::runtime_error("write to test file failed\n");
+        }
+        fclose(file);
+    }
+
+    Chainstate& chainstate{testing_setup->m_node.chainman->ActiveChainstate()};
+    std::multimap<uint256, FlatFilePos> blocks_with_unknown_parent;
+    size_t next{0};
+    bench.epochs(LOAD_CHAINS).epochIterations(1).batch(LOAD_CHAIN_BLOCKS).unit("block").run([&] {
+        FlatFilePos pos(1 + next++ % LOAD_CHAINS, 0);
+        FILE* file{fsbridge::fopen(node::GetBlockPosFilename(pos), "rb")};
+        chainstate.LoadExternalBlockFile(file, &pos, &blocks_with_unknown_parent);
+    });
+}
+
 BENCHMARK(LoadExternalBlockFile, benchmark::PriorityLevel::HIGH);
+BENCHMARK(LoadExternalBlockFileChain, benchmark::PriorityLevel::HIGH);
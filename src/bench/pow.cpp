@@ -0,0 +1,124 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <arith_uint256.h>
+#include <bench/bench.h>
+#include <chainparams.h>
+#include <checkqueue.h>
+#include <consensus/params.h>
+#include <consensus/validation.h>
+#include <pow.h>
+#include <primitives/block.h>
+#include <test/util/setup_common.h>
+#include <util/system.h>
+#include <validation.h>
+#include <versionbits.h>
+
+#include <vector>
+
+/** Headers per ProcessNewBlockHeaders call, the most a headers message carries. */
+static constexpr size_t HEADERS_BATCH{2000};
+/** Distinct header chains mined for ProcessNewBlockHeaders, one per epoch. */
+static constexpr size_t HEADERS_CHAINS{5};
+/** Headers checked per run of the PoW check queue benchmarks. */
+static constexpr size_t POW_QUEUE_HEADERS{64 * MAX_POW_CHECK_HEADERS};
+
+static void PoWHash(benchmark::Bench& bench, int32_t version)
+{
+    CBlockHeader header;
+    header.nVersion = version;
+    bench.run([&] {
+        const uint256 hash{header.GetPoWHash()};
+        header.nNonce = hash.GetUint64(0);
+    });
+}
+
+static void PoWHash_Lyra2Z(benchmark::Bench& bench) { PoWHash(bench, VERSIONBITS_TOP_BITS | VERSIONBITS_FORK_LYRA2Z); }
+static void PoWHash_Scrypt(benchmark::Bench& bench) { PoWHash(bench, VERSIONBITS_TOP_BITS); }
+
+/**
+ * Throughput of checking header PoW on a CCheckQueue<CPoWCheck>, as done when
+ * loading the block index and for headers messages. The target lets all but
+ * about one in 65536 headers pass; a failure only ends that run a bit early.
+ */
+static void PoWCheckQueue(benchmark::Bench& bench, int32_t version)
+{
+    // We shouldn't ever be running with the checkqueue on a single core machine.
+    if (GetNumCores() <= 1) return;
+
+    Consensus::Params params;
+    params.powLimit = ArithToUint256(~arith_uint256{});
+    CCheckQueue<CPoWCheck> queue{8};
+    // The main thread should be counted to prevent thread oversubscription.
+    queue.StartWorkerThreads(GetNumCores() - 1);
+
+    CBlockHeader header;
+    header.nVersion = version;
+    header.nBits = 0x2100ffff;
+    bench.batch(POW_QUEUE_HEADERS).unit("header").run([&] {
+        // New headers every run, so the PoW cache never answers.
+        ++header.nTime;
+        std::vector<CPoWCheck> checks;
+        for (size_t i = 0; i < POW_QUEUE_HEADERS; i += MAX_POW_CHECK_HEADERS) {
+            std::vector<CBlockHeader> headers;
+            for (size_t j = 0; j < MAX_POW_CHECK_HEADERS; ++j) {
+                header.nNonce = i + j;
+                headers.push_back(header);
+            }
+            checks.emplace_back(std::move(headers), params);
+        }
+        CCheckQueueControl<CPoWCheck> control(&queue);
+        control.Add(checks);
+        control.Wait();
+    });
+    queue.StopWorkerThreads();
+}
+
+static void PoWCheckQueue_Lyra2Z(benchmark::Bench& bench) { PoWCheckQueue(bench, VERSIONBITS_TOP_BITS | VERSIONBITS_FORK_LYRA2Z); }
+static void PoWCheckQueue_Scrypt(benchmark::Bench& bench) { PoWCheckQueue(bench, VERSIONBITS_TOP_BITS); }
+
+/**
+ * ProcessNewBlockHeaders on a full headers message of new regtest headers.
+ * Every header is spaced more than two target spacings apart so that it is
+ * allowed the minimum difficulty. Each epoch submits a different chain, mined
+ * up front, so that none of the headers is already known.
+ */
+static void ProcessNewBlockHeaders(benchmark::Bench& bench)
+{
+    const auto testing_setup{MakeNoLogFileContext<const TestingSetup>(CBaseChainParams::REGTEST, {"-checkblockindex=0"})};
+    ChainstateManager& chainman{*testing_setup->m_node.chainman};
+    const Consensus::Params& consensus{chainman.GetConsensus()};
+    StopScriptCheckWorkerThreads();
+    StartScriptCheckWorkerThreads(std::max(GetNumCores() - 1, 1));
+
+    const CBlockHeader genesis{chainman.GetParams().GenesisBlock().GetBlockHeader()};
+    std::vector<std::vector<CBlockHeader>> chains(HEADERS_CHAINS);
+    for (size_t c = 0; c < chains.size(); ++c) {
+        CBlockHeader header;
+        header.nVersion = VERSIONBITS_TOP_BITS | VERSIONBITS_FORK_LYRA2Z;
+        header.hashPrevBlock = genesis.GetHash();
+        header.nTime = genesis.nTime + c;
+        header.nBits = UintToArith256(consensus.powLimit).GetCompact();
+        for (size_t i = 0; i < HEADERS_BATCH; ++i) {
+            header.nTime += 3 * consensus.nPowTargetSpacing;
+            header.nNonce = 0;
+            while (!CheckProofOfWork(header.GetPoWHash(), header.nBits, consensus)) ++header.nNonce;
+            chains[c].push_back(header);
+            header.hashPrevBlock = header.GetHash();
+        }
+    }
+
+    size_t next{0};
+    bench.epochs(chains.size()).epochIterations(1).batch(HEADERS_BATCH).unit("header").run([&] {
+        BlockValidationState state;
+        const bool accepted{chainman.ProcessNewBlockHeaders(chains[next++ % chains.size()], /*min_pow_checked=*/true, state)};
+        assert(accepted);
+    });
+}
+
+BENCHMARK(PoWHash_Lyra2Z, benchmark::PriorityLevel::HIGH);
+BENCHMARK(PoWHash_Scrypt, benchmark::PriorityLevel::HIGH);
+BENCHMARK(PoWCheckQueue_Lyra2Z, benchmark::PriorityLevel::HIGH);
+BENCHMARK(PoWCheckQueue_Scrypt, benchmark::PriorityLevel::HIGH);
+BENCHMARK(ProcessNewBlockHeaders, benchmark::PriorityLevel::HIGH);
@@ -150,8 +150,11 @@ enum BlockStatus : uint32_t {
 class CBlockIndex
 {
 public:
-    //! pointer to the hash of the block, if any. Memory is owned by this CBlockIndex
-    const uint256* phashBlock{nullptr};
+    // Members are ordered by how often they are read: those used when walking
+    // the tree (GetAncestor(), LastCommonAncestor()) and comparing entries come
+    // first, in the first 64 bytes; disk positions and the header last. In a
+    // BlockMap node these come after the next pointer and the 32-byte key, so
+    // they usually span two cache lines rather than one.
 
     //! pointer to the index of the predecessor of this block
     CBlockIndex* pprev{nullptr};
@@ -162,24 +165,19 @@ public:
     //! height of the entry in the chain. The genesis block has height 0
     int nHeight{0};
 
-    //! Which # file this block is stored in (blk?????.dat)
-    int nFile GUARDED_BY(::cs_main){0};
-
-    //! Byte offset within blk?????.dat where this block's data is stored
-    unsigned int nDataPos GUARDED_BY(::cs_main){0};
-
-    //! Byte offset within rev?????.dat where this block's undo data is stored
-    unsigned int nUndoPos GUARDED_BY(::cs_main){0};
+    //! Verification status of this block. See enum BlockStatus
+    //!
+    //! Note: this value is modified to show BLOCK_OPT_WITNESS during UTXO snapshot
+    //! load to avoid the block index being spuriously rewound.
+    //! @sa NeedsRedownload
+    //! @sa ActivateSnapshot
+    uint32_t nStatus GUARDED_BY(::cs_main){0};
 
     //! (memory only) Total amount of work (expected number of hashes) in the chain up to and including this block
     arith_uint256 nChainWork{};
 
-    //! Number of transactions in this block.
-    //! Note: in a potential headers-first mode, this number cannot be relied upon
-    //! Note: this value is faked during UTXO snapshot load to ensure that
-    //! LoadBlockIndex() will load index entries for blocks that we lack data for.
-    //! @sa ActivateSnapshot
-    unsigned int nTx{0};
+    //! (memory only) Sequential id assigned to distinguish order in which blocks are received.
+    int32_t nSequenceId{0};
 
     //! (memory only) Number of transactions in the chain up to and including this block.
     //! This value will be non-zero only if and only if transactions for this block and all its parents are available.
@@ -191,13 +189,27 @@ public:
     //! @sa ActivateSnapshot
     unsigned int nChainTx{0};
 
-    //! Verification status of this block. See enum BlockStatus
-    //!
-    //! Note: this value is modified to show BLOCK_OPT_WITNESS during UTXO snapshot
-    //! load to avoid the block index being spuriously rewound.
-    //! @sa NeedsRedownload
+    //! pointer to the hash of the block, if any. Memory is owned by this CBlockIndex
+    const uint256* phashBlock{nullptr};
+
+    //! Which # file this block is stored in (blk?????.dat)
+    int nFile GUARDED_BY(::cs_main){0};
+
+    //! Byte offset within blk?????.dat where this block's data is stored
+    unsigned int nDataPos GUARDED_BY(::cs_main){0};
+
+    //! Byte offset within rev?????.dat where this block's undo data is stored
+    unsigned int nUndoPos GUARDED_BY(::cs_main){0};
+
+    //! Number of transactions in this block.
+    //! Note: in a potential headers-first mode, this number cannot be relied upon
+    //! Note: this value is faked during UTXO snapshot load to ensure that
+    //! LoadBlockIndex() will load index entries for blocks that we lack data for.
     //! @sa ActivateSnapshot
-    uint32_t nStatus GUARDED_BY(::cs_main){0};
+    unsigned int nTx{0};
+
+    //! (memory only) Maximum nTime in the chain up to and including this block.
+    unsigned int nTimeMax{0};
 
     //! block header
     int32_t nVersion{0};
@@ -206,12 +218,6 @@ public:
     uint32_t nBits{0};
     uint32_t nNonce{0};
 
-    //! (memory only) Sequential id assigned to distinguish order in which blocks are received.
-    int32_t nSequenceId{0};
-
-    //! (memory only) Maximum nTime in the chain up to and including this block.
-    unsigned int nTimeMax{0};
-
     explicit CBlockIndex(const CBlockHeader& block)
         : nVersion{block.nVersion},
           hashMerkleRoot{block.hashMerkleRoot},
@@ -420,7 +426,7 @@ public:
         READWRITE(obj.nNonce);
     }
 
-    uint256 ConstructBlockHash() const
+    CBlockHeader ConstructBlockHeader() const
     {
         CBlockHeader block;
         block.nVersion = nVersion;
@@ -429,7 +435,12 @@ public:
         block.nTime = nTime;
         block.nBits = nBits;
         block.nNonce = nNonce;
-        return block.GetHash();
+        return block;
+    }
+
+    uint256 ConstructBlockHash() const
+    {
+        return ConstructBlockHeader().GetHash();
     }
 
     uint256 GetBlockHash() = delete;
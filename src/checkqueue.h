@@ -11,6 +11,7 @@
 #include <util/threadnames.h>
 
 #include <algorithm>
+#include <string>
 #include <vector>
 
 template <typename T>
@@ -139,8 +140,9 @@ public:
     {
     }
 
-    //! Create a pool of new worker threads.
-    void StartWorkerThreads(const int threads_num) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    //! Create a pool of new worker threads, named "<thread_name>.<N>" and restricted to the syscalls of policy.
+    void StartWorkerThreads(const int threads_num, const std::string& thread_name = "scriptch",
+                            const SyscallSandboxPolicy policy = SyscallSandboxPolicy::VALIDATION_SCRIPT_CHECK) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
     {
         {
             LOCK(m_mutex);
@@ -150,9 +152,9 @@ public:
         }
         assert(m_worker_threads.empty());
         for (int n = 0; n < threads_num; ++n) {
-            m_worker_threads.emplace_back([this, n]() {
-                util::ThreadRename(strprintf("scriptch.%i", n));
-                SetSyscallSandboxPolicy(SyscallSandboxPolicy::VALIDATION_SCRIPT_CHECK);
+            m_worker_threads.emplace_back([this, n, thread_name, policy]() {
+                util::ThreadRename(strprintf("%s.%i", thread_name, n));
+                SetSyscallSandboxPolicy(policy);
                 Loop(false /* worker thread */);
             });
         }
@@ -241,8 +243,11 @@ public:
 
     void Add(std::vector<T>& vChecks)
     {
-        if (pqueue != nullptr)
+        if (pqueue != nullptr && !vChecks.empty()) {
             pqueue->Add(vChecks);
+            // checks added after an intermediate Wait() must still be waited for
+            fDone = false;
+        }
     }
 
     ~CCheckQueueControl()
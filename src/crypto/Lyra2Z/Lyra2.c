@@ -31,6 +31,9 @@
  * integer parameters (treated as type "unsigned int") in the order they are provided, plus the value
  * of nCols, (i.e., basil = kLen || pwdlen || saltlen || timeCost || nRows || nCols).
  *
+ * @param wholeMatrix Scratch space for the memory matrix: nRows * nCols * BLOCK_LEN_INT64 words
+ * @param memMatrix Scratch space for nRows row pointers into wholeMatrix
+ * @param state Scratch space for the 16-word sponge state
  * @param K The derived key to be output by the algorithm
  * @param kLen Desired key length
  * @param pwd User password
@@ -40,10 +43,8 @@
  * @param timeCost Parameter to determine the processing time (T)
  * @param nRows Number or rows of the memory matrix (R)
  * @param nCols Number of columns of the memory matrix (C)
- *
- * @return 0 if the key is generated correctly; -1 if there is an error (usually due to lack of memory for allocation)
  */
-int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols) {
+static void LYRA2_core(uint64_t *wholeMatrix, uint64_t **memMatrix, uint64_t *state, void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols) {
 
     //============================= Basic variables ============================//
     int64_t row = 2; //index of row to be processed
@@ -56,30 +57,14 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
     int64_t i; //auxiliary iteration counter
     //==========================================================================/
 
-    //========== Initializing the Memory Matrix and pointers to it =============//
-    //Tries to allocate enough space for the whole memory matrix
-
-
+    //======================= Initializing the Memory Matrix ===================//
+    //The caller provides nRows rows of BLOCK_LEN_INT64 * nCols words each, and
+    //the pointers to them in memMatrix
     const int64_t ROW_LEN_INT64 = BLOCK_LEN_INT64 * nCols;
-    const int64_t ROW_LEN_BYTES = ROW_LEN_INT64 * 8;
-
-    i = (int64_t) ((int64_t) nRows * (int64_t) ROW_LEN_BYTES);
-    uint64_t *wholeMatrix = malloc(i);
-    if (wholeMatrix == NULL) {
-      return -1;
-    }
-    memset(wholeMatrix, 0, i);
-
-    //Allocates pointers to each row of the matrix
-    uint64_t **memMatrix = malloc(nRows * sizeof (uint64_t*));
-    if (memMatrix == NULL) {
-      return -1;
-    }
-    //Places the pointers in the correct positions
-    uint64_t *ptrWord = wholeMatrix;
+    memset(wholeMatrix, 0, nRows * ROW_LEN_INT64 * sizeof (uint64_t));
+    uint64_t *ptrWord;
     for (i = 0; i < nRows; i++) {
-      memMatrix[i] = ptrWord;
-      ptrWord += ROW_LEN_INT64;
+      memMatrix[i] = wholeMatrix + i * ROW_LEN_INT64;
     }
     //==========================================================================/
 
@@ -123,10 +108,6 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
 
     //======================= Initializing the Sponge State ====================//
     //Sponge state: 16 uint64_t, BLOCK_LEN_INT64 words of them for the bitrate (b) and the remainder for the capacity (c)
-    uint64_t *state = malloc(16 * sizeof (uint64_t));
-    if (state == NULL) {
-      return -1;
-    }
     initState(state);
     //==========================================================================/
 
@@ -139,12 +120,12 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
     }
 
     //Initializes M[0] and M[1]
-    reducedSqueezeRow0(state, memMatrix[0], nCols); //The locally copied password is most likely overwritten here
-    reducedDuplexRow1(state, memMatrix[0], memMatrix[1], nCols);
+    lyra2_sponge.reducedSqueezeRow0(state, memMatrix[0], nCols); //The locally copied password is most likely overwritten here
+    lyra2_sponge.reducedDuplexRow1(state, memMatrix[0], memMatrix[1], nCols);
 
     do {
       //M[row] = rand; //M[row*] = M[row*] XOR rotW(rand)
-      reducedDuplexRowSetup(state, memMatrix[prev], memMatrix[rowa], memMatrix[row], nCols);
+      lyra2_sponge.reducedDuplexRowSetup(state, memMatrix[prev], memMatrix[rowa], memMatrix[row], nCols);
 
 
       //updates the value of row* (deterministically picked during Setup))
@@ -177,7 +158,7 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
         //------------------------------------------------------------------------------------------
 
         //Performs a reduced-round duplexing operation over M[row*] XOR M[prev], updating both M[row*] and M[row]
-        reducedDuplexRow(state, memMatrix[prev], memMatrix[rowa], memMatrix[row], nCols);
+        lyra2_sponge.reducedDuplexRow(state, memMatrix[prev], memMatrix[rowa], memMatrix[row], nCols);
 
         //update prev: it now points to the last row ever computed
         prev = row;
@@ -200,15 +181,39 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
     squeeze(state, K, kLen);
     //==========================================================================/
 
-    //========================= Freeing the memory =============================//
-    free(memMatrix);
-    free(wholeMatrix);
-
-    //Wiping out the sponge's internal state before freeing it
+    //Wiping out the sponge's internal state
     memset(state, 0, 16 * sizeof (uint64_t));
+}
+
+/**
+ * Executes Lyra2 on a freshly allocated memory matrix. See LYRA2_core for the parameters.
+ *
+ * @return 0 if the key is generated correctly; -1 if there is an error (usually due to lack of memory for allocation)
+ */
+int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols) {
+    uint64_t *wholeMatrix = malloc(nRows * BLOCK_LEN_INT64 * nCols * sizeof (uint64_t));
+    uint64_t **memMatrix = malloc(nRows * sizeof (uint64_t*));
+    uint64_t *state = malloc(16 * sizeof (uint64_t));
+    int ret = -1;
+    if (wholeMatrix != NULL && memMatrix != NULL && state != NULL) {
+      LYRA2_core(wholeMatrix, memMatrix, state, K, kLen, pwd, pwdlen, salt, saltlen, timeCost, nRows, nCols);
+      ret = 0;
+    }
     free(state);
-    //==========================================================================/
+    free(memMatrix);
+    free(wholeMatrix);
+    return ret;
+}
 
+/**
+ * Executes Lyra2 with the fixed Lyra2Z matrix dimensions (LYRA2Z_NROWS x LYRA2Z_NCOLS),
+ * using the scratch space in ctx instead of allocating it.
+ *
+ * @return 0 (the function cannot fail)
+ */
+int LYRA2_ctx(lyra2z_ctx *ctx, void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost) {
+    uint64_t *memMatrix[LYRA2Z_NROWS];
+    LYRA2_core(ctx->matrix, memMatrix, ctx->state, K, kLen, pwd, pwdlen, salt, saltlen, timeCost, LYRA2Z_NROWS, LYRA2Z_NCOLS);
     return 0;
 }
 
@@ -37,10 +37,33 @@ typedef unsigned char byte;
         #define BLOCK_LEN_BYTES (BLOCK_LEN_INT64 * 8)    //Block length, in bytes
 #endif
 
+//Memory matrix dimensions used by Lyra2Z
+#define LYRA2Z_NROWS 8
+#define LYRA2Z_NCOLS 8
+#define LYRA2Z_MATRIX_INT64 (LYRA2Z_NROWS * LYRA2Z_NCOLS * BLOCK_LEN_INT64)
+
+#if defined(__GNUC__)
+#define LYRA2_CACHELINE_ALIGN __attribute__ ((aligned(64)))
+#elif defined(_MSC_VER)
+#define LYRA2_CACHELINE_ALIGN __declspec(align(64))
+#else
+#define LYRA2_CACHELINE_ALIGN
+#endif
+
+/**
+ * Caller-owned scratch space for LYRA2_ctx, so hashing with the fixed Lyra2Z
+ * parameters does not go through the allocator. Holds no state between calls.
+ */
+typedef struct lyra2z_ctx {
+    LYRA2_CACHELINE_ALIGN uint64_t matrix[LYRA2Z_MATRIX_INT64];
+    LYRA2_CACHELINE_ALIGN uint64_t state[16];
+} lyra2z_ctx;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+    int LYRA2_ctx(lyra2z_ctx *ctx, void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost);
     int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols);
 
 #ifdef __cplusplus
@@ -35,6 +35,9 @@
 #include "sph_blake.h"
 #include "Lyra2.h"
 
+/* Per-thread scratch space, so that hashing does not allocate */
+static _Thread_local lyra2z_ctx lyra2z_thread_ctx;
+
 void lyra2z_hash(const char* input, char* output)
 {
     sph_blake256_context     ctx_blake;
@@ -45,8 +48,27 @@ void lyra2z_hash(const char* input, char* output)
     sph_blake256 (&ctx_blake, input, 80);
     sph_blake256_close (&ctx_blake, hashA);	
 	
-	LYRA2(hashB, 32, hashA, 32, hashA, 32, 8, 8, 8);
+	LYRA2_ctx(&lyra2z_thread_ctx, hashB, 32, hashA, 32, hashA, 32, 8);
 	
 	memcpy(output, hashB, 32);
 }
 
+void lyra2z_midstate_init(lyra2z_midstate* midstate, const char* input)
+{
+    sph_blake256_init(midstate);
+    sph_blake256(midstate, input, 64);
+}
+
+void lyra2z_hash_midstate(const lyra2z_midstate* midstate, const char* input, char* output)
+{
+    sph_blake256_context     ctx_blake = *midstate;
+
+    uint32_t hashA[8], hashB[8];
+
+    sph_blake256 (&ctx_blake, input + 64, 16);
+    sph_blake256_close (&ctx_blake, hashA);
+
+	LYRA2_ctx(&lyra2z_thread_ctx, hashB, 32, hashA, 32, hashA, 32, 8);
+
+	memcpy(output, hashB, 32);
+}
@@ -1,12 +1,22 @@
 #ifndef LYRA2RE_H
 #define LYRA2RE_H
 
+#include "sph_blake.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 void lyra2z_hash(const char* input, char* output);
 
+/* Blake256 state after the first 64 bytes of an 80-byte header. The nonce is
+ * in the last 16 bytes, so a miner computes this once per header template. */
+typedef sph_blake256_context lyra2z_midstate;
+
+void lyra2z_midstate_init(lyra2z_midstate* midstate, const char* input);
+/* lyra2z_hash() of input, whose first 64 bytes are those midstate was made from */
+void lyra2z_hash_midstate(const lyra2z_midstate* midstate, const char* input, char* output);
+
 #ifdef __cplusplus
 }
 #endif
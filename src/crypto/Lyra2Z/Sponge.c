@@ -393,6 +393,21 @@ inline void reducedDuplexRow(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOu
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+const lyra2_sponge_impl lyra2_sponge_generic = {
+    reducedSqueezeRow0,
+    reducedDuplexRow1,
+    reducedDuplexRowSetup,
+    reducedDuplexRow,
+};
+
+lyra2_sponge_impl lyra2_sponge = {
+    reducedSqueezeRow0,
+    reducedDuplexRow1,
+    reducedDuplexRowSetup,
+    reducedDuplexRow,
+};
+
+
 /**
  * Performs a duplex operation over "M[rowInOut] [+] M[rowIn]", writing the output "rand"
  * on M[rowOut] and making "M[rowInOut] =  M[rowInOut] XOR rotW(rand)", where rotW is a 64-bit
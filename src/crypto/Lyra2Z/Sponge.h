@@ -73,6 +73,10 @@ static inline uint64_t rotr64( const uint64_t w, const unsigned c ){
     G(r,7,v[ 3],v[ 4],v[ 9],v[14]);
 
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 //---- Housekeeping
 void initState(uint64_t state[/*16*/]);
 
@@ -92,6 +96,26 @@ void reducedDuplexRow(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint
 //---- Misc
 void printArray(unsigned char *array, unsigned int size, char *name);
 
+//---- Dispatch
+/**
+ * The reduced-round row operations, which account for nearly all of the work in
+ * Lyra2. lyra2_sponge points at the portable implementations above until
+ * Lyra2SpongeAutoDetect() selects a vectorized one for the running CPU.
+ */
+typedef struct lyra2_sponge_impl {
+    void (*reducedSqueezeRow0)(uint64_t* state, uint64_t* rowOut, uint64_t nCols);
+    void (*reducedDuplexRow1)(uint64_t *state, uint64_t *rowIn, uint64_t *rowOut, uint64_t nCols);
+    void (*reducedDuplexRowSetup)(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint64_t *rowOut, uint64_t nCols);
+    void (*reducedDuplexRow)(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint64_t *rowOut, uint64_t nCols);
+} lyra2_sponge_impl;
+
+extern const lyra2_sponge_impl lyra2_sponge_generic;
+extern lyra2_sponge_impl lyra2_sponge;
+
+#ifdef __cplusplus
+}
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////////////////////
 
 
@@ -0,0 +1,110 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#if defined(HAVE_CONFIG_H)
+#include <config/bitcoin-config.h>
+#endif
+
+#include <crypto/Lyra2Z/SpongeDispatch.h>
+
+#include <crypto/Lyra2Z/Lyra2Z.h>
+#include <crypto/Lyra2Z/Sponge.h>
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <compat/cpuid.h>
+
+#if defined(ENABLE_SSE41) && !defined(BUILD_BITCOIN_INTERNAL)
+namespace lyra2_sse41
+{
+void ReducedSqueezeRow0(uint64_t* state, uint64_t* rowOut, uint64_t nCols);
+void ReducedDuplexRow1(uint64_t* state, uint64_t* rowIn, uint64_t* rowOut, uint64_t nCols);
+void ReducedDuplexRowSetup(uint64_t* state, uint64_t* rowIn, uint64_t* rowInOut, uint64_t* rowOut, uint64_t nCols);
+void ReducedDuplexRow(uint64_t* state, uint64_t* rowIn, uint64_t* rowInOut, uint64_t* rowOut, uint64_t nCols);
+}
+#endif
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+namespace lyra2_avx2
+{
+void ReducedSqueezeRow0(uint64_t* state, uint64_t* rowOut, uint64_t nCols);
+void ReducedDuplexRow1(uint64_t* state, uint64_t* rowIn, uint64_t* rowOut, uint64_t nCols);
+void ReducedDuplexRowSetup(uint64_t* state, uint64_t* rowIn, uint64_t* rowInOut, uint64_t* rowOut, uint64_t nCols);
+void ReducedDuplexRow(uint64_t* state, uint64_t* rowIn, uint64_t* rowInOut, uint64_t* rowOut, uint64_t nCols);
+}
+#endif
+
+namespace {
+
+bool SelfTest()
+{
+    // lyra2z_hash of the 80 bytes 0x00, 0x07, 0x0e, ..., as computed by the portable implementation.
+    static const unsigned char result[32] = {
+        0xd5, 0x89, 0xa5, 0x6f, 0x62, 0xa6, 0x5a, 0xb1, 0x3b, 0x81, 0x6d, 0x35, 0x31, 0x51, 0x8c, 0xd8,
+        0xe7, 0xa5, 0x3c, 0x11, 0x4b, 0xe0, 0x52, 0x26, 0x94, 0x88, 0xb4, 0x73, 0x56, 0x3e, 0x55, 0x35,
+    };
+    unsigned char in[80];
+    for (int i = 0; i < 80; ++i) in[i] = i * 7;
+    unsigned char out[32];
+    lyra2z_hash((const char*)in, (char*)out);
+    return memcmp(out, result, sizeof(out)) == 0;
+}
+
+#if defined(HAVE_GETCPUID) && defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+/** Check whether the OS has enabled AVX registers. */
+bool AVXEnabled()
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return (a & 6) == 6;
+}
+#endif
+} // namespace
+
+std::string Lyra2SpongeAutoDetect()
+{
+    std::string ret = "standard";
+    lyra2_sponge = lyra2_sponge_generic;
+#if defined(HAVE_GETCPUID)
+    uint32_t eax, ebx, ecx, edx;
+    GetCPUID(1, 0, eax, ebx, ecx, edx);
+    [[maybe_unused]] const bool have_sse41 = (ecx >> 19) & 1;
+    [[maybe_unused]] const bool have_ssse3 = (ecx >> 9) & 1;
+    [[maybe_unused]] const bool have_xsave = (ecx >> 27) & 1;
+    [[maybe_unused]] const bool have_avx = (ecx >> 28) & 1;
+
+#if defined(ENABLE_SSE41) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_sse41 && have_ssse3) {
+        lyra2_sponge = lyra2_sponge_impl{
+            lyra2_sse41::ReducedSqueezeRow0,
+            lyra2_sse41::ReducedDuplexRow1,
+            lyra2_sse41::ReducedDuplexRowSetup,
+            lyra2_sse41::ReducedDuplexRow,
+        };
+        ret = "sse41";
+    }
+#endif
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_xsave && have_avx && AVXEnabled()) {
+        GetCPUID(7, 0, eax, ebx, ecx, edx);
+        const bool have_avx2 = (ebx >> 5) & 1;
+        if (have_avx2) {
+            lyra2_sponge = lyra2_sponge_impl{
+                lyra2_avx2::ReducedSqueezeRow0,
+                lyra2_avx2::ReducedDuplexRow1,
+                lyra2_avx2::ReducedDuplexRowSetup,
+                lyra2_avx2::ReducedDuplexRow,
+            };
+            ret = "avx2";
+        }
+    }
+#endif
+#endif // defined(HAVE_GETCPUID)
+
+    assert(SelfTest());
+    return ret;
+}
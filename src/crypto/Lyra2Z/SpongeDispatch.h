@@ -0,0 +1,14 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_LYRA2Z_SPONGEDISPATCH_H
+#define BITCOIN_CRYPTO_LYRA2Z_SPONGEDISPATCH_H
+
+#include <string>
+
+/** Autodetect the best available Lyra2 sponge implementation.
+ *  Returns the name of the implementation. */
+std::string Lyra2SpongeAutoDetect();
+
+#endif // BITCOIN_CRYPTO_LYRA2Z_SPONGEDISPATCH_H
@@ -0,0 +1,174 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// Lyra2 reduced-round row operations using AVX2 intrinsics.
+// These compute exactly the same as the portable versions in Sponge.c.
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include <crypto/Lyra2Z/Lyra2.h>
+
+namespace lyra2_avx2 {
+namespace {
+
+/** The 16-word sponge state as four 4-word rows a, b, c and d. */
+struct State {
+    __m256i v[4];
+};
+
+__m256i inline Load(const uint64_t* p) { return _mm256_loadu_si256((const __m256i*)p); }
+void inline Store(uint64_t* p, __m256i x) { _mm256_storeu_si256((__m256i*)p, x); }
+
+__m256i inline Add(__m256i x, __m256i y) { return _mm256_add_epi64(x, y); }
+__m256i inline Xor(__m256i x, __m256i y) { return _mm256_xor_si256(x, y); }
+__m256i inline RotR32(__m256i x) { return _mm256_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)); }
+__m256i inline RotR24(__m256i x)
+{
+    return _mm256_shuffle_epi8(x, _mm256_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10,
+                                                   3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10));
+}
+__m256i inline RotR16(__m256i x)
+{
+    return _mm256_shuffle_epi8(x, _mm256_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9,
+                                                   2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9));
+}
+__m256i inline RotR63(__m256i x) { return Xor(_mm256_srli_epi64(x, 63), Add(x, x)); }
+
+/** Blake2b's G function on all four columns (or diagonals) at once. */
+void inline __attribute__((always_inline)) G(__m256i& a, __m256i& b, __m256i& c, __m256i& d)
+{
+    a = Add(a, b);
+    d = RotR32(Xor(d, a));
+    c = Add(c, d);
+    b = RotR24(Xor(b, c));
+    a = Add(a, b);
+    d = RotR16(Xor(d, a));
+    c = Add(c, d);
+    b = RotR63(Xor(b, c));
+}
+
+/** One round of Blake2b's compression function (ROUND_LYRA). */
+void inline __attribute__((always_inline)) Round(State& s)
+{
+    G(s.v[0], s.v[1], s.v[2], s.v[3]);
+    // Diagonals: rotate b, c and d left by 1, 2 and 3 words
+    s.v[1] = _mm256_permute4x64_epi64(s.v[1], _MM_SHUFFLE(0, 3, 2, 1));
+    s.v[2] = _mm256_permute4x64_epi64(s.v[2], _MM_SHUFFLE(1, 0, 3, 2));
+    s.v[3] = _mm256_permute4x64_epi64(s.v[3], _MM_SHUFFLE(2, 1, 0, 3));
+    G(s.v[0], s.v[1], s.v[2], s.v[3]);
+    s.v[1] = _mm256_permute4x64_epi64(s.v[1], _MM_SHUFFLE(2, 1, 0, 3));
+    s.v[2] = _mm256_permute4x64_epi64(s.v[2], _MM_SHUFFLE(1, 0, 3, 2));
+    s.v[3] = _mm256_permute4x64_epi64(s.v[3], _MM_SHUFFLE(0, 3, 2, 1));
+}
+
+State inline LoadState(const uint64_t* state)
+{
+    State s;
+    for (int i = 0; i < 4; ++i) s.v[i] = Load(state + 4 * i);
+    return s;
+}
+
+void inline SaveState(uint64_t* state, const State& s)
+{
+    for (int i = 0; i < 4; ++i) Store(state + 4 * i, s.v[i]);
+}
+
+/** The first BLOCK_LEN_INT64 words of the state, rotated right by one word (rotW). */
+void inline RotW(const State& s, __m256i r[3])
+{
+    const __m256i a = _mm256_permute4x64_epi64(s.v[0], _MM_SHUFFLE(2, 1, 0, 3));
+    const __m256i b = _mm256_permute4x64_epi64(s.v[1], _MM_SHUFFLE(2, 1, 0, 3));
+    const __m256i c = _mm256_permute4x64_epi64(s.v[2], _MM_SHUFFLE(2, 1, 0, 3));
+    r[0] = _mm256_blend_epi32(a, c, 0x03);
+    r[1] = _mm256_blend_epi32(b, a, 0x03);
+    r[2] = _mm256_blend_epi32(c, b, 0x03);
+}
+
+} // namespace
+
+void ReducedSqueezeRow0(uint64_t* state, uint64_t* rowOut, uint64_t nCols)
+{
+    State s = LoadState(state);
+    uint64_t* ptrWordOut = rowOut + (nCols - 1) * BLOCK_LEN_INT64;
+    for (uint64_t col = 0; col < nCols; ++col) {
+        for (int i = 0; i < 3; ++i) Store(ptrWordOut + 4 * i, s.v[i]);
+        ptrWordOut -= BLOCK_LEN_INT64;
+        Round(s);
+    }
+    SaveState(state, s);
+}
+
+void ReducedDuplexRow1(uint64_t* state, uint64_t* rowIn, uint64_t* rowOut, uint64_t nCols)
+{
+    State s = LoadState(state);
+    const uint64_t* ptrWordIn = rowIn;
+    uint64_t* ptrWordOut = rowOut + (nCols - 1) * BLOCK_LEN_INT64;
+    for (uint64_t col = 0; col < nCols; ++col) {
+        __m256i in[3];
+        for (int i = 0; i < 3; ++i) {
+            in[i] = Load(ptrWordIn + 4 * i);
+            s.v[i] = Xor(s.v[i], in[i]);
+        }
+        Round(s);
+        for (int i = 0; i < 3; ++i) Store(ptrWordOut + 4 * i, Xor(in[i], s.v[i]));
+        ptrWordIn += BLOCK_LEN_INT64;
+        ptrWordOut -= BLOCK_LEN_INT64;
+    }
+    SaveState(state, s);
+}
+
+void ReducedDuplexRowSetup(uint64_t* state, uint64_t* rowIn, uint64_t* rowInOut, uint64_t* rowOut, uint64_t nCols)
+{
+    State s = LoadState(state);
+    const uint64_t* ptrWordIn = rowIn;
+    uint64_t* ptrWordInOut = rowInOut;
+    uint64_t* ptrWordOut = rowOut + (nCols - 1) * BLOCK_LEN_INT64;
+    for (uint64_t col = 0; col < nCols; ++col) {
+        __m256i in[3];
+        for (int i = 0; i < 3; ++i) {
+            in[i] = Load(ptrWordIn + 4 * i);
+            s.v[i] = Xor(s.v[i], Add(in[i], Load(ptrWordInOut + 4 * i)));
+        }
+        Round(s);
+        for (int i = 0; i < 3; ++i) Store(ptrWordOut + 4 * i, Xor(in[i], s.v[i]));
+        // Reload rowInOut: it is only written after rowOut, as in the portable code.
+        __m256i r[3];
+        RotW(s, r);
+        for (int i = 0; i < 3; ++i) Store(ptrWordInOut + 4 * i, Xor(Load(ptrWordInOut + 4 * i), r[i]));
+        ptrWordIn += BLOCK_LEN_INT64;
+        ptrWordInOut += BLOCK_LEN_INT64;
+        ptrWordOut -= BLOCK_LEN_INT64;
+    }
+    SaveState(state, s);
+}
+
+void ReducedDuplexRow(uint64_t* state, uint64_t* rowIn, uint64_t* rowInOut, uint64_t* rowOut, uint64_t nCols)
+{
+    State s = LoadState(state);
+    const uint64_t* ptrWordIn = rowIn;
+    uint64_t* ptrWordInOut = rowInOut;
+    uint64_t* ptrWordOut = rowOut;
+    for (uint64_t col = 0; col < nCols; ++col) {
+        for (int i = 0; i < 3; ++i) {
+            s.v[i] = Xor(s.v[i], Add(Load(ptrWordIn + 4 * i), Load(ptrWordInOut + 4 * i)));
+        }
+        Round(s);
+        // rowOut and rowInOut may be the same row, so apply the two updates in turn.
+        for (int i = 0; i < 3; ++i) Store(ptrWordOut + 4 * i, Xor(Load(ptrWordOut + 4 * i), s.v[i]));
+        __m256i r[3];
+        RotW(s, r);
+        for (int i = 0; i < 3; ++i) Store(ptrWordInOut + 4 * i, Xor(Load(ptrWordInOut + 4 * i), r[i]));
+        ptrWordIn += BLOCK_LEN_INT64;
+        ptrWordInOut += BLOCK_LEN_INT64;
+        ptrWordOut += BLOCK_LEN_INT64;
+    }
+    SaveState(state, s);
+}
+
+} // namespace lyra2_avx2
+
+#endif
@@ -0,0 +1,182 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// Lyra2 reduced-round row operations using SSE4.1 (and SSSE3) intrinsics.
+// These compute exactly the same as the portable versions in Sponge.c.
+
+#ifdef ENABLE_SSE41
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include <crypto/Lyra2Z/Lyra2.h>
+
+namespace lyra2_sse41 {
+namespace {
+
+/** The 16-word sponge state as 2-word lanes: a = v[0..1], b = v[2..3], c = v[4..5], d = v[6..7]. */
+struct State {
+    __m128i v[8];
+};
+
+__m128i inline Load(const uint64_t* p) { return _mm_loadu_si128((const __m128i*)p); }
+void inline Store(uint64_t* p, __m128i x) { _mm_storeu_si128((__m128i*)p, x); }
+
+__m128i inline Add(__m128i x, __m128i y) { return _mm_add_epi64(x, y); }
+__m128i inline Xor(__m128i x, __m128i y) { return _mm_xor_si128(x, y); }
+__m128i inline RotR32(__m128i x) { return _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)); }
+__m128i inline RotR24(__m128i x) { return _mm_shuffle_epi8(x, _mm_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10)); }
+__m128i inline RotR16(__m128i x) { return _mm_shuffle_epi8(x, _mm_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9)); }
+__m128i inline RotR63(__m128i x) { return Xor(_mm_srli_epi64(x, 63), Add(x, x)); }
+
+/** Blake2b's G function on two columns at once. */
+void inline __attribute__((always_inline)) G(__m128i& a, __m128i& b, __m128i& c, __m128i& d)
+{
+    a = Add(a, b);
+    d = RotR32(Xor(d, a));
+    c = Add(c, d);
+    b = RotR24(Xor(b, c));
+    a = Add(a, b);
+    d = RotR16(Xor(d, a));
+    c = Add(c, d);
+    b = RotR63(Xor(b, c));
+}
+
+/** One round of Blake2b's compression function (ROUND_LYRA). */
+void inline __attribute__((always_inline)) Round(State& s)
+{
+    __m128i& a0 = s.v[0]; __m128i& a1 = s.v[1];
+    __m128i& b0 = s.v[2]; __m128i& b1 = s.v[3];
+    __m128i& c0 = s.v[4]; __m128i& c1 = s.v[5];
+    __m128i& d0 = s.v[6]; __m128i& d1 = s.v[7];
+
+    // Columns
+    G(a0, b0, c0, d0);
+    G(a1, b1, c1, d1);
+
+    // Diagonals: rotate b, c and d left by 1, 2 and 3 words
+    __m128i t0 = _mm_alignr_epi8(b1, b0, 8);
+    __m128i t1 = _mm_alignr_epi8(b0, b1, 8);
+    b0 = t0; b1 = t1;
+    t0 = c0; c0 = c1; c1 = t0;
+    t0 = _mm_alignr_epi8(d0, d1, 8);
+    t1 = _mm_alignr_epi8(d1, d0, 8);
+    d0 = t0; d1 = t1;
+
+    G(a0, b0, c0, d0);
+    G(a1, b1, c1, d1);
+
+    // Undo the rotation
+    t0 = _mm_alignr_epi8(b0, b1, 8);
+    t1 = _mm_alignr_epi8(b1, b0, 8);
+    b0 = t0; b1 = t1;
+    t0 = c0; c0 = c1; c1 = t0;
+    t0 = _mm_alignr_epi8(d1, d0, 8);
+    t1 = _mm_alignr_epi8(d0, d1, 8);
+    d0 = t0; d1 = t1;
+}
+
+State inline LoadState(const uint64_t* state)
+{
+    State s;
+    for (int i = 0; i < 8; ++i) s.v[i] = Load(state + 2 * i);
+    return s;
+}
+
+void inline SaveState(uint64_t* state, const State& s)
+{
+    for (int i = 0; i < 8; ++i) Store(state + 2 * i, s.v[i]);
+}
+
+/** The first BLOCK_LEN_INT64 words of the state, rotated right by one word (rotW). */
+void inline RotW(const State& s, __m128i r[6])
+{
+    r[0] = _mm_alignr_epi8(s.v[0], s.v[5], 8);
+    for (int i = 1; i < 6; ++i) r[i] = _mm_alignr_epi8(s.v[i], s.v[i - 1], 8);
+}
+
+} // namespace
+
+void ReducedSqueezeRow0(uint64_t* state, uint64_t* rowOut, uint64_t nCols)
+{
+    State s = LoadState(state);
+    uint64_t* ptrWordOut = rowOut + (nCols - 1) * BLOCK_LEN_INT64;
+    for (uint64_t col = 0; col < nCols; ++col) {
+        for (int i = 0; i < 6; ++i) Store(ptrWordOut + 2 * i, s.v[i]);
+        ptrWordOut -= BLOCK_LEN_INT64;
+        Round(s);
+    }
+    SaveState(state, s);
+}
+
+void ReducedDuplexRow1(uint64_t* state, uint64_t* rowIn, uint64_t* rowOut, uint64_t nCols)
+{
+    State s = LoadState(state);
+    const uint64_t* ptrWordIn = rowIn;
+    uint64_t* ptrWordOut = rowOut + (nCols - 1) * BLOCK_LEN_INT64;
+    for (uint64_t col = 0; col < nCols; ++col) {
+        __m128i in[6];
+        for (int i = 0; i < 6; ++i) {
+            in[i] = Load(ptrWordIn + 2 * i);
+            s.v[i] = Xor(s.v[i], in[i]);
+        }
+        Round(s);
+        for (int i = 0; i < 6; ++i) Store(ptrWordOut + 2 * i, Xor(in[i], s.v[i]));
+        ptrWordIn += BLOCK_LEN_INT64;
+        ptrWordOut -= BLOCK_LEN_INT64;
+    }
+    SaveState(state, s);
+}
+
+void ReducedDuplexRowSetup(uint64_t* state, uint64_t* rowIn, uint64_t* rowInOut, uint64_t* rowOut, uint64_t nCols)
+{
+    State s = LoadState(state);
+    const uint64_t* ptrWordIn = rowIn;
+    uint64_t* ptrWordInOut = rowInOut;
+    uint64_t* ptrWordOut = rowOut + (nCols - 1) * BLOCK_LEN_INT64;
+    for (uint64_t col = 0; col < nCols; ++col) {
+        __m128i in[6];
+        for (int i = 0; i < 6; ++i) {
+            in[i] = Load(ptrWordIn + 2 * i);
+            s.v[i] = Xor(s.v[i], Add(in[i], Load(ptrWordInOut + 2 * i)));
+        }
+        Round(s);
+        for (int i = 0; i < 6; ++i) Store(ptrWordOut + 2 * i, Xor(in[i], s.v[i]));
+        // Reload rowInOut: it is only written after rowOut, as in the portable code.
+        __m128i r[6];
+        RotW(s, r);
+        for (int i = 0; i < 6; ++i) Store(ptrWordInOut + 2 * i, Xor(Load(ptrWordInOut + 2 * i), r[i]));
+        ptrWordIn += BLOCK_LEN_INT64;
+        ptrWordInOut += BLOCK_LEN_INT64;
+        ptrWordOut -= BLOCK_LEN_INT64;
+    }
+    SaveState(state, s);
+}
+
+void ReducedDuplexRow(uint64_t* state, uint64_t* rowIn, uint64_t* rowInOut, uint64_t* rowOut, uint64_t nCols)
+{
+    State s = LoadState(state);
+    const uint64_t* ptrWordIn = rowIn;
+    uint64_t* ptrWordInOut = rowInOut;
+    uint64_t* ptrWordOut = rowOut;
+    for (uint64_t col = 0; col < nCols; ++col) {
+        for (int i = 0; i < 6; ++i) {
+            s.v[i] = Xor(s.v[i], Add(Load(ptrWordIn + 2 * i), Load(ptrWordInOut + 2 * i)));
+        }
+        Round(s);
+        // rowOut and rowInOut may be the same row, so apply the two updates in turn.
+        for (int i = 0; i < 6; ++i) Store(ptrWordOut + 2 * i, Xor(Load(ptrWordOut + 2 * i), s.v[i]));
+        __m128i r[6];
+        RotW(s, r);
+        for (int i = 0; i < 6; ++i) Store(ptrWordInOut + 2 * i, Xor(Load(ptrWordInOut + 2 * i), r[i]));
+        ptrWordIn += BLOCK_LEN_INT64;
+        ptrWordInOut += BLOCK_LEN_INT64;
+        ptrWordOut += BLOCK_LEN_INT64;
+    }
+    SaveState(state, s);
+}
+
+} // namespace lyra2_sse41
+
+#endif
@@ -2,12 +2,22 @@
 #define SCRYPT_H
 #include <stdlib.h>
 #include <stdint.h>
+#include <string>
 
 static const int SCRYPT_SCRATCHPAD_SIZE = 131072 + 63;
 
 void scrypt_1024_1_1_256(const char *input, char *output);
 void scrypt_1024_1_1_256_sp_generic(const char *input, char *output, char *scratchpad);
 
+/**
+ * Compute scrypt_1024_1_1_256 of count 80-byte inputs, several at a time using
+ * interleaved SSE2/AVX2 lanes where available (see scrypt_detect_multi).
+ * Results are identical to calling scrypt_1024_1_1_256 on each input.
+ */
+void scrypt_1024_1_1_256_multi(const char* const* input, char* const* output, size_t count);
+/** Select the widest available multi-lane implementation. Returns its description. */
+std::string scrypt_detect_multi();
+
 #if defined(USE_SSE2)
 #include <string>
 #if defined(_M_X64) || defined(__x86_64__) || defined(_M_AMD64) || (defined(MAC_OSX) && defined(__i386__))
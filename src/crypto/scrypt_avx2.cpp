@@ -0,0 +1,104 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// scrypt_1024_1_1_256 of 8 inputs at once using AVX2 intrinsics. See
+// scrypt_multi.cpp for the lane layout.
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include <crypto/scrypt.h>
+
+namespace scrypt_avx2 {
+namespace {
+
+__m256i inline Add(__m256i x, __m256i y) { return _mm256_add_epi32(x, y); }
+__m256i inline Xor(__m256i x, __m256i y) { return _mm256_xor_si256(x, y); }
+__m256i inline RotL(__m256i x, int n) { return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n)); }
+
+/** xor_salsa8 from scrypt.cpp on 8 lanes. */
+void XorSalsa8(__m256i B[16], const __m256i Bx[16])
+{
+    __m256i x[16];
+    for (int i = 0; i < 16; ++i) x[i] = B[i] = Xor(B[i], Bx[i]);
+    for (int i = 0; i < 8; i += 2) {
+        /* Operate on columns. */
+        x[4] = Xor(x[4], RotL(Add(x[0], x[12]), 7));   x[9] = Xor(x[9], RotL(Add(x[5], x[1]), 7));
+        x[14] = Xor(x[14], RotL(Add(x[10], x[6]), 7)); x[3] = Xor(x[3], RotL(Add(x[15], x[11]), 7));
+
+        x[8] = Xor(x[8], RotL(Add(x[4], x[0]), 9));    x[13] = Xor(x[13], RotL(Add(x[9], x[5]), 9));
+        x[2] = Xor(x[2], RotL(Add(x[14], x[10]), 9));  x[7] = Xor(x[7], RotL(Add(x[3], x[15]), 9));
+
+        x[12] = Xor(x[12], RotL(Add(x[8], x[4]), 13)); x[1] = Xor(x[1], RotL(Add(x[13], x[9]), 13));
+        x[6] = Xor(x[6], RotL(Add(x[2], x[14]), 13));  x[11] = Xor(x[11], RotL(Add(x[7], x[3]), 13));
+
+        x[0] = Xor(x[0], RotL(Add(x[12], x[8]), 18));  x[5] = Xor(x[5], RotL(Add(x[1], x[13]), 18));
+        x[10] = Xor(x[10], RotL(Add(x[6], x[2]), 18)); x[15] = Xor(x[15], RotL(Add(x[11], x[7]), 18));
+
+        /* Operate on rows. */
+        x[1] = Xor(x[1], RotL(Add(x[0], x[3]), 7));    x[6] = Xor(x[6], RotL(Add(x[5], x[4]), 7));
+        x[11] = Xor(x[11], RotL(Add(x[10], x[9]), 7)); x[12] = Xor(x[12], RotL(Add(x[15], x[14]), 7));
+
+        x[2] = Xor(x[2], RotL(Add(x[1], x[0]), 9));    x[7] = Xor(x[7], RotL(Add(x[6], x[5]), 9));
+        x[8] = Xor(x[8], RotL(Add(x[11], x[10]), 9));  x[13] = Xor(x[13], RotL(Add(x[12], x[15]), 9));
+
+        x[3] = Xor(x[3], RotL(Add(x[2], x[1]), 13));   x[4] = Xor(x[4], RotL(Add(x[7], x[6]), 13));
+        x[9] = Xor(x[9], RotL(Add(x[8], x[11]), 13));  x[14] = Xor(x[14], RotL(Add(x[13], x[12]), 13));
+
+        x[0] = Xor(x[0], RotL(Add(x[3], x[2]), 18));   x[5] = Xor(x[5], RotL(Add(x[4], x[7]), 18));
+        x[10] = Xor(x[10], RotL(Add(x[9], x[8]), 18)); x[15] = Xor(x[15], RotL(Add(x[14], x[13]), 18));
+    }
+    for (int i = 0; i < 16; ++i) B[i] = Add(B[i], x[i]);
+}
+
+} // namespace
+
+/** scrypt_1024_1_1_256 of 8 inputs. V must be 32-byte aligned and hold 8 * 1024 * 32 words. */
+void Scrypt_1024_1_1_256_8way(const char* const* input, char* const* output, uint32_t* V)
+{
+    uint8_t B[8][128];
+    __m256i X[32];
+    __m256i* V256 = (__m256i*)V;
+
+    for (int l = 0; l < 8; ++l) {
+        PBKDF2_SHA256((const uint8_t*)input[l], 80, (const uint8_t*)input[l], 80, 1, B[l], 128);
+    }
+    for (int k = 0; k < 32; ++k) {
+        X[k] = _mm256_setr_epi32(le32dec(&B[0][4 * k]), le32dec(&B[1][4 * k]), le32dec(&B[2][4 * k]), le32dec(&B[3][4 * k]),
+                                 le32dec(&B[4][4 * k]), le32dec(&B[5][4 * k]), le32dec(&B[6][4 * k]), le32dec(&B[7][4 * k]));
+    }
+
+    for (int i = 0; i < 1024; ++i) {
+        for (int k = 0; k < 32; ++k) _mm256_store_si256(&V256[i * 32 + k], X[k]);
+        XorSalsa8(&X[0], &X[16]);
+        XorSalsa8(&X[16], &X[0]);
+    }
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i mask = _mm256_set1_epi32(1023);
+    for (int i = 0; i < 1024; ++i) {
+        // Word k of lane l in row j lives at V[(j * 32 + k) * 8 + l].
+        __m256i idx = Add(_mm256_slli_epi32(_mm256_and_si256(X[16], mask), 8), lanes);
+        for (int k = 0; k < 32; ++k) {
+            X[k] = Xor(X[k], _mm256_i32gather_epi32((const int*)V, idx, 4));
+            idx = Add(idx, _mm256_set1_epi32(8));
+        }
+        XorSalsa8(&X[0], &X[16]);
+        XorSalsa8(&X[16], &X[0]);
+    }
+
+    for (int k = 0; k < 32; ++k) {
+        alignas(32) uint32_t words[8];
+        _mm256_store_si256((__m256i*)words, X[k]);
+        for (int l = 0; l < 8; ++l) le32enc(&B[l][4 * k], words[l]);
+    }
+    for (int l = 0; l < 8; ++l) {
+        PBKDF2_SHA256((const uint8_t*)input[l], 80, B[l], 128, 1, (uint8_t*)output[l], 32);
+    }
+}
+
+} // namespace scrypt_avx2
+
+#endif
@@ -0,0 +1,181 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// scrypt_1024_1_1_256 over several inputs at once. Each vector register holds
+// the same Salsa20/8 word of 4 (SSE2) or 8 (AVX2) independent hashes, so the
+// lanes need no shuffling; only the data-dependent reads from the scratchpad
+// are done per lane.
+
+#if defined(HAVE_CONFIG_H)
+#include <config/bitcoin-config.h>
+#endif
+
+#include <crypto/scrypt.h>
+
+#include <compat/cpuid.h>
+
+#include <string.h>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+namespace scrypt_avx2
+{
+void Scrypt_1024_1_1_256_8way(const char* const* input, char* const* output, uint32_t* V);
+}
+#endif
+
+namespace {
+
+/** Scratchpad words for one lane. */
+constexpr size_t SCRYPT_LANE_WORDS{1024 * 32};
+/** The most lanes any implementation uses. */
+constexpr size_t SCRYPT_MAX_LANES{8};
+
+bool g_use_avx2{false};
+
+#if defined(__SSE2__)
+__m128i inline Add(__m128i x, __m128i y) { return _mm_add_epi32(x, y); }
+__m128i inline Xor(__m128i x, __m128i y) { return _mm_xor_si128(x, y); }
+__m128i inline RotL(__m128i x, int n) { return _mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - n)); }
+
+/** xor_salsa8 from scrypt.cpp on 4 lanes. */
+void XorSalsa8(__m128i B[16], const __m128i Bx[16])
+{
+    __m128i x[16];
+    for (int i = 0; i < 16; ++i) x[i] = B[i] = Xor(B[i], Bx[i]);
+    for (int i = 0; i < 8; i += 2) {
+        /* Operate on columns. */
+        x[4] = Xor(x[4], RotL(Add(x[0], x[12]), 7));   x[9] = Xor(x[9], RotL(Add(x[5], x[1]), 7));
+        x[14] = Xor(x[14], RotL(Add(x[10], x[6]), 7)); x[3] = Xor(x[3], RotL(Add(x[15], x[11]), 7));
+
+        x[8] = Xor(x[8], RotL(Add(x[4], x[0]), 9));    x[13] = Xor(x[13], RotL(Add(x[9], x[5]), 9));
+        x[2] = Xor(x[2], RotL(Add(x[14], x[10]), 9));  x[7] = Xor(x[7], RotL(Add(x[3], x[15]), 9));
+
+        x[12] = Xor(x[12], RotL(Add(x[8], x[4]), 13)); x[1] = Xor(x[1], RotL(Add(x[13], x[9]), 13));
+        x[6] = Xor(x[6], RotL(Add(x[2], x[14]), 13));  x[11] = Xor(x[11], RotL(Add(x[7], x[3]), 13));
+
+        x[0] = Xor(x[0], RotL(Add(x[12], x[8]), 18));  x[5] = Xor(x[5], RotL(Add(x[1], x[13]), 18));
+        x[10] = Xor(x[10], RotL(Add(x[6], x[2]), 18)); x[15] = Xor(x[15], RotL(Add(x[11], x[7]), 18));
+
+        /* Operate on rows. */
+        x[1] = Xor(x[1], RotL(Add(x[0], x[3]), 7));    x[6] = Xor(x[6], RotL(Add(x[5], x[4]), 7));
+        x[11] = Xor(x[11], RotL(Add(x[10], x[9]), 7)); x[12] = Xor(x[12], RotL(Add(x[15], x[14]), 7));
+
+        x[2] = Xor(x[2], RotL(Add(x[1], x[0]), 9));    x[7] = Xor(x[7], RotL(Add(x[6], x[5]), 9));
+        x[8] = Xor(x[8], RotL(Add(x[11], x[10]), 9));  x[13] = Xor(x[13], RotL(Add(x[12], x[15]), 9));
+
+        x[3] = Xor(x[3], RotL(Add(x[2], x[1]), 13));   x[4] = Xor(x[4], RotL(Add(x[7], x[6]), 13));
+        x[9] = Xor(x[9], RotL(Add(x[8], x[11]), 13));  x[14] = Xor(x[14], RotL(Add(x[13], x[12]), 13));
+
+        x[0] = Xor(x[0], RotL(Add(x[3], x[2]), 18));   x[5] = Xor(x[5], RotL(Add(x[4], x[7]), 18));
+        x[10] = Xor(x[10], RotL(Add(x[9], x[8]), 18)); x[15] = Xor(x[15], RotL(Add(x[14], x[13]), 18));
+    }
+    for (int i = 0; i < 16; ++i) B[i] = Add(B[i], x[i]);
+}
+
+/** scrypt_1024_1_1_256 of 4 inputs. V must be 16-byte aligned and hold 4 * SCRYPT_LANE_WORDS words. */
+void Scrypt_1024_1_1_256_4way(const char* const* input, char* const* output, uint32_t* V)
+{
+    uint8_t B[4][128];
+    __m128i X[32];
+    __m128i* V128 = (__m128i*)V;
+
+    for (int l = 0; l < 4; ++l) {
+        PBKDF2_SHA256((const uint8_t*)input[l], 80, (const uint8_t*)input[l], 80, 1, B[l], 128);
+    }
+    for (int k = 0; k < 32; ++k) {
+        X[k] = _mm_setr_epi32(le32dec(&B[0][4 * k]), le32dec(&B[1][4 * k]), le32dec(&B[2][4 * k]), le32dec(&B[3][4 * k]));
+    }
+
+    for (int i = 0; i < 1024; ++i) {
+        for (int k = 0; k < 32; ++k) _mm_store_si128(&V128[i * 32 + k], X[k]);
+        XorSalsa8(&X[0], &X[16]);
+        XorSalsa8(&X[16], &X[0]);
+    }
+    for (int i = 0; i < 1024; ++i) {
+        alignas(16) uint32_t j[4];
+        _mm_store_si128((__m128i*)j, X[16]);
+        for (int l = 0; l < 4; ++l) j[l] = (j[l] & 1023) * 32 * 4 + l;
+        for (int k = 0; k < 32; ++k) {
+            X[k] = Xor(X[k], _mm_setr_epi32(V[j[0] + k * 4], V[j[1] + k * 4], V[j[2] + k * 4], V[j[3] + k * 4]));
+        }
+        XorSalsa8(&X[0], &X[16]);
+        XorSalsa8(&X[16], &X[0]);
+    }
+
+    for (int k = 0; k < 32; ++k) {
+        alignas(16) uint32_t words[4];
+        _mm_store_si128((__m128i*)words, X[k]);
+        for (int l = 0; l < 4; ++l) le32enc(&B[l][4 * k], words[l]);
+    }
+    for (int l = 0; l < 4; ++l) {
+        PBKDF2_SHA256((const uint8_t*)input[l], 80, B[l], 128, 1, (uint8_t*)output[l], 32);
+    }
+}
+#endif // __SSE2__
+
+#if defined(HAVE_GETCPUID) && defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+/** Check whether the OS has enabled AVX registers. */
+bool AVXEnabled()
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return (a & 6) == 6;
+}
+#endif
+} // namespace
+
+std::string scrypt_detect_multi()
+{
+    std::string ret = "1way";
+#if defined(__SSE2__)
+    ret = "sse2(4way)";
+#endif
+    g_use_avx2 = false;
+#if defined(HAVE_GETCPUID) && defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+    uint32_t eax, ebx, ecx, edx;
+    GetCPUID(1, 0, eax, ebx, ecx, edx);
+    const bool have_xsave = (ecx >> 27) & 1;
+    const bool have_avx = (ecx >> 28) & 1;
+    if (have_xsave && have_avx && AVXEnabled()) {
+        GetCPUID(7, 0, eax, ebx, ecx, edx);
+        if ((ebx >> 5) & 1) {
+            g_use_avx2 = true;
+            ret += ",avx2(8way)";
+        }
+    }
+#endif
+    return ret;
+}
+
+void scrypt_1024_1_1_256_multi(const char* const* input, char* const* output, size_t count)
+{
+    // Sized for the widest implementation on first use, then kept for the
+    // lifetime of the thread: the block index loader and header checks call
+    // this repeatedly from the same worker threads.
+    static thread_local std::vector<uint32_t> scratch;
+    if (scratch.empty()) scratch.resize(SCRYPT_MAX_LANES * SCRYPT_LANE_WORDS + 16);
+    uint32_t* V = (uint32_t*)(((uintptr_t)scratch.data() + 63) & ~(uintptr_t)63);
+
+    size_t i = 0;
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (g_use_avx2) {
+        for (; count - i >= 8; i += 8) {
+            scrypt_avx2::Scrypt_1024_1_1_256_8way(input + i, output + i, V);
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    for (; count - i >= 4; i += 4) {
+        Scrypt_1024_1_1_256_4way(input + i, output + i, V);
+    }
+#endif
+    for (; i < count; ++i) {
+        scrypt_1024_1_1_256_sp(input[i], output[i], (char*)V);
+    }
+}
@@ -3,12 +3,24 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <algorithm>
 #include <stdexcept>
+#include <utility>
 
 #include <flatfile.h>
 #include <logging.h>
 #include <tinyformat.h>
+#include <util/syscall_sandbox.h>
 #include <util/system.h>
+#include <util/thread.h>
+#include <util/time.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 FlatFileSeq::FlatFileSeq(fs::path dir, const char* prefix, size_t chunk_size) :
     m_dir(std::move(dir)),
@@ -97,3 +109,168 @@ bool FlatFileSeq::Flush(const FlatFilePos& pos, bool finalize)
     fclose(file);
     return true;
 }
+
+std::shared_ptr<const FlatFileMapping> FlatFileMapping::Open(const fs::path& path)
+{
+#ifndef WIN32
+    int fd = open(fs::PathToString(path).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+    void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // The mapping keeps the file open.
+    if (addr == MAP_FAILED) {
+        LogPrint(BCLog::BLOCKSTORE, "Unable to map %s, reading it through stdio\n", fs::PathToString(path));
+        return nullptr;
+    }
+    return std::shared_ptr<const FlatFileMapping>(new FlatFileMapping({static_cast<const std::byte*>(addr), static_cast<size_t>(st.st_size)}));
+#else
+    return nullptr;
+#endif
+}
+
+FlatFileMapping::~FlatFileMapping()
+{
+#ifndef WIN32
+    munmap(const_cast<std::byte*>(m_data.data()), m_data.size());
+#endif
+}
+
+std::shared_ptr<const FlatFileMapping> FlatFileMapper::Get(const fs::path& path, size_t pos)
+{
+    LOCK(m_mutex);
+    if (m_max_files == 0 || !m_finalized.count(path)) {
+        return nullptr;
+    }
+    size_t mapped_size{0};
+    if (const auto it{m_mapped.find(path)}; it != m_mapped.end()) {
+        mapped_size = it->second->second->Data().size();
+        if (pos < mapped_size) {
+            m_lru.splice(m_lru.begin(), m_lru, it->second);
+            return it->second->second;
+        }
+        m_lru.erase(it->second);
+        m_mapped.erase(it);
+    }
+    auto mapping{FlatFileMapping::Open(path)};
+    if (!mapping) {
+        return nullptr;
+    }
+    if (mapping->Data().size() < mapped_size) {
+        // Reading the old mapping past the new end would raise SIGBUS.
+        LogPrintf("%s shrank while mapped, no longer mapping it\n", fs::PathToString(path));
+        m_finalized.erase(path);
+        return nullptr;
+    }
+    if (m_lru.size() >= m_max_files) {
+        m_mapped.erase(m_lru.back().first);
+        m_lru.pop_back();
+    }
+    m_lru.emplace_front(path, mapping);
+    m_mapped.emplace(path, m_lru.begin());
+    return mapping;
+}
+
+void FlatFileMapper::Finalize(const fs::path& path)
+{
+    LOCK(m_mutex);
+    m_finalized.insert(path);
+}
+
+void FlatFileMapper::Unfinalize(const fs::path& path)
+{
+    LOCK(m_mutex);
+    m_finalized.erase(path);
+    if (const auto it{m_mapped.find(path)}; it != m_mapped.end()) {
+        m_lru.erase(it->second);
+        m_mapped.erase(it);
+    }
+}
+
+FlatFileFlusher::FlatFileFlusher(std::string thread_name) : m_thread_name{std::move(thread_name)}
+{
+    m_thread = std::thread(&util::TraceThread, m_thread_name, [this] { ThreadFlush(); });
+}
+
+FlatFileFlusher::~FlatFileFlusher()
+{
+    WITH_LOCK(m_mutex, m_stop = true);
+    m_cv.notify_all();
+    m_thread.join();
+}
+
+bool FlatFileFlusher::TimedFlush(FlatFileSeq& seq, const FlatFilePos& pos, bool finalize)
+{
+    const auto start{SteadyClock::now()};
+    const bool ok{seq.Flush(pos, finalize)};
+    const auto time{std::chrono::duration_cast<std::chrono::microseconds>(SteadyClock::now() - start)};
+    LogPrint(BCLog::BENCH, "Flushed %s in %.2fms\n", fs::PathToString(seq.FileName(pos)), Ticks<MillisecondsDouble>(time));
+    LOCK(m_mutex);
+    ++m_stats.flushes;
+    m_stats.total_time += time;
+    m_stats.max_time = std::max(m_stats.max_time, time);
+    return ok;
+}
+
+bool FlatFileFlusher::Flush(FlatFileSeq seq, const FlatFilePos& pos, bool finalize)
+{
+    return TimedFlush(seq, pos, finalize);
+}
+
+void FlatFileFlusher::Add(FlatFileSeq seq, FlatFilePos pos, bool finalize, Callback done)
+{
+    WITH_LOCK(m_mutex, m_jobs.push_back({std::move(seq), pos, finalize, std::move(done)}));
+    m_cv.notify_all();
+}
+
+bool FlatFileFlusher::Wait()
+{
+    WAIT_LOCK(m_mutex, lock);
+    m_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_jobs.empty(); });
+    return !m_failed;
+}
+
+void FlatFileFlusher::WaitFor(const fs::path& path)
+{
+    WAIT_LOCK(m_mutex, lock);
+    m_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) {
+        return std::none_of(m_jobs.begin(), m_jobs.end(), [&](const Job& job) { return job.seq.FileName(job.pos) == path; });
+    });
+}
+
+FlatFileFlushStats FlatFileFlusher::GetStats() const
+{
+    LOCK(m_mutex);
+    FlatFileFlushStats stats{m_stats};
+    stats.pending = m_jobs.size();
+    return stats;
+}
+
+void FlatFileFlusher::ThreadFlush()
+{
+    SetSyscallSandboxPolicy(SyscallSandboxPolicy::VALIDATION_FILE_FLUSH);
+    while (true) {
+        Job* job;
+        {
+            WAIT_LOCK(m_mutex, lock);
+            m_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_stop || !m_jobs.empty(); });
+            // Pending flushes are still done when stopping.
+            if (m_jobs.empty()) return;
+            // Adding to the back of a deque leaves references to its other elements valid.
+            job = &m_jobs.front();
+        }
+        const bool ok{TimedFlush(job->seq, job->pos, job->finalize)};
+        if (job->done) job->done(ok);
+        {
+            LOCK(m_mutex);
+            m_jobs.pop_front();
+            if (!ok) m_failed = true;
+        }
+        m_cv.notify_all();
+    }
+}
@@ -6,10 +6,23 @@
 #ifndef BITCOIN_FLATFILE_H
 #define BITCOIN_FLATFILE_H
 
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
 #include <string>
+#include <thread>
 
 #include <fs.h>
 #include <serialize.h>
+#include <span.h>
+#include <sync.h>
 
 struct FlatFilePos
 {
@@ -87,4 +100,137 @@ public:
     bool Flush(const FlatFilePos& pos, bool finalize = false);
 };
 
+/**
+ * A read-only memory mapping of a whole file, as large as the file was when
+ * it was mapped.
+ *
+ * Touching a mapped page past the end of the file raises SIGBUS instead of
+ * failing a read. FlatFileMapper only maps files no longer written to, and
+ * those are only appended to or removed, after unmarking them, never cut
+ * short, so the mapped size stays backed by the file. An I/O error while
+ * paging in the data still raises SIGBUS, which is not handled and ends the
+ * process, as it does for the table files LevelDB maps.
+ */
+class FlatFileMapping
+{
+private:
+    Span<const std::byte> m_data;
+
+    explicit FlatFileMapping(Span<const std::byte> data) : m_data(data) {}
+
+public:
+    /** Map the file at path as it is now. Returns nullptr if it is empty or cannot be mapped. */
+    static std::shared_ptr<const FlatFileMapping> Open(const fs::path& path);
+
+    ~FlatFileMapping();
+    FlatFileMapping(const FlatFileMapping&) = delete;
+    FlatFileMapping& operator=(const FlatFileMapping&) = delete;
+
+    Span<const std::byte> Data() const { return m_data; }
+};
+
+/**
+ * Read-only memory mappings of the files of one or more FlatFileSeqs, so that
+ * records in them can be deserialized in place instead of through stdio.
+ *
+ * Only files marked finalized, i.e. no longer written to, are mapped. Whoever
+ * writes to or removes a file has to unmark it first, which drops its mapping;
+ * readers still holding the old mapping can keep using it for the records it
+ * covers. At most max_files files are mapped at once, the least recently used
+ * mapping is dropped to make room.
+ */
+class FlatFileMapper
+{
+private:
+    using LruList = std::list<std::pair<fs::path, std::shared_ptr<const FlatFileMapping>>>;
+
+    const size_t m_max_files;
+    mutable Mutex m_mutex;
+    std::set<fs::path> m_finalized GUARDED_BY(m_mutex);
+    /** Mapped files, most recently used first. */
+    LruList m_lru GUARDED_BY(m_mutex);
+    std::map<fs::path, LruList::iterator> m_mapped GUARDED_BY(m_mutex);
+
+public:
+    explicit FlatFileMapper(size_t max_files) : m_max_files(max_files) {}
+
+    /**
+     * Get the mapping of the file at path, or nullptr if it is not finalized or
+     * cannot be mapped. A mapping that ends at or before pos is replaced by a
+     * new one of the file as it is now, in case it grew. A file found to be
+     * smaller than its mapping is not mapped anymore.
+     */
+    std::shared_ptr<const FlatFileMapping> Get(const fs::path& path, size_t pos = 0) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Allow the file at path to be mapped. */
+    void Finalize(const fs::path& path) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Stop mapping the file at path, before it is written to or removed. */
+    void Unfinalize(const fs::path& path) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+};
+
+/** Flushes done by a FlatFileFlusher and how long they took. */
+struct FlatFileFlushStats {
+    uint64_t flushes{0};
+    /** Flushes added and not yet done. */
+    size_t pending{0};
+    std::chrono::microseconds total_time{0};
+    std::chrono::microseconds max_time{0};
+};
+
+/**
+ * Flushes (and fsyncs) files of FlatFileSeqs on a background thread, in the
+ * order they were added, so that whoever wrote them need not wait for the
+ * disk. Wait() is a barrier for the flushes added before it, to be used before
+ * writing anything that refers to the flushed data. All flushes are timed.
+ */
+class FlatFileFlusher
+{
+public:
+    /** Called on the background thread once a flush is done, with whether it succeeded. */
+    using Callback = std::function<void(bool)>;
+
+    explicit FlatFileFlusher(std::string thread_name);
+    /** Does the flushes still pending. */
+    ~FlatFileFlusher();
+
+    FlatFileFlusher(const FlatFileFlusher&) = delete;
+    FlatFileFlusher& operator=(const FlatFileFlusher&) = delete;
+
+    /** FlatFileSeq::Flush() right away on this thread. */
+    bool Flush(FlatFileSeq seq, const FlatFilePos& pos, bool finalize) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Queue a FlatFileSeq::Flush() for the background thread. */
+    void Add(FlatFileSeq seq, FlatFilePos pos, bool finalize, Callback done) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Wait for the flushes added so far. Returns false if any flush added so far failed. */
+    bool Wait() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Wait for the pending flushes of the file at path, before writing to it again. */
+    void WaitFor(const fs::path& path) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    FlatFileFlushStats GetStats() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    struct Job {
+        FlatFileSeq seq;
+        FlatFilePos pos;
+        bool finalize;
+        Callback done;
+    };
+
+    const std::string m_thread_name;
+    mutable Mutex m_mutex;
+    std::condition_variable m_cv;
+    /** Pending flushes. The background thread removes each only once done. */
+    std::deque<Job> m_jobs GUARDED_BY(m_mutex);
+    bool m_failed GUARDED_BY(m_mutex){false};
+    bool m_stop GUARDED_BY(m_mutex){false};
+    FlatFileFlushStats m_stats GUARDED_BY(m_mutex);
+    std::thread m_thread;
+
+    bool TimedFlush(FlatFileSeq& seq, const FlatFilePos& pos, bool finalize) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    void ThreadFlush() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+};
+
 #endif // BITCOIN_FLATFILE_H
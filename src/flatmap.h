@@ -0,0 +1,389 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_FLATMAP_H
+#define BITCOIN_FLATMAP_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/**
+ * A hash map that keeps its entries inline in one array, for the operations
+ * of std::unordered_map that the coins cache uses.
+ *
+ * Collisions are resolved by linear probing in Robin Hood order: each slot
+ * records how far its entry is from the slot its hash points at, and a new
+ * entry takes the place of the first one that is closer to home than itself.
+ * That keeps probe sequences short, lets a lookup stop as soon as it meets an
+ * entry closer to home than the key would be, and allows erasing without
+ * tombstones by shifting the entries after it back by one. The distances are
+ * kept in a separate control array together with a byte of each hash, so that
+ * most probes are decided without touching the entries themselves.
+ *
+ * Unlike with std::unordered_map, an insert may move every entry (when the
+ * table grows) and an erase may move the entries after it, so iterators and
+ * references are only valid until the next insert or erase. erase() returns
+ * the iterator to continue from, and a loop erasing any of the entries it
+ * visits sees each entry exactly once: iteration starts at a slot whose entry
+ * is at home, or that is empty, and wraps around the end of the table, so the
+ * entries an erase shifts back are always ones not visited yet.
+ */
+template <typename Key, typename T, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>,
+          typename Allocator = std::allocator<std::pair<const Key, T>>>
+class FlatHashMap
+{
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<const Key, T>;
+    using size_type = std::size_t;
+    using hasher = Hash;
+    using key_equal = KeyEqual;
+    using allocator_type = Allocator;
+
+private:
+    /** Storage for one entry, which only exists if its control says so. */
+    struct Slot {
+        alignas(value_type) std::byte m_data[sizeof(value_type)];
+
+        value_type& Get() { return *std::launder(reinterpret_cast<value_type*>(m_data)); }
+        const value_type& Get() const { return *std::launder(reinterpret_cast<const value_type*>(m_data)); }
+    };
+
+    /** Distance of a slot's entry from its home slot plus one, 0 if empty, and the top byte of its hash. */
+    struct Control {
+        uint8_t m_dist;
+        uint8_t m_tag;
+    };
+
+    using SlotAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Slot>;
+    using SlotTraits = std::allocator_traits<SlotAllocator>;
+
+    /** Smallest table allocated, so that tiny maps do not grow over and over. */
+    static constexpr size_type MIN_CAPACITY{16};
+    /** Largest distance a control can hold; the table grows before an entry would need more. */
+    static constexpr unsigned MAX_DIST{255};
+
+    Hash m_hash;
+    KeyEqual m_equal;
+    SlotAllocator m_alloc;
+    /** The slots, followed by their controls in the same allocation. */
+    Slot* m_slots{nullptr};
+    Control* m_control{nullptr};
+    /** Number of slots, zero or a power of two. */
+    size_type m_capacity{0};
+    size_type m_size{0};
+    /** Slot iteration starts at, which is empty or holds an entry at home, so that no erase shifts an entry out of it. */
+    size_type m_start{0};
+
+    /** Number of Slot sized units allocated for capacity slots and their controls. */
+    static constexpr size_type AllocationSlots(size_type capacity)
+    {
+        return capacity + (capacity * sizeof(Control) + sizeof(Slot) - 1) / sizeof(Slot);
+    }
+
+    static uint8_t Tag(size_t hash) { return hash >> (sizeof(size_t) * 8 - 8); }
+
+    size_type Next(size_type pos) const { return (pos + 1) & (m_capacity - 1); }
+
+    /** Iteration order of the slot at pos, or m_capacity for m_capacity. */
+    size_type Order(size_type pos) const { return pos == m_capacity ? pos : (pos - m_start) & (m_capacity - 1); }
+
+    /** Move m_start past the entries an insert shifted away from home. */
+    void FixStart()
+    {
+        while (m_control[m_start].m_dist > 1) m_start = Next(m_start);
+    }
+
+    /** Position of key, or m_capacity if it is not in the map. */
+    size_type FindPos(const Key& key, size_t hash) const
+    {
+        if (m_size == 0) return m_capacity;
+        const uint8_t tag{Tag(hash)};
+        size_type pos{hash & (m_capacity - 1)};
+        for (unsigned dist{1}; m_control[pos].m_dist >= dist; ++dist) {
+            if (m_control[pos].m_dist == dist && m_control[pos].m_tag == tag && m_equal(m_slots[pos].Get().first, key)) {
+                return pos;
+            }
+            pos = Next(pos);
+        }
+        return m_capacity;
+    }
+
+    /**
+     * Make room for a new entry with this hash, shifting the entries in the
+     * way one slot further, and return the empty slot to construct it in.
+     * Fails if an entry would end up more than MAX_DIST from home.
+     */
+    std::optional<size_type> FindInsertPos(size_t hash)
+    {
+        size_type pos{hash & (m_capacity - 1)};
+        unsigned dist{1};
+        while (m_control[pos].m_dist >= dist) {
+            pos = Next(pos);
+            ++dist;
+        }
+        if (dist > MAX_DIST) return std::nullopt;
+        size_type empty{pos};
+        while (m_control[empty].m_dist != 0) {
+            if (m_control[empty].m_dist == MAX_DIST) return std::nullopt;
+            empty = Next(empty);
+        }
+        while (empty != pos) {
+            const size_type prev{(empty - 1) & (m_capacity - 1)};
+            ::new (&m_slots[empty]) value_type(std::move(m_slots[prev].Get()));
+            m_slots[prev].Get().~value_type();
+            m_control[empty] = {uint8_t(m_control[prev].m_dist + 1), m_control[prev].m_tag};
+            empty = prev;
+        }
+        m_control[pos] = {uint8_t(dist), Tag(hash)};
+        return pos;
+    }
+
+    /** Like FindInsertPos(), growing the table as needed. */
+    size_type PrepareInsert(size_t hash)
+    {
+        if ((m_size + 1) * 8 > m_capacity * 7) Rehash(std::max(MIN_CAPACITY, m_capacity * 2));
+        while (true) {
+            if (const auto pos{FindInsertPos(hash)}) return *pos;
+            Rehash(m_capacity * 2);
+        }
+    }
+
+    /** Close the gap left at pos, whose entry is already destroyed, by shifting the following entries back. */
+    void RemoveAt(size_type pos)
+    {
+        for (size_type next{Next(pos)}; m_control[next].m_dist > 1; next = Next(next)) {
+            ::new (&m_slots[pos]) value_type(std::move(m_slots[next].Get()));
+            m_slots[next].Get().~value_type();
+            m_control[pos] = {uint8_t(m_control[next].m_dist - 1), m_control[next].m_tag};
+            pos = next;
+        }
+        m_control[pos] = {0, 0};
+    }
+
+    template <typename... Args>
+    size_type ConstructAt(size_type pos, Args&&... args)
+    {
+        try {
+            ::new (&m_slots[pos]) value_type(std::forward<Args>(args)...);
+        } catch (...) {
+            RemoveAt(pos);
+            throw;
+        }
+        ++m_size;
+        FixStart();
+        return pos;
+    }
+
+    void DestroyAll()
+    {
+        if (m_size == 0) return;
+        for (size_type pos{0}; pos < m_capacity; ++pos) {
+            if (m_control[pos].m_dist != 0) m_slots[pos].Get().~value_type();
+        }
+    }
+
+    /** Move all entries into a new table of capacity slots. */
+    void Rehash(size_type capacity)
+    {
+        Slot* const old_slots{m_slots};
+        Control* const old_control{m_control};
+        const size_type old_capacity{m_capacity};
+
+        m_slots = SlotTraits::allocate(m_alloc, AllocationSlots(capacity));
+        m_control = reinterpret_cast<Control*>(m_slots + capacity);
+        std::fill(m_control, m_control + capacity, Control{0, 0});
+        m_capacity = capacity;
+        m_start = 0;
+
+        for (size_type pos{0}; pos < old_capacity; ++pos) {
+            if (old_control[pos].m_dist == 0) continue;
+            value_type& value{old_slots[pos].Get()};
+            const auto new_pos{FindInsertPos(m_hash(value.first))};
+            assert(new_pos);
+            ::new (&m_slots[*new_pos]) value_type(std::move(value));
+            value.~value_type();
+        }
+        FixStart();
+        if (old_slots) SlotTraits::deallocate(m_alloc, old_slots, AllocationSlots(old_capacity));
+    }
+
+    template <typename K, typename... Args>
+    std::pair<size_type, bool> TryEmplace(K&& key, Args&&... args)
+    {
+        const size_t hash{m_hash(key)};
+        const size_type found{FindPos(key, hash)};
+        if (found != m_capacity) return {found, false};
+        return {ConstructAt(PrepareInsert(hash), std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)), std::forward_as_tuple(std::forward<Args>(args)...)), true};
+    }
+
+    template <bool IS_CONST>
+    class Iter
+    {
+        friend class FlatHashMap;
+        template <bool>
+        friend class Iter;
+
+        using Map = std::conditional_t<IS_CONST, const FlatHashMap, FlatHashMap>;
+        Map* m_map{nullptr};
+        //! Position in iteration order, which starts at m_map->m_start.
+        size_type m_order{0};
+
+        Iter(Map* map, size_type order) : m_map(map), m_order(order) {}
+
+        size_type Pos() const { return (m_map->m_start + m_order) & (m_map->m_capacity - 1); }
+
+        Iter& SkipEmpty()
+        {
+            while (m_order < m_map->m_capacity && m_map->m_control[Pos()].m_dist == 0) ++m_order;
+            return *this;
+        }
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = FlatHashMap::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<IS_CONST, const value_type*, value_type*>;
+        using reference = std::conditional_t<IS_CONST, const value_type&, value_type&>;
+
+        Iter() = default;
+
+        /** An iterator converts to a const_iterator. */
+        template <bool OTHER_CONST, std::enable_if_t<IS_CONST && !OTHER_CONST, int> = 0>
+        Iter(const Iter<OTHER_CONST>& other) : m_map(other.m_map), m_order(other.m_order) {}
+
+        reference operator*() const { return m_map->m_slots[Pos()].Get(); }
+        pointer operator->() const { return &m_map->m_slots[Pos()].Get(); }
+
+        Iter& operator++()
+        {
+            ++m_order;
+            return SkipEmpty();
+        }
+        Iter operator++(int)
+        {
+            Iter copy{*this};
+            ++*this;
+            return copy;
+        }
+
+        friend bool operator==(const Iter& a, const Iter& b) { return a.m_order == b.m_order; }
+        friend bool operator!=(const Iter& a, const Iter& b) { return a.m_order != b.m_order; }
+    };
+
+public:
+    using iterator = Iter<false>;
+    using const_iterator = Iter<true>;
+
+    explicit FlatHashMap(size_type bucket_count, const Hash& hash = Hash(), const KeyEqual& equal = KeyEqual(), const Allocator& alloc = Allocator())
+        : m_hash(hash), m_equal(equal), m_alloc(alloc)
+    {
+        if (bucket_count > 0) reserve(bucket_count);
+    }
+
+    FlatHashMap() : FlatHashMap(0) {}
+
+    FlatHashMap(const FlatHashMap&) = delete;
+    FlatHashMap& operator=(const FlatHashMap&) = delete;
+
+    ~FlatHashMap()
+    {
+        DestroyAll();
+        if (m_slots) SlotTraits::deallocate(m_alloc, m_slots, AllocationSlots(m_capacity));
+    }
+
+    iterator begin() { return iterator{this, 0}.SkipEmpty(); }
+    const_iterator begin() const { return const_iterator{this, 0}.SkipEmpty(); }
+    iterator end() { return iterator{this, m_capacity}; }
+    const_iterator end() const { return const_iterator{this, m_capacity}; }
+
+    size_type size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    iterator find(const Key& key) { return iterator{this, Order(FindPos(key, m_hash(key)))}; }
+    const_iterator find(const Key& key) const { return const_iterator{this, Order(FindPos(key, m_hash(key)))}; }
+    size_type count(const Key& key) const { return find(key) != end(); }
+
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args)
+    {
+        const auto [pos, inserted]{TryEmplace(key, std::forward<Args>(args)...)};
+        return {iterator{this, Order(pos)}, inserted};
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(Key&& key, Args&&... args)
+    {
+        const auto [pos, inserted]{TryEmplace(std::move(key), std::forward<Args>(args)...)};
+        return {iterator{this, Order(pos)}, inserted};
+    }
+
+    /** Constructs the entry before looking up its key, and moves it into place if the key is new. */
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(Args&&... args)
+    {
+        value_type value(std::forward<Args>(args)...);
+        const size_t hash{m_hash(value.first)};
+        const size_type found{FindPos(value.first, hash)};
+        if (found != m_capacity) return {iterator{this, Order(found)}, false};
+        const size_type pos{ConstructAt(PrepareInsert(hash), std::move(value))};
+        return {iterator{this, Order(pos)}, true};
+    }
+
+    T& operator[](const Key& key) { return try_emplace(key).first->second; }
+
+    /** Erase the entry at it, returning the iterator to continue from, which may be at the same position. */
+    iterator erase(const_iterator it)
+    {
+        const size_type pos{it.Pos()};
+        m_slots[pos].Get().~value_type();
+        RemoveAt(pos);
+        --m_size;
+        return iterator{this, it.m_order}.SkipEmpty();
+    }
+    iterator erase(iterator it) { return erase(const_iterator{it}); }
+
+    size_type erase(const Key& key)
+    {
+        const auto it{find(key)};
+        if (it == end()) return 0;
+        erase(it);
+        return 1;
+    }
+
+    /** Remove all entries, keeping the table allocated. */
+    void clear()
+    {
+        DestroyAll();
+        std::fill(m_control, m_control + m_capacity, Control{0, 0});
+        m_size = 0;
+        m_start = 0;
+    }
+
+    /** Grow the table so that count entries fit without another rehash. */
+    void reserve(size_type count)
+    {
+        size_type capacity{MIN_CAPACITY};
+        while (capacity * 7 < count * 8) capacity *= 2;
+        if (capacity > m_capacity) Rehash(capacity);
+    }
+
+    allocator_type get_allocator() const { return allocator_type(m_alloc); }
+
+    /** Size of the table's allocation, for memory usage accounting. */
+    size_t AllocatedBytes() const { return m_capacity ? AllocationSlots(m_capacity) * sizeof(Slot) : 0; }
+};
+
+#endif // BITCOIN_FLATMAP_H
@@ -8,6 +8,8 @@
 #include <timedata.h>
 #include <util/check.h>
 
+#include <algorithm>
+
 // The two constants below are computed using the simulation script on
 // https://gist.github.com/sipa/016ae445c132cdf65a2791534dfb7ae1
 
@@ -42,6 +44,11 @@ HeadersSyncState::HeadersSyncState(NodeId id, const Consensus::Params& consensus
     // could try again, if necessary, to sync a longer chain).
     m_max_commitments = 6*(Ticks<std::chrono::seconds>(GetAdjustedTime() - NodeSeconds{std::chrono::seconds{chain_start->GetMedianTimePast()}}) + MAX_FUTURE_BLOCK_TIME) / HEADER_COMMITMENT_PERIOD;
 
+    for (const CBlockIndex* pindex = chain_start; pindex && m_recent_nbits.size() < DifficultyTransitionWindow(m_consensus_params); pindex = pindex->pprev) {
+        m_recent_nbits.push_back(pindex->nBits);
+    }
+    std::reverse(m_recent_nbits.begin(), m_recent_nbits.end());
+
     LogPrint(BCLog::NET, "Initial headers sync started with peer=%d: height=%i, max_commitments=%i, min_work=%s\n", m_id, m_current_height, m_max_commitments, m_minimum_required_work.ToString());
 }
 
@@ -53,6 +60,7 @@ void HeadersSyncState::Finalize()
     Assume(m_download_state != State::FINAL);
     m_header_commitments = {};
     m_last_header_received.SetNull();
+    m_recent_nbits = {};
     m_redownloaded_headers = {};
     m_redownload_buffer_last_hash.SetNull();
     m_redownload_buffer_first_prev_hash.SetNull();
@@ -187,7 +195,7 @@ bool HeadersSyncState::ValidateAndProcessSingleHeader(const CBlockHeader& curren
     // so don't let anyone give a chain that would violate the difficulty
     // adjustment maximum.
     if (!PermittedDifficultyTransition(m_consensus_params, next_height,
-                m_last_header_received.nBits, current.nBits)) {
+                m_recent_nbits, current.nBits)) {
         LogPrint(BCLog::NET, "Initial headers sync aborted with peer=%d: invalid difficulty transition at height=%i (presync phase)\n", m_id, next_height);
         return false;
     }
@@ -208,6 +216,10 @@ bool HeadersSyncState::ValidateAndProcessSingleHeader(const CBlockHeader& curren
     m_current_chain_work += GetBlockProof(CBlockIndex(current));
     m_last_header_received = current;
     m_current_height = next_height;
+    if (m_recent_nbits.size() >= DifficultyTransitionWindow(m_consensus_params)) {
+        m_recent_nbits.erase(m_recent_nbits.begin());
+    }
+    m_recent_nbits.push_back(current.nBits);
 
     return true;
 }
@@ -241,6 +241,10 @@ private:
     /** Height of m_last_header_received */
     int64_t m_current_height{0};
 
+    /** nBits of m_last_header_received and the headers before it, oldest
+     * first, as many as the difficulty adjustment window spans. */
+    std::vector<uint32_t> m_recent_nbits;
+
     /** During phase 2 (REDOWNLOAD), we buffer redownloaded headers in memory
      *  until enough commitments have been verified; those are stored in
      *  m_redownloaded_headers */
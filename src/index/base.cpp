@@ -21,7 +21,6 @@
 #include <string>
 #include <utility>
 
-using node::ReadBlockFromDisk;
 
 constexpr uint8_t DB_BEST_BLOCK{'B'};
 
@@ -197,14 +196,14 @@ void BaseIndex::ThreadSync()
                 Commit();
             }
 
-            CBlock block;
             interfaces::BlockInfo block_info = kernel::MakeBlockInfo(pindex);
-            if (!ReadBlockFromDisk(block, pindex, consensus_params)) {
+            const std::shared_ptr<const CBlock> block{m_chainstate->m_blockman.ReadBlock(*pindex, consensus_params)};
+            if (!block) {
                 FatalError("%s: Failed to read block %s from disk",
                            __func__, pindex->GetBlockHash().ToString());
                 return;
             } else {
-                block_info.data = &block;
+                block_info.data = block.get();
             }
             if (!CustomAppend(block_info)) {
                 FatalError("%s: Failed to write block %s to index database",
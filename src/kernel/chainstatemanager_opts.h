@@ -17,6 +17,7 @@ class CChainParams;
 
 static constexpr bool DEFAULT_CHECKPOINTS_ENABLED{true};
 static constexpr auto DEFAULT_MAX_TIP_AGE{24h};
+static constexpr bool DEFAULT_COINSDB_WRITE_BEHIND{true};
 
 namespace kernel {
 
@@ -36,6 +37,8 @@ struct ChainstateManagerOpts {
     std::optional<uint256> assumed_valid_block{};
     //! If the tip is older than this, the node is considered to be in initial block download.
     std::chrono::seconds max_tip_age{DEFAULT_MAX_TIP_AGE};
+    //! Write flushed coins to the coin database on a background thread.
+    bool coinsdb_write_behind{DEFAULT_COINSDB_WRITE_BEHIND};
 };
 
 } // namespace kernel
@@ -4,6 +4,8 @@
 
 #include <kernel/context.h>
 
+#include <crypto/Lyra2Z/SpongeDispatch.h>
+#include <crypto/scrypt.h>
 #include <crypto/sha256.h>
 #include <key.h>
 #include <logging.h>
@@ -19,6 +21,10 @@ Context::Context()
 {
     std::string sha256_algo = SHA256AutoDetect();
     LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
+    std::string lyra2_algo = Lyra2SpongeAutoDetect();
+    LogPrintf("Using the '%s' Lyra2 sponge implementation\n", lyra2_algo);
+    std::string scrypt_algo = scrypt_detect_multi();
+    LogPrintf("Using the '%s' scrypt multi-lane implementation\n", scrypt_algo);
     RandomInit();
     ECC_Start();
 }
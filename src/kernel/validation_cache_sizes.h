@@ -5,6 +5,7 @@
 #ifndef BITCOIN_KERNEL_VALIDATION_CACHE_SIZES_H
 #define BITCOIN_KERNEL_VALIDATION_CACHE_SIZES_H
 
+#include <powcache.h>
 #include <script/sigcache.h>
 
 #include <cstddef>
@@ -14,6 +15,7 @@ namespace kernel {
 struct ValidationCacheSizes {
     size_t signature_cache_bytes{DEFAULT_MAX_SIG_CACHE_BYTES / 2};
     size_t script_execution_cache_bytes{DEFAULT_MAX_SIG_CACHE_BYTES / 2};
+    size_t pow_cache_bytes{DEFAULT_MAX_POW_CACHE_BYTES};
 };
 }
 
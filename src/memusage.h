@@ -5,8 +5,10 @@
 #ifndef BITCOIN_MEMUSAGE_H
 #define BITCOIN_MEMUSAGE_H
 
+#include <flatmap.h>
 #include <indirectmap.h>
 #include <prevector.h>
+#include <support/allocators/pool.h>
 
 #include <cassert>
 #include <cstdlib>
@@ -166,6 +168,49 @@ static inline size_t DynamicUsage(const std::unordered_map<X, Y, Z>& m)
     return MallocUsage(sizeof(unordered_node<std::pair<const X, Y> >)) * m.size() + MallocUsage(sizeof(void*) * m.bucket_count());
 }
 
+/** The chunks of a PoolResource, which may be shared by several containers, and the list node of each. */
+template <std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+static inline size_t DynamicUsage(const PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& pool_resource)
+{
+    const size_t estimated_list_node_size = MallocUsage(sizeof(void*) * 3);
+    const size_t usage_resource = estimated_list_node_size * pool_resource.NumAllocatedChunks();
+    const size_t usage_chunks = MallocUsage(pool_resource.ChunkSizeBytes()) * pool_resource.NumAllocatedChunks();
+    return usage_resource + usage_chunks;
+}
+
+template <class Key, class T, class Hash, class Pred, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+static inline size_t DynamicUsage(const std::unordered_map<Key,
+                                                           T,
+                                                           Hash,
+                                                           Pred,
+                                                           PoolAllocator<std::pair<const Key, T>,
+                                                                         MAX_BLOCK_SIZE_BYTES,
+                                                                         ALIGN_BYTES>>& m)
+{
+    // The nodes live in the pool's chunks.
+    return DynamicUsage(*m.get_allocator().resource()) + MallocUsage(sizeof(void*) * m.bucket_count());
+}
+
+template <class Key, class T, class Hash, class Pred, class Alloc>
+static inline size_t DynamicUsage(const FlatHashMap<Key, T, Hash, Pred, Alloc>& m)
+{
+    return MallocUsage(m.AllocatedBytes());
+}
+
+template <class Key, class T, class Hash, class Pred, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+static inline size_t DynamicUsage(const FlatHashMap<Key,
+                                                    T,
+                                                    Hash,
+                                                    Pred,
+                                                    PoolAllocator<std::pair<const Key, T>,
+                                                                  MAX_BLOCK_SIZE_BYTES,
+                                                                  ALIGN_BYTES>>& m)
+{
+    // The table is too large for the pool's blocks and allocated on its own,
+    // but any chunks of the pool count as well.
+    return DynamicUsage(*m.get_allocator().resource()) + MallocUsage(m.AllocatedBytes());
+}
+
 }
 
 #endif // BITCOIN_MEMUSAGE_H
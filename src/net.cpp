@@ -800,10 +800,10 @@ CNetMessage V1TransportDeserializer::GetMessage(const std::chrono::microseconds
 void V1TransportSerializer::prepareForTransport(CSerializedNetMsg& msg, std::vector<unsigned char>& header) const
 {
     // create dbl-sha256 checksum
-    uint256 hash = Hash(msg.data);
+    uint256 hash = msg.m_file_payload ? msg.m_file_payload->m_hash : Hash(msg.data);
 
     // create header
-    CMessageHeader hdr(Params().MessageStart(), msg.m_type.c_str(), msg.data.size());
+    CMessageHeader hdr(Params().MessageStart(), msg.m_type.c_str(), msg.PayloadSize());
     memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
 
     // serialize header
@@ -811,13 +811,39 @@ void V1TransportSerializer::prepareForTransport(CSerializedNetMsg& msg, std::vec
     CVectorWriter{SER_NETWORK, INIT_PROTO_VERSION, header, 0, hdr};
 }
 
+ssize_t FilePayload::Send(const Sock& sock, size_t sent)
+{
+    if (!m_file) {
+        m_file.emplace(fsbridge::fopen(m_path, "rb"));
+    }
+    if (m_file->IsNull()) {
+        return -1;
+    }
+    return sock.SendFile(fileno(m_file->Get()), m_offset + sent, m_size - sent);
+}
+
+bool FilePayload::Read(std::vector<unsigned char>& data) const
+{
+    AutoFile file{fsbridge::fopen(m_path, "rb")};
+    if (file.IsNull() || fseek(file.Get(), m_offset, SEEK_SET) != 0) {
+        return false;
+    }
+    data.resize(m_size);
+    try {
+        file.read(MakeWritableByteSpan(data));
+    } catch (const std::ios_base::failure&) {
+        return false;
+    }
+    return true;
+}
+
 size_t CConnman::SocketSendData(CNode& node) const
 {
     auto it = node.vSendMsg.begin();
     size_t nSentSize = 0;
 
     while (it != node.vSendMsg.end()) {
-        const auto& data = *it;
+        auto& data = *it;
         assert(data.size() > node.nSendOffset);
         int nBytes = 0;
         {
@@ -825,7 +851,11 @@ size_t CConnman::SocketSendData(CNode& node) const
             if (!node.m_sock) {
                 break;
             }
-            nBytes = node.m_sock->Send(reinterpret_cast<const char*>(data.data()) + node.nSendOffset, data.size() - node.nSendOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (data.file) {
+                nBytes = data.file->Send(*node.m_sock, node.nSendOffset);
+            } else {
+                nBytes = node.m_sock->Send(reinterpret_cast<const char*>(data.data.data()) + node.nSendOffset, data.size() - node.nSendOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+            }
         }
         if (nBytes > 0) {
             node.m_last_send = GetTime<std::chrono::seconds>();
@@ -2772,10 +2802,14 @@ bool CConnman::NodeFullyConnected(const CNode* pnode)
 void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
 {
     AssertLockNotHeld(m_total_bytes_sent_mutex);
-    size_t nMessageSize = msg.data.size();
+    size_t nMessageSize = msg.PayloadSize();
     LogPrint(BCLog::NET, "sending %s (%d bytes) peer=%d\n", msg.m_type, nMessageSize, pnode->GetId());
     if (gArgs.GetBoolArg("-capturemessages", false)) {
-        CaptureMessage(pnode->addr, msg.m_type, msg.data, /*is_incoming=*/false);
+        std::vector<unsigned char> file_data;
+        if (msg.m_file_payload && !msg.m_file_payload->Read(file_data)) {
+            LogPrint(BCLog::NET, "unable to read %s payload for capture peer=%d\n", msg.m_type, pnode->GetId());
+        }
+        CaptureMessage(pnode->addr, msg.m_type, msg.m_file_payload ? file_data : msg.data, /*is_incoming=*/false);
     }
 
     TRACE6(net, outbound_message,
@@ -2783,8 +2817,9 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
         pnode->m_addr_name.c_str(),
         pnode->ConnectionTypeAsString().c_str(),
         msg.m_type.c_str(),
-        msg.data.size(),
-        msg.data.data()
+        nMessageSize,
+        // The bytes of a payload sent from a file are not in memory
+        msg.m_file_payload ? nullptr : msg.data.data()
     );
 
     // make sure we use the appropriate network transport format
@@ -2802,8 +2837,8 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
         pnode->nSendSize += nTotalSize;
 
         if (pnode->nSendSize > nSendBufferMaxSize) pnode->fPauseSend = true;
-        pnode->vSendMsg.push_back(std::move(serializedHeader));
-        if (nMessageSize) pnode->vSendMsg.push_back(std::move(msg.data));
+        pnode->vSendMsg.push_back({std::move(serializedHeader), nullptr});
+        if (nMessageSize) pnode->vSendMsg.push_back({std::move(msg.data), std::move(msg.m_file_payload)});
 
         // If write queue empty, attempt "optimistic write"
         if (optimisticSend) nBytesSent = SocketSendData(*pnode);
@@ -12,6 +12,7 @@
 #include <node/connection_types.h>
 #include <consensus/amount.h>
 #include <crypto/siphash.h>
+#include <fs.h>
 #include <hash.h>
 #include <i2p.h>
 #include <net_permissions.h>
@@ -102,6 +103,35 @@ struct AddedNodeInfo
 class CNodeStats;
 class CClientUIInterface;
 
+/**
+ * A message payload sent from a region of a file with Sock::SendFile rather
+ * than from memory, so that payloads already on disk in wire format (blocks)
+ * need not be read into the send queue. The file is only opened once sending
+ * starts, so queued payloads hold no file descriptors; a file that is gone by
+ * then fails the send like a socket error.
+ */
+class FilePayload
+{
+public:
+    FilePayload(fs::path path, int64_t offset, size_t size, const uint256& hash)
+        : m_path{std::move(path)}, m_offset{offset}, m_size{size}, m_hash{hash} {}
+
+    const fs::path m_path;
+    const int64_t m_offset;
+    const size_t m_size;
+    /** Double SHA256 of the region, for the message checksum. */
+    const uint256 m_hash;
+
+    /** Send the region from sent bytes in on. Returns like Sock::SendFile. */
+    ssize_t Send(const Sock& sock, size_t sent);
+
+    /** Read the whole region into data. */
+    bool Read(std::vector<unsigned char>& data) const;
+
+private:
+    std::optional<AutoFile> m_file;
+};
+
 struct CSerializedNetMsg {
     CSerializedNetMsg() = default;
     CSerializedNetMsg(CSerializedNetMsg&&) = default;
@@ -115,11 +145,27 @@ struct CSerializedNetMsg {
         CSerializedNetMsg copy;
         copy.data = data;
         copy.m_type = m_type;
+        if (m_file_payload) {
+            const FilePayload& file{*m_file_payload};
+            copy.m_file_payload = std::make_unique<FilePayload>(file.m_path, file.m_offset, file.m_size, file.m_hash);
+        }
         return copy;
     }
 
+    size_t PayloadSize() const { return m_file_payload ? m_file_payload->m_size : data.size(); }
+
     std::vector<unsigned char> data;
     std::string m_type;
+    /** If set, the payload is sent from this file region instead of data, which is left empty. */
+    std::unique_ptr<FilePayload> m_file_payload;
+};
+
+/** A piece of outgoing data queued for a peer: bytes in memory, or a FilePayload. */
+struct CSendBuffer {
+    std::vector<unsigned char> data;
+    std::unique_ptr<FilePayload> file;
+
+    size_t size() const { return file ? file->m_size : data.size(); }
 };
 
 /**
@@ -369,7 +415,7 @@ public:
     /** Offset inside the first vSendMsg already sent */
     size_t nSendOffset GUARDED_BY(cs_vSend){0};
     uint64_t nSendBytes GUARDED_BY(cs_vSend){0};
-    std::deque<std::vector<unsigned char>> vSendMsg GUARDED_BY(cs_vSend);
+    std::deque<CSendBuffer> vSendMsg GUARDED_BY(cs_vSend);
     Mutex cs_vSend;
     Mutex m_sock_mutex;
     Mutex cs_vRecv;
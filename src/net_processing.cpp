@@ -20,6 +20,7 @@
 #include <merkleblock.h>
 #include <netbase.h>
 #include <netmessagemaker.h>
+#include <node/blockcache.h>
 #include <node/blockstorage.h>
 #include <node/txreconciliation.h>
 #include <policy/fees.h>
@@ -52,6 +53,7 @@
 #include <typeinfo>
 
 using node::ReadBlockFromDisk;
+using node::GetBlockPosFilename;
 using node::ReadRawBlockFromDisk;
 using node::fImporting;
 using node::fPruneMode;
@@ -123,6 +125,10 @@ static const unsigned int MAX_HEADERS_RESULTS = 2000;
 static const int MAX_CMPCTBLOCK_DEPTH = 5;
 /** Maximum depth of blocks we're willing to respond to GETBLOCKTXN requests for. */
 static const int MAX_BLOCKTXN_DEPTH = 10;
+/** Maximum depth of blocks served to peers that are kept in the block cache.
+ *  Several peers catching up ask for these, while older ones are mostly
+ *  asked for once, by a peer syncing from scratch. */
+static constexpr int MAX_CACHED_SERVED_BLOCK_DEPTH{100};
 /** Size of the "block download window": how far ahead of our current height do we fetch?
  *  Larger windows tolerate larger download speed differences between peer, but increase the potential
  *  degree of disordering of blocks on disk (which make reindexing and pruning harder). We'll probably
@@ -182,8 +188,17 @@ static constexpr double MAX_ADDR_RATE_PER_SECOND{0.1};
  *  based increments won't go above this, but the MAX_ADDR_TO_SEND increment following GETADDR
  *  is exempt from this limit). */
 static constexpr size_t MAX_ADDR_PROCESSING_TOKEN_BUCKET{MAX_ADDR_TO_SEND};
+/** Share of wall-clock time a peer may keep us busy checking the proof of work
+ *  of the headers it sends. */
+static constexpr double HEADERS_POW_TIME_SHARE{0.25};
+/** The most header proof-of-work time a peer can save up while idle. */
+static constexpr auto MAX_HEADERS_POW_BUDGET{2s};
 /** The compactblocks version we support. See BIP 152. */
 static constexpr uint64_t CMPCTBLOCKS_VERSION{2};
+/** Memory for the message checksums of blocks sent from the block files. */
+static constexpr size_t MAX_RAW_BLOCK_CHECKSUMS_BYTES{1 << 20};
+/** Estimated memory used by one of those checksums, with its cache entry. */
+static constexpr size_t RAW_BLOCK_CHECKSUM_USAGE{256};
 
 // Internal stuff
 namespace {
@@ -360,6 +375,15 @@ struct Peer {
     double m_addr_token_bucket GUARDED_BY(NetEventsInterface::g_msgproc_mutex){1.0};
     /** When m_addr_token_bucket was last updated */
     std::chrono::microseconds m_addr_token_timestamp GUARDED_BY(NetEventsInterface::g_msgproc_mutex){GetTime<std::chrono::microseconds>()};
+
+    /** Time we are still willing to spend checking the proof of work of
+     *  headers from this peer. Goes negative after an expensive message, in
+     *  which case we hold off asking for more headers until it has refilled. */
+    std::chrono::microseconds m_headers_pow_budget GUARDED_BY(NetEventsInterface::g_msgproc_mutex){MAX_HEADERS_POW_BUDGET};
+    /** When m_headers_pow_budget was last refilled */
+    std::chrono::microseconds m_headers_pow_budget_timestamp GUARDED_BY(NetEventsInterface::g_msgproc_mutex){GetTime<std::chrono::microseconds>()};
+    /** A getheaders held back until m_headers_pow_budget has refilled */
+    std::optional<CBlockLocator> m_deferred_getheaders GUARDED_BY(NetEventsInterface::g_msgproc_mutex);
     /** Total number of addresses that were dropped due to rate limiting. */
     std::atomic<uint64_t> m_addr_rate_limited{0};
     /** Total number of addresses that were processed (excludes rate-limited ones). */
@@ -526,6 +550,8 @@ public:
                         const std::chrono::microseconds time_received, const std::atomic<bool>& interruptMsgProc) override
         EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex, !m_recent_confirmed_transactions_mutex, !m_most_recent_block_mutex, !m_headers_presync_mutex, g_msgproc_mutex);
     void UpdateLastBlockAnnounceTime(NodeId node, int64_t time_in_seconds) override;
+    void UnitTestSetHeadersPoWBudget(NodeId node, std::chrono::microseconds budget) override
+        EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex, g_msgproc_mutex);
 
 private:
     /** Consider evicting an outbound peer based on the amount of time they've been behind our tip */
@@ -604,8 +630,13 @@ private:
                                bool via_compact_block)
         EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex, !m_headers_presync_mutex, g_msgproc_mutex);
     /** Various helpers for headers processing, invoked by ProcessHeadersMessage() */
-    /** Return true if headers are continuous and have valid proof-of-work (DoS points assigned on failure) */
-    bool CheckHeadersPoW(const std::vector<CBlockHeader>& headers, const Consensus::Params& consensusParams, Peer& peer);
+    /** Return true if headers are continuous and have valid proof-of-work (DoS points assigned on failure).
+     *  The cheap contextual checks run first, and the proof of work is only
+     *  checked while the peer has some of its headers PoW time budget left. */
+    bool CheckHeadersPoW(const std::vector<CBlockHeader>& headers, const Consensus::Params& consensusParams, Peer& peer)
+        EXCLUSIVE_LOCKS_REQUIRED(!peer.m_headers_sync_mutex, g_msgproc_mutex);
+    /** Add the headers PoW time the peer has earned since the last refill */
+    void RefillHeadersPoWBudget(Peer& peer) EXCLUSIVE_LOCKS_REQUIRED(g_msgproc_mutex);
     /** Calculate an anti-DoS work threshold for headers chains */
     arith_uint256 GetAntiDoSWorkThreshold();
     /** Deal with state tracking and headers sync for peers that send the
@@ -845,6 +876,18 @@ private:
     std::shared_ptr<const CBlockHeaderAndShortTxIDs> m_most_recent_compact_block GUARDED_BY(m_most_recent_block_mutex);
     uint256 m_most_recent_block_hash GUARDED_BY(m_most_recent_block_mutex);
 
+    /** Size and message checksum of a block as stored in the block files. */
+    struct RawBlockChecksum {
+        unsigned int size;
+        uint256 hash;
+    };
+    /**
+     * Checksums of the blocks recently served from the block files. A block
+     * is read into memory the first time it is served, to compute this; after
+     * that it is sent straight from the file, so every send reads it once.
+     */
+    node::BlockCache<RawBlockChecksum> m_raw_block_checksums{MAX_RAW_BLOCK_CHECKSUMS_BYTES};
+
     // Data about the low-work headers synchronization, aggregated from all peers' HeadersSyncStates.
     /** Mutex guarding the other m_headers_presync_* variables. */
     Mutex m_headers_presync_mutex;
@@ -1431,6 +1474,13 @@ void PeerManagerImpl::UpdateLastBlockAnnounceTime(NodeId node, int64_t time_in_s
     if (state) state->m_last_block_announcement = time_in_seconds;
 }
 
+void PeerManagerImpl::UnitTestSetHeadersPoWBudget(NodeId node, std::chrono::microseconds budget)
+{
+    PeerRef peer{Assert(GetPeerRef(node))};
+    peer->m_headers_pow_budget = budget;
+    peer->m_headers_pow_budget_timestamp = GetTime<std::chrono::microseconds>();
+}
+
 void PeerManagerImpl::InitializeNode(CNode& node, ServiceFlags our_services)
 {
     NodeId nodeid = node.GetId();
@@ -2160,21 +2210,37 @@ void PeerManagerImpl::ProcessGetBlockData(CNode& pfrom, Peer& peer, const CInv&
     if (a_recent_block && a_recent_block->GetHash() == pindex->GetBlockHash()) {
         pblock = a_recent_block;
     } else if (inv.IsMsgWitnessBlk()) {
-        // Fast-path: in this case it is possible to serve the block directly from disk,
-        // as the network format matches the format on disk
-        std::vector<uint8_t> block_data;
-        if (!ReadRawBlockFromDisk(block_data, pindex->GetBlockPos(), m_chainparams.MessageStart())) {
-            assert(!"cannot load block from disk");
+        pblock = m_chainman.m_blockman.m_block_cache.Get(pindex->GetBlockHash());
+        if (!pblock) {
+            // Fast-path: in this case it is possible to serve the block directly from disk,
+            // as the network format matches the format on disk. Once its checksum is
+            // known, the bytes are sent straight from the block file.
+            const FlatFilePos pos{pindex->GetBlockPos()};
+            if (const auto checksum{m_raw_block_checksums.Get(pindex->GetBlockHash())}) {
+                CSerializedNetMsg msg;
+                msg.m_type = NetMsgType::BLOCK;
+                msg.m_file_payload = std::make_unique<FilePayload>(GetBlockPosFilename(pos), pos.nPos, checksum->size, checksum->hash);
+                m_connman.PushMessage(&pfrom, std::move(msg));
+            } else {
+                std::vector<uint8_t> block_data;
+                if (!ReadRawBlockFromDisk(block_data, pos, m_chainparams.MessageStart())) {
+                    assert(!"cannot load block from disk");
+                }
+                m_raw_block_checksums.Insert(pindex->GetBlockHash(),
+                                             std::make_shared<const RawBlockChecksum>(RawBlockChecksum{static_cast<unsigned int>(block_data.size()), Hash(block_data)}),
+                                             RAW_BLOCK_CHECKSUM_USAGE);
+                m_connman.PushMessage(&pfrom, msgMaker.Make(NetMsgType::BLOCK, Span{block_data}));
+            }
+            // Don't set pblock as we've sent the block
         }
-        m_connman.PushMessage(&pfrom, msgMaker.Make(NetMsgType::BLOCK, Span{block_data}));
-        // Don't set pblock as we've sent the block
     } else {
-        // Send block from disk
-        std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
-        if (!ReadBlockFromDisk(*pblockRead, pindex, m_chainparams.GetConsensus())) {
+        // Send block from the cache or disk. Only recent blocks are worth
+        // keeping in the cache.
+        const bool fill_cache{pindex->nHeight >= m_chainman.ActiveChain().Height() - MAX_CACHED_SERVED_BLOCK_DEPTH};
+        pblock = m_chainman.m_blockman.ReadBlock(*pindex, m_chainparams.GetConsensus(), fill_cache);
+        if (!pblock) {
             assert(!"cannot load block from disk");
         }
-        pblock = pblockRead;
     }
     if (pblock) {
         if (inv.IsMsgBlk()) {
@@ -2385,19 +2451,62 @@ void PeerManagerImpl::SendBlockTransactions(CNode& pfrom, Peer& peer, const CBlo
     m_connman.PushMessage(&pfrom, msgMaker.Make(NetMsgType::BLOCKTXN, resp));
 }
 
-bool PeerManagerImpl::CheckHeadersPoW(const std::vector<CBlockHeader>& headers, const Consensus::Params& consensusParams, Peer& peer)
+void PeerManagerImpl::RefillHeadersPoWBudget(Peer& peer)
 {
-    // Do these headers have proof-of-work matching what's claimed?
-    if (!HasValidProofOfWork(headers, consensusParams)) {
-        Misbehaving(peer, 100, "header with invalid proof of work");
-        return false;
-    }
+    const auto current_time{GetTime<std::chrono::microseconds>()};
+    const auto time_diff{std::max(current_time - peer.m_headers_pow_budget_timestamp, 0us)};
+    const auto earned{std::chrono::duration_cast<std::chrono::microseconds>(time_diff * HEADERS_POW_TIME_SHARE)};
+    peer.m_headers_pow_budget = std::min<std::chrono::microseconds>(peer.m_headers_pow_budget + earned, MAX_HEADERS_POW_BUDGET);
+    peer.m_headers_pow_budget_timestamp = current_time;
+}
 
+bool PeerManagerImpl::CheckHeadersPoW(const std::vector<CBlockHeader>& headers, const Consensus::Params& consensusParams, Peer& peer)
+{
     // Are these headers connected to each other?
     if (!CheckHeadersAreContinuous(headers)) {
         Misbehaving(peer, 20, "non-continuous headers sequence");
         return false;
     }
+
+    // Checks that need no hashing: timestamps, and difficulty transitions if
+    // the headers connect to a block we know.
+    {
+        LOCK(cs_main);
+        const CBlockIndex* prev{m_chainman.m_blockman.LookupBlockIndex(headers[0].hashPrevBlock)};
+        BlockValidationState state;
+        if (!PreCheckHeaders(headers, prev, consensusParams, GetAdjustedTime(), state)) {
+            MaybePunishNodeForBlock(peer.m_id, state, /*via_compact_block=*/false, "invalid header received");
+            return false;
+        }
+    }
+
+    // Honest peers only send headers when asked, and we don't ask while their
+    // budget is spent, so just drop these and catch up once it has refilled.
+    RefillHeadersPoWBudget(peer);
+    if (peer.m_headers_pow_budget <= 0us) {
+        LogPrint(BCLog::NET, "ignoring %u headers, header proof of work budget spent, peer=%d\n", headers.size(), peer.m_id);
+        if (!peer.m_deferred_getheaders) {
+            // Resume a low-work headers sync where it stopped, rather than
+            // from our best header, which would restart its presync.
+            LOCK(peer.m_headers_sync_mutex);
+            if (peer.m_headers_sync) {
+                peer.m_deferred_getheaders = peer.m_headers_sync->NextHeadersRequestLocator();
+            } else {
+                LOCK(cs_main);
+                peer.m_deferred_getheaders = GetLocator(m_chainman.m_best_header);
+            }
+        }
+        return false;
+    }
+
+    // Do these headers have proof-of-work matching what's claimed?
+    const auto start{SteadyClock::now()};
+    const bool valid_pow{m_chainman.CheckNewHeadersPoW(headers) == headers.size()};
+    peer.m_headers_pow_budget -= std::chrono::duration_cast<std::chrono::microseconds>(SteadyClock::now() - start);
+    if (!valid_pow) {
+        Misbehaving(peer, 100, "header with invalid proof of work");
+        return false;
+    }
     return true;
 }
 
@@ -2620,6 +2729,13 @@ bool PeerManagerImpl::MaybeSendGetHeaders(CNode& pfrom, const CBlockLocator& loc
     // Only allow a new getheaders message to go out if we don't have a recent
     // one already in-flight
     if (current_time - peer.m_last_getheaders_timestamp > HEADERS_RESPONSE_TIME) {
+        RefillHeadersPoWBudget(peer);
+        if (peer.m_headers_pow_budget <= 0us) {
+            // Sent from SendMessages() once the budget has refilled.
+            peer.m_deferred_getheaders = locator;
+            return false;
+        }
+        peer.m_deferred_getheaders.reset();
         m_connman.PushMessage(&pfrom, msgMaker.Make(NetMsgType::GETHEADERS, locator, uint256()));
         peer.m_last_getheaders_timestamp = current_time;
         return true;
@@ -5434,6 +5550,17 @@ bool PeerManagerImpl::SendMessages(CNode* pto)
             }
         }
 
+        if (peer->m_deferred_getheaders) {
+            RefillHeadersPoWBudget(*peer);
+            if (peer->m_headers_pow_budget > 0us) {
+                const CBlockLocator locator{std::move(*peer->m_deferred_getheaders)};
+                peer->m_deferred_getheaders.reset();
+                if (MaybeSendGetHeaders(*pto, locator, *peer)) {
+                    LogPrint(BCLog::NET, "deferred getheaders to peer=%d\n", pto->GetId());
+                }
+            }
+        }
+
         //
         // Try sending block announcements via headers
         //
@@ -88,6 +88,9 @@ public:
 
     /** This function is used for testing the stale tip eviction logic, see denialofservice_tests.cpp */
     virtual void UpdateLastBlockAnnounceTime(NodeId node, int64_t time_in_seconds) = 0;
+
+    /** This function is used for testing the headers proof-of-work budget, see denialofservice_tests.cpp */
+    virtual void UnitTestSetHeadersPoWBudget(NodeId node, std::chrono::microseconds budget) EXCLUSIVE_LOCKS_REQUIRED(g_msgproc_mutex) = 0;
 };
 
 #endif // BITCOIN_NET_PROCESSING_H
@@ -0,0 +1,109 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODE_BLOCKCACHE_H
+#define BITCOIN_NODE_BLOCKCACHE_H
+
+#include <sync.h>
+#include <uint256.h>
+#include <util/hasher.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+namespace node {
+/** Default for -maxblockcachesize, shared evenly by blocks and undo data. */
+static constexpr size_t DEFAULT_MAX_BLOCK_CACHE_BYTES{32 << 20};
+
+/** Lookups answered from a BlockCache and not, and what it holds. */
+struct BlockCacheStats {
+    uint64_t hits{0};
+    uint64_t misses{0};
+    size_t entries{0};
+    size_t usage{0};
+};
+
+/**
+ * Recently read block data (blocks or undo data) keyed by block hash, shared
+ * with every reader. Once the estimated memory usage of the entries goes over
+ * the limit the least recently used ones are dropped. Data for a block hash
+ * never changes, so entries need no invalidation.
+ */
+template <typename T>
+class BlockCache
+{
+private:
+    struct Entry {
+        uint256 hash;
+        std::shared_ptr<const T> data;
+        size_t usage;
+    };
+    using LruList = std::list<Entry>;
+
+    mutable Mutex m_mutex;
+    size_t m_max_usage GUARDED_BY(m_mutex);
+    size_t m_usage GUARDED_BY(m_mutex){0};
+    /** Entries, most recently used first. */
+    LruList m_lru GUARDED_BY(m_mutex);
+    std::unordered_map<uint256, typename LruList::iterator, BlockHasher> m_entries GUARDED_BY(m_mutex);
+    uint64_t m_hits GUARDED_BY(m_mutex){0};
+    uint64_t m_misses GUARDED_BY(m_mutex){0};
+
+    void Trim() EXCLUSIVE_LOCKS_REQUIRED(m_mutex)
+    {
+        while (m_usage > m_max_usage) {
+            m_usage -= m_lru.back().usage;
+            m_entries.erase(m_lru.back().hash);
+            m_lru.pop_back();
+        }
+    }
+
+public:
+    explicit BlockCache(size_t max_usage) : m_max_usage(max_usage) {}
+
+    /** Look up the data for hash, counting a hit or a miss. */
+    std::shared_ptr<const T> Get(const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        LOCK(m_mutex);
+        const auto it{m_entries.find(hash)};
+        if (it == m_entries.end()) {
+            ++m_misses;
+            return nullptr;
+        }
+        ++m_hits;
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        return it->second->data;
+    }
+
+    /** Add the data for hash, estimated to use usage bytes of memory. Data larger than the whole cache is not kept. */
+    void Insert(const uint256& hash, std::shared_ptr<const T> data, size_t usage) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        LOCK(m_mutex);
+        if (usage > m_max_usage || m_entries.count(hash)) return;
+        m_lru.push_front({hash, std::move(data), usage});
+        m_entries.emplace(hash, m_lru.begin());
+        m_usage += usage;
+        Trim();
+    }
+
+    /** Change the memory limit, dropping entries as needed. */
+    void Resize(size_t max_usage) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        LOCK(m_mutex);
+        m_max_usage = max_usage;
+        Trim();
+    }
+
+    BlockCacheStats GetStats() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        LOCK(m_mutex);
+        return {m_hits, m_misses, m_entries.size(), m_usage};
+    }
+};
+} // namespace node
+
+#endif // BITCOIN_NODE_BLOCKCACHE_H
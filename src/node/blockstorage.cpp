@@ -4,14 +4,19 @@
 
 #include <node/blockstorage.h>
 
+#include <arith_uint256.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <clientversion.h>
 #include <consensus/validation.h>
+#include <core_memusage.h>
 #include <flatfile.h>
 #include <fs.h>
 #include <hash.h>
+#include <memusage.h>
 #include <pow.h>
+#include <powcache.h>
+#include <random.h>
 #include <reverse_iterator.h>
 #include <shutdown.h>
 #include <signet.h>
@@ -19,8 +24,12 @@
 #include <undo.h>
 #include <util/syscall_sandbox.h>
 #include <util/system.h>
+#include <util/time.h>
 #include <validation.h>
 
+#include <algorithm>
+#include <array>
+#include <cstring>
 #include <map>
 #include <unordered_map>
 
@@ -58,6 +67,38 @@ static FILE* OpenUndoFile(const FlatFilePos& pos, bool fReadOnly = false);
 static FlatFileSeq BlockFileSeq();
 static FlatFileSeq UndoFileSeq();
 
+/** Mappings of the blk and rev files no longer being written to, for the read functions below. */
+static FlatFileMapper g_mapped_block_files{MAX_MAPPED_BLOCK_FILES};
+static FlatFileMapper g_mapped_undo_files{MAX_MAPPED_BLOCK_FILES};
+
+/**
+ * Run read on a stream positioned at pos in a file of seq. The stream reads
+ * straight from the file's mapping when mapper has one covering pos, and
+ * through stdio otherwise, such as for the file currently being written.
+ * Returns false if the file could not be opened; errors from read propagate.
+ */
+template <typename Read>
+static bool ReadFromFile(FlatFileMapper& mapper, FlatFileSeq seq, const FlatFilePos& pos, Read read)
+{
+    if (const auto mapping{mapper.Get(seq.FileName(pos), pos.nPos)}; mapping && pos.nPos < mapping->Data().size()) {
+        SpanReader reader{SER_DISK, CLIENT_VERSION, UCharSpanCast(mapping->Data().subspan(pos.nPos))};
+        read(reader);
+        return true;
+    }
+    CAutoFile filein(seq.Open(pos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        return false;
+    }
+    read(filein);
+    return true;
+}
+
+size_t BlockManager::BlockIndexMemoryUsage() const
+{
+    AssertLockHeld(cs_main);
+    return memusage::DynamicUsage(m_block_index);
+}
+
 std::vector<CBlockIndex*> BlockManager::GetAllBlockIndices()
 {
     AssertLockHeld(cs_main);
@@ -254,12 +295,22 @@ CBlockIndex* BlockManager::InsertBlockIndex(const uint256& hash)
     return pindex;
 }
 
-bool BlockManager::LoadBlockIndex(const Consensus::Params& consensus_params)
+bool BlockManager::LoadBlockIndex(const Consensus::Params& consensus_params, CCheckQueue<CPoWCheck>* pow_queue)
 {
-    if (!m_block_tree_db->LoadBlockIndexGuts(consensus_params, [this](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) { return this->InsertBlockIndex(hash); })) {
+    std::vector<CBlockIndex*> missing_checksum;
+    if (!m_block_tree_db->LoadBlockIndexGuts(
+            consensus_params, [this](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) { return this->InsertBlockIndex(hash); },
+            m_check_block_index_pow, missing_checksum, pow_queue)) {
         return false;
     }
 
+    // Rewrite entries from older versions (or with a bad checksum) on the next
+    // flush so their proof-of-work does not have to be recomputed again.
+    if (!missing_checksum.empty()) {
+        LogPrintf("%s: adding PoW checksums to %u block index entries\n", __func__, missing_checksum.size());
+        m_dirty_blockindex.insert(missing_checksum.begin(), missing_checksum.end());
+    }
+
     // Calculate nChainWork
     std::vector<CBlockIndex*> vSortedByHeight{GetAllBlockIndices()};
     std::sort(vSortedByHeight.begin(), vSortedByHeight.end(),
@@ -319,12 +370,180 @@ bool BlockManager::WriteBlockIndexDB()
     return true;
 }
 
-bool BlockManager::LoadBlockIndexDB(const Consensus::Params& consensus_params)
+/** File in the data directory that WriteBlockIndexSnapshot() saves the block index to. */
+static constexpr const char* BLOCK_INDEX_SNAPSHOT_FILENAME{"blockindex.dat"};
+/** Format version of the block index snapshot file. */
+static constexpr uint32_t BLOCK_INDEX_SNAPSHOT_VERSION{2};
+
+static fs::path BlockIndexSnapshotPath()
+{
+    return gArgs.GetDataDirNet() / BLOCK_INDEX_SNAPSHOT_FILENAME;
+}
+
+/**
+ * The snapshot holds every entry in height order, together with the fields
+ * LoadBlockIndex() would otherwise compute, so that it can be read back in one
+ * pass. Entries refer to their pprev and pskip by one-based position in the
+ * file, 0 meaning none. The snapshot id lives in the last block file record,
+ * which every block index write replaces, so a database changed by a version
+ * that does not know about the snapshot no longer matches it. A hash of all
+ * block file info is included as well.
+ */
+template <typename Stream>
+static void SerializeSnapshotEntry(Stream& s, const CBlockIndex& index, uint32_t prev, uint32_t skip) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    s << index.GetBlockHash() << prev << skip << index.nHeight << index.nStatus << index.nFile << index.nDataPos << index.nUndoPos
+      << index.nTx << index.nChainTx << index.nTimeMax << ArithToUint256(index.nChainWork)
+      << index.nVersion << index.hashMerkleRoot << index.nTime << index.nBits << index.nNonce;
+}
+
+bool BlockManager::WriteBlockIndexSnapshot()
 {
-    if (!LoadBlockIndex(consensus_params)) {
+    AssertLockHeld(::cs_main);
+    if (!m_dirty_blockindex.empty() || !m_dirty_fileinfo.empty()) {
+        return error("%s: the block index has not been written to the database", __func__);
+    }
+    const auto start{SteadyClock::now()};
+
+    std::vector<CBlockIndex*> sorted{GetAllBlockIndices()};
+    std::sort(sorted.begin(), sorted.end(), CBlockIndexHeightOnlyComparator());
+    std::unordered_map<const CBlockIndex*, uint32_t> positions;
+    positions.reserve(sorted.size());
+    for (const CBlockIndex* pindex : sorted) {
+        positions.emplace(pindex, positions.size() + 1);
+    }
+    const auto position{[&](const CBlockIndex* pindex) { return pindex ? positions.at(pindex) : uint32_t{0}; }};
+
+    const uint256 id{GetRandHash()};
+    const fs::path path{BlockIndexSnapshotPath()};
+    const fs::path path_tmp{path + ".new"};
+    CAutoFile file{fsbridge::fopen(path_tmp, "wb"), SER_DISK, CLIENT_VERSION};
+    if (file.IsNull()) {
+        return error("%s: failed to open %s", __func__, fs::PathToString(path_tmp));
+    }
+    try {
+        HashedSourceWriter writer{file};
+        writer << Params().MessageStart() << BLOCK_INDEX_SNAPSHOT_VERSION << id << m_last_blockfile << SerializeHash(m_blockfile_info) << uint64_t{sorted.size()};
+        for (const CBlockIndex* pindex : sorted) {
+            SerializeSnapshotEntry(writer, *pindex, position(pindex->pprev), position(pindex->pskip));
+        }
+        file << writer.GetHash();
+    } catch (const std::exception& e) {
+        file.fclose();
+        fs::remove(path_tmp);
+        return error("%s: failed to write %s: %s", __func__, fs::PathToString(path_tmp), e.what());
+    }
+    if (!FileCommit(file.Get())) {
+        file.fclose();
+        fs::remove(path_tmp);
+        return error("%s: failed to flush %s", __func__, fs::PathToString(path_tmp));
+    }
+    file.fclose();
+    if (!RenameOver(path_tmp, path)) {
+        fs::remove(path_tmp);
+        return error("%s: failed to rename %s", __func__, fs::PathToString(path_tmp));
+    }
+    // Only now does the database point at the new snapshot.
+    if (!m_block_tree_db->WriteIndexSnapshotId(m_last_blockfile, id)) {
+        return error("%s: failed to write the snapshot id", __func__);
+    }
+    LogPrintf("Saved %u block index entries to the snapshot (%dms)\n", sorted.size(), Ticks<std::chrono::milliseconds>(SteadyClock::now() - start));
+    return true;
+}
+
+bool BlockManager::LoadBlockIndexSnapshot()
+{
+    AssertLockHeld(cs_main);
+    // Any later write to the database would make the snapshot stale, so it
+    // is used at most once, and not at all if the id cannot be cleared.
+    uint256 id;
+    if (!m_block_tree_db->ReadIndexSnapshotId(id)) return false;
+    if (!m_block_tree_db->EraseIndexSnapshotId()) {
+        LogPrintf("Not using the block index snapshot: failed to erase its id\n");
+        return false;
+    }
+    if (!m_use_index_snapshot || m_check_block_index_pow != BlockIndexPoWCheck::NONE) return false;
+
+    const auto start{SteadyClock::now()};
+    const fs::path path{BlockIndexSnapshotPath()};
+    CAutoFile file{fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION};
+    if (file.IsNull()) {
+        LogPrintf("Not using the block index snapshot: failed to open %s\n", fs::PathToString(path));
+        return false;
+    }
+    std::vector<CBlockIndex*> entries;
+    try {
+        CHashVerifier<CAutoFile> verifier{&file};
+        CMessageHeader::MessageStartChars message_start;
+        uint32_t version;
+        verifier >> message_start >> version;
+        if (memcmp(message_start, Params().MessageStart(), sizeof(message_start))) {
+            throw std::runtime_error{"Invalid network magic number"};
+        }
+        if (version != BLOCK_INDEX_SNAPSHOT_VERSION) {
+            throw std::runtime_error{strprintf("Unsupported version %u", version)};
+        }
+
+        uint256 file_id;
+        int last_blockfile;
+        uint256 blockfile_info_hash;
+        uint64_t count;
+        verifier >> file_id >> last_blockfile >> blockfile_info_hash >> count;
+        if (file_id != id) {
+            throw std::runtime_error{"Written for a different database"};
+        }
+        if (last_blockfile != m_last_blockfile || blockfile_info_hash != SerializeHash(m_blockfile_info)) {
+            throw std::runtime_error{"Block files changed since it was written"};
+        }
+        if (count > fs::file_size(path) / sizeof(uint256)) {
+            throw std::runtime_error{"Truncated"};
+        }
+
+        entries.reserve(count);
+        m_block_index.reserve(count);
+        for (uint64_t i = 0; i < count; ++i) {
+            uint256 hash;
+            uint32_t prev, skip;
+            uint256 chain_work;
+            verifier >> hash >> prev >> skip;
+            if (prev > entries.size() || skip > entries.size()) {
+                throw std::runtime_error{"Entry refers to a later one"};
+            }
+            const auto [it, inserted]{m_block_index.try_emplace(hash)};
+            if (!inserted) {
+                throw std::runtime_error{"Duplicate entry"};
+            }
+            CBlockIndex& index{it->second};
+            index.phashBlock = &it->first;
+            index.pprev = prev ? entries[prev - 1] : nullptr;
+            index.pskip = skip ? entries[skip - 1] : nullptr;
+            verifier >> index.nHeight >> index.nStatus >> index.nFile >> index.nDataPos >> index.nUndoPos
+                     >> index.nTx >> index.nChainTx >> index.nTimeMax >> chain_work
+                     >> index.nVersion >> index.hashMerkleRoot >> index.nTime >> index.nBits >> index.nNonce;
+            index.nChainWork = UintToArith256(chain_work);
+            if (index.nTx > 0 && index.pprev && index.pprev->nChainTx == 0) {
+                m_blocks_unlinked.emplace(index.pprev, &index);
+            }
+            entries.push_back(&index);
+        }
+
+        uint256 hash;
+        file >> hash;
+        if (hash != verifier.GetHash()) {
+            throw std::runtime_error{"Checksum mismatch, data corrupted"};
+        }
+    } catch (const std::exception& e) {
+        LogPrintf("Not using the block index snapshot: %s\n", e.what());
+        m_blocks_unlinked.clear();
+        m_block_index.clear();
         return false;
     }
+    LogPrintf("Loaded %u block index entries from the snapshot (%dms)\n", entries.size(), Ticks<std::chrono::milliseconds>(SteadyClock::now() - start));
+    return true;
+}
 
+bool BlockManager::LoadBlockIndexDB(const Consensus::Params& consensus_params, CCheckQueue<CPoWCheck>* pow_queue)
+{
     // Load block file info
     m_block_tree_db->ReadLastBlockFile(m_last_blockfile);
     m_blockfile_info.resize(m_last_blockfile + 1);
@@ -342,6 +561,17 @@ bool BlockManager::LoadBlockIndexDB(const Consensus::Params& consensus_params)
         }
     }
 
+    if (!LoadBlockIndexSnapshot() && !LoadBlockIndex(consensus_params, pow_queue)) {
+        return false;
+    }
+
+    // Files before the last one are no longer appended to, except for rev
+    // files still catching up, whose writes take them out of the mappings.
+    for (int nFile = 0; nFile < m_last_blockfile; nFile++) {
+        g_mapped_block_files.Finalize(BlockFileSeq().FileName(FlatFilePos(nFile, 0)));
+        g_mapped_undo_files.Finalize(UndoFileSeq().FileName(FlatFilePos(nFile, 0)));
+    }
+
     // Check presence of blk files
     LogPrintf("Checking all blk files are present...\n");
     std::set<int> setBlkDataFiles;
@@ -425,6 +655,7 @@ void CleanupBlockRevFiles()
             if (path.substr(0, 3) == "blk") {
                 mapBlockFiles[path.substr(3, 5)] = it->path();
             } else if (path.substr(0, 3) == "rev") {
+                g_mapped_undo_files.Unfinalize(it->path());
                 remove(it->path());
             }
         }
@@ -440,6 +671,7 @@ void CleanupBlockRevFiles()
             nContigCounter++;
             continue;
         }
+        g_mapped_block_files.Unfinalize(item.second);
         remove(item.second);
     }
 }
@@ -454,6 +686,7 @@ CBlockFileInfo* BlockManager::GetBlockFileInfo(size_t n)
 static bool UndoWriteToDisk(const CBlockUndo& blockundo, FlatFilePos& pos, const uint256& hashBlock, const CMessageHeader::MessageStartChars& messageStart)
 {
     // Open history file to append
+    g_mapped_undo_files.Unfinalize(UndoFileSeq().FileName(pos));
     CAutoFile fileout(OpenUndoFile(pos), SER_DISK, CLIENT_VERSION);
     if (fileout.IsNull()) {
         return error("%s: OpenUndoFile failed", __func__);
@@ -488,25 +721,26 @@ bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex)
         return error("%s: no undo data available", __func__);
     }
 
-    // Open history file to read
-    CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull()) {
-        return error("%s: OpenUndoFile failed", __func__);
-    }
-
     // Read block
     uint256 hashChecksum;
-    CHashVerifier<CAutoFile> verifier(&filein); // We need a CHashVerifier as reserializing may lose data
+    uint256 hashData;
     try {
-        verifier << pindex->pprev->GetBlockHash();
-        verifier >> blockundo;
-        filein >> hashChecksum;
+        const bool opened{ReadFromFile(g_mapped_undo_files, UndoFileSeq(), pos, [&](auto& filein) {
+            CHashVerifier verifier(&filein); // We need a CHashVerifier as reserializing may lose data
+            verifier << pindex->pprev->GetBlockHash();
+            verifier >> blockundo;
+            filein >> hashChecksum;
+            hashData = verifier.GetHash();
+        })};
+        if (!opened) {
+            return error("%s: OpenUndoFile failed", __func__);
+        }
     } catch (const std::exception& e) {
         return error("%s: Deserialize or I/O error - %s", __func__, e.what());
     }
 
     // Verify checksum
-    if (hashChecksum != verifier.GetHash()) {
+    if (hashChecksum != hashData) {
         return error("%s: Checksum mismatch", __func__);
     }
 
@@ -516,7 +750,18 @@ bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex)
 void BlockManager::FlushUndoFile(int block_file, bool finalize)
 {
     FlatFilePos undo_pos_old(block_file, m_blockfile_info[block_file].nUndoSize);
-    if (!UndoFileSeq().Flush(undo_pos_old, finalize)) {
+    if (finalize) {
+        // Nothing is appended to a finalized file, so it can be flushed in the background.
+        m_flusher.Add(UndoFileSeq(), undo_pos_old, finalize, [path = UndoFileSeq().FileName(undo_pos_old)](bool ok) {
+            if (!ok) {
+                AbortNode("Flushing undo file to disk failed. This is likely the result of an I/O error.");
+                return;
+            }
+            g_mapped_undo_files.Finalize(path);
+        });
+        return;
+    }
+    if (!m_flusher.Flush(UndoFileSeq(), undo_pos_old, finalize)) {
         AbortNode("Flushing undo file to disk failed. This is likely the result of an I/O error.");
     }
 }
@@ -535,7 +780,15 @@ void BlockManager::FlushBlockFile(bool fFinalize, bool finalize_undo)
     assert(static_cast<int>(m_blockfile_info.size()) > m_last_blockfile);
 
     FlatFilePos block_pos_old(m_last_blockfile, m_blockfile_info[m_last_blockfile].nSize);
-    if (!BlockFileSeq().Flush(block_pos_old, fFinalize)) {
+    if (fFinalize) {
+        m_flusher.Add(BlockFileSeq(), block_pos_old, fFinalize, [path = BlockFileSeq().FileName(block_pos_old)](bool ok) {
+            if (!ok) {
+                AbortNode("Flushing block file to disk failed. This is likely the result of an I/O error.");
+                return;
+            }
+            g_mapped_block_files.Finalize(path);
+        });
+    } else if (!m_flusher.Flush(BlockFileSeq(), block_pos_old, fFinalize)) {
         AbortNode("Flushing block file to disk failed. This is likely the result of an I/O error.");
     }
     // we do not always flush the undo file, as the chain tip may be lagging behind the incoming blocks,
@@ -558,6 +811,8 @@ void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune)
 {
     for (std::set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         FlatFilePos pos(*it, 0);
+        g_mapped_block_files.Unfinalize(BlockFileSeq().FileName(pos));
+        g_mapped_undo_files.Unfinalize(UndoFileSeq().FileName(pos));
         fs::remove(BlockFileSeq().FileName(pos));
         fs::remove(UndoFileSeq().FileName(pos));
         LogPrint(BCLog::BLOCKSTORE, "Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
@@ -655,6 +910,9 @@ bool BlockManager::FindUndoPos(BlockValidationState& state, int nFile, FlatFileP
     m_blockfile_info[nFile].nUndoSize += nAddSize;
     m_dirty_fileinfo.insert(nFile);
 
+    // A flush in the background may still be truncating the file to its former size.
+    m_flusher.WaitFor(UndoFileSeq().FileName(pos));
+
     bool out_of_space;
     size_t bytes_allocated = UndoFileSeq().Allocate(pos, nAddSize, out_of_space);
     if (out_of_space) {
@@ -670,6 +928,7 @@ bool BlockManager::FindUndoPos(BlockValidationState& state, int nFile, FlatFileP
 static bool WriteBlockToDisk(const CBlock& block, FlatFilePos& pos, const CMessageHeader::MessageStartChars& messageStart)
 {
     // Open history file to append
+    g_mapped_block_files.Unfinalize(BlockFileSeq().FileName(pos));
     CAutoFile fileout(OpenBlockFile(pos), SER_DISK, CLIENT_VERSION);
     if (fileout.IsNull()) {
         return error("WriteBlockToDisk: OpenBlockFile failed");
@@ -720,25 +979,21 @@ bool BlockManager::WriteUndoDataForBlock(const CBlockUndo& blockundo, BlockValid
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const Consensus::Params& consensusParams)
+bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const Consensus::Params& consensusParams, bool check_pow)
 {
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull()) {
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
-    }
-
     // Read block
     try {
-        filein >> block;
+        if (!ReadFromFile(g_mapped_block_files, BlockFileSeq(), pos, [&](auto& filein) { filein >> block; })) {
+            return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+        }
     } catch (const std::exception& e) {
         return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
     }
 
     // Check the header
-    if (!CheckProofOfWork(block.GetPoWHash(), block.nBits, consensusParams)) {
+    if (check_pow && !CheckBlockHeaderProofOfWork(block, consensusParams)) {
         return error("ReadBlockFromDisk: Errors in block header at %s", pos.ToString());
     }
 
@@ -750,11 +1005,19 @@ bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const Consensus::P
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
+bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams, bool check_pow)
 {
-    const FlatFilePos block_pos{WITH_LOCK(cs_main, return pindex->GetBlockPos())};
+    FlatFilePos block_pos;
+    {
+        LOCK(cs_main);
+        block_pos = pindex->GetBlockPos();
+        // The header of an entry that made it into the block tree has already
+        // passed CheckProofOfWork, and the hash comparison below ties the data
+        // on disk to that header, so recomputing the PoW hash adds nothing.
+        if (!pindex->IsValid(BLOCK_VALID_TREE)) check_pow = true;
+    }
 
-    if (!ReadBlockFromDisk(block, block_pos, consensusParams)) {
+    if (!ReadBlockFromDisk(block, block_pos, consensusParams, check_pow)) {
         return false;
     }
     if (block.GetHash() != pindex->GetBlockHash()) {
@@ -764,22 +1027,75 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
     return true;
 }
 
+void BlockManager::ResizeBlockCache(size_t max_bytes)
+{
+    m_block_cache.Resize(max_bytes / 2);
+    m_undo_cache.Resize(max_bytes / 2);
+}
+
+std::shared_ptr<const CBlock> BlockManager::ReadBlock(const CBlockIndex& index, const Consensus::Params& consensus_params, bool fill_cache)
+{
+    const uint256 hash{index.GetBlockHash()};
+    if (auto block{m_block_cache.Get(hash)}) return block;
+
+    auto block{std::make_shared<CBlock>()};
+    if (!ReadBlockFromDisk(*block, &index, consensus_params)) {
+        return nullptr;
+    }
+    if (fill_cache) m_block_cache.Insert(hash, block, RecursiveDynamicUsage(block));
+    return block;
+}
+
+/** Estimate the memory used by undo data. */
+static size_t DynamicUsage(const CBlockUndo& blockundo)
+{
+    size_t usage{memusage::DynamicUsage(blockundo.vtxundo)};
+    for (const CTxUndo& txundo : blockundo.vtxundo) {
+        usage += memusage::DynamicUsage(txundo.vprevout);
+        for (const Coin& coin : txundo.vprevout) {
+            usage += coin.DynamicMemoryUsage();
+        }
+    }
+    return usage;
+}
+
+std::shared_ptr<const CBlockUndo> BlockManager::ReadBlockUndo(const CBlockIndex& index)
+{
+    if (!index.pprev) return std::make_shared<const CBlockUndo>();
+
+    const uint256 hash{index.GetBlockHash()};
+    if (auto blockundo{m_undo_cache.Get(hash)}) return blockundo;
+
+    auto blockundo{std::make_shared<CBlockUndo>()};
+    if (!UndoReadFromDisk(*blockundo, &index)) {
+        return nullptr;
+    }
+    const size_t usage{memusage::DynamicUsage(blockundo) + DynamicUsage(*blockundo)};
+    m_undo_cache.Insert(hash, blockundo, usage);
+    return blockundo;
+}
+
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const FlatFilePos& pos, const CMessageHeader::MessageStartChars& message_start)
 {
     FlatFilePos hpos = pos;
     hpos.nPos -= 8; // Seek back 8 bytes for meta header
-    CAutoFile filein(OpenBlockFile(hpos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull()) {
-        return error("%s: OpenBlockFile failed for %s", __func__, pos.ToString());
-    }
-
     try {
         CMessageHeader::MessageStartChars blk_start;
-        unsigned int blk_size;
-
-        filein >> blk_start >> blk_size;
+        unsigned int blk_size{0};
+        bool magic_ok{false};
+
+        const bool opened{ReadFromFile(g_mapped_block_files, BlockFileSeq(), hpos, [&](auto& filein) {
+            filein >> blk_start >> blk_size;
+            magic_ok = memcmp(blk_start, message_start, CMessageHeader::MESSAGE_START_SIZE) == 0;
+            if (!magic_ok || blk_size > MAX_SIZE) return;
+            block.resize(blk_size); // Zeroing of memory is intentional here
+            filein.read(MakeWritableByteSpan(block));
+        })};
+        if (!opened) {
+            return error("%s: OpenBlockFile failed for %s", __func__, pos.ToString());
+        }
 
-        if (memcmp(blk_start, message_start, CMessageHeader::MESSAGE_START_SIZE)) {
+        if (!magic_ok) {
             return error("%s: Block magic mismatch for %s: %s versus expected %s", __func__, pos.ToString(),
                          HexStr(blk_start),
                          HexStr(message_start));
@@ -789,9 +1105,6 @@ bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const FlatFilePos& pos, c
             return error("%s: Block data is larger than maximum deserialization size for %s: %s versus %s", __func__, pos.ToString(),
                          blk_size, MAX_SIZE);
         }
-
-        block.resize(blk_size); // Zeroing of memory is intentional here
-        filein.read(MakeWritableByteSpan(block));
     } catch (const std::exception& e) {
         return error("%s: Read from block file failed: %s for %s", __func__, e.what(), pos.ToString());
     }
@@ -9,12 +9,16 @@
 #include <chain.h>
 #include <fs.h>
 #include <kernel/cs_main.h>
+#include <node/blockcache.h>
 #include <protocol.h>
+#include <support/allocators/pool.h>
 #include <sync.h>
 #include <txdb.h>
 
 #include <atomic>
 #include <cstdint>
+#include <functional>
+#include <memory>
 #include <unordered_map>
 #include <vector>
 
@@ -25,6 +29,7 @@ class CBlockFileInfo;
 class CBlockUndo;
 class CChain;
 class CChainParams;
+class CPoWCheck;
 class Chainstate;
 class ChainstateManager;
 struct CCheckpointData;
@@ -32,9 +37,13 @@ struct FlatFilePos;
 namespace Consensus {
 struct Params;
 }
+template <typename T>
+class CCheckQueue;
 
 namespace node {
 static constexpr bool DEFAULT_STOPAFTERBLOCKIMPORT{false};
+/** Default for -blockindexsnapshot. */
+static constexpr bool DEFAULT_BLOCK_INDEX_SNAPSHOT{false};
 
 /** The pre-allocation chunk size for blk?????.dat files (since 0.8) */
 static const unsigned int BLOCKFILE_CHUNK_SIZE = 0x1000000; // 16 MiB
@@ -43,6 +52,12 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 /** The maximum size of a blk?????.dat file (since 0.8) */
 static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
 
+/**
+ * The most blk?????.dat and, separately, rev?????.dat files kept memory mapped
+ * for reading. Mapping is left to 64-bit systems, where address space is plenty.
+ */
+static constexpr size_t MAX_MAPPED_BLOCK_FILES{sizeof(void*) >= 8 ? 64 : 0};
+
 /** Size of header written by WriteBlockToDisk before a serialized CBlock */
 static constexpr size_t BLOCK_SERIALIZATION_HEADER_SIZE = CMessageHeader::MESSAGE_START_SIZE + sizeof(unsigned int);
 
@@ -58,7 +73,12 @@ extern uint64_t nPruneTarget;
 // we ever switch to another associative container, we need to either use a
 // container that has stable addressing (true of all std associative
 // containers), or make the key a `std::unique_ptr<CBlockIndex>`
-using BlockMap = std::unordered_map<uint256, CBlockIndex, BlockHasher>;
+//
+// The nodes are allocated from a PoolResource, which packs them into large
+// chunks instead of allocating each of the millions of entries on its own.
+using BlockMap = std::unordered_map<uint256, CBlockIndex, BlockHasher, std::equal_to<uint256>,
+                                    PoolAllocator<std::pair<const uint256, CBlockIndex>,
+                                                  sizeof(std::pair<const uint256, CBlockIndex>) + sizeof(void*) * 4>>;
 
 struct CBlockIndexWorkComparator {
     bool operator()(const CBlockIndex* pa, const CBlockIndex* pb) const;
@@ -91,8 +111,13 @@ private:
      * per index entry (nStatus, nChainWork, nTimeMax, etc.) as well as peripheral
      * collections like m_dirty_blockindex.
      */
-    bool LoadBlockIndex(const Consensus::Params& consensus_params)
+    bool LoadBlockIndex(const Consensus::Params& consensus_params, CCheckQueue<CPoWCheck>* pow_queue)
         EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    /**
+     * Build the block index from the snapshot file, if there is one matching
+     * the database. Returns false, leaving the index empty, if not.
+     */
+    bool LoadBlockIndexSnapshot() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     void FlushBlockFile(bool fFinalize = false, bool finalize_undo = false);
     void FlushUndoFile(int block_file, bool finalize = false);
     bool FindBlockPos(FlatFilePos& pos, unsigned int nAddSize, unsigned int nHeight, CChain& active_chain, uint64_t nTime, bool fKnown);
@@ -141,8 +166,14 @@ private:
      */
     std::unordered_map<std::string, PruneLockInfo> m_prune_locks GUARDED_BY(::cs_main);
 
+    /** Memory for the nodes of m_block_index. Must outlive it, so it is declared first. */
+    BlockMap::allocator_type::ResourceType m_block_index_resource;
+
 public:
-    BlockMap m_block_index GUARDED_BY(cs_main);
+    BlockMap m_block_index GUARDED_BY(cs_main){0, BlockHasher{}, BlockMap::key_equal{}, &m_block_index_resource};
+
+    /** Estimated memory used by m_block_index and its entries. */
+    size_t BlockIndexMemoryUsage() const EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     std::vector<CBlockIndex*> GetAllBlockIndices() EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
 
@@ -155,7 +186,23 @@ public:
     std::unique_ptr<CBlockTreeDB> m_block_tree_db GUARDED_BY(::cs_main);
 
     bool WriteBlockIndexDB() EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
-    bool LoadBlockIndexDB(const Consensus::Params& consensus_params) EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+    /**
+     * Load the block index, from the snapshot file if m_use_index_snapshot is
+     * set and the snapshot matches the database. Header PoW checks run on
+     * pow_queue's worker threads if given.
+     */
+    bool LoadBlockIndexDB(const Consensus::Params& consensus_params, CCheckQueue<CPoWCheck>* pow_queue = nullptr) EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+
+    /**
+     * Save the fully built block index to a snapshot file, for a faster
+     * LoadBlockIndexDB() on the next start. Only done when everything has been
+     * written to the block tree database, as on shutdown; the database stays
+     * the source of truth and the snapshot is used at most once.
+     */
+    bool WriteBlockIndexSnapshot() EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+
+    /** Whether to load the block index from, and save it to, a snapshot file. */
+    bool m_use_index_snapshot{DEFAULT_BLOCK_INDEX_SNAPSHOT};
 
     CBlockIndex* AddToBlockIndex(const CBlockHeader& block, CBlockIndex*& best_header) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     /** Create a new block index entry for a given block hash */
@@ -188,11 +235,44 @@ public:
     /** True if any block files have ever been pruned. */
     bool m_have_pruned = false;
 
+    /** How much header proof-of-work to recompute when loading the block index. */
+    BlockIndexPoWCheck m_check_block_index_pow{DEFAULT_CHECKBLOCKINDEXPOW};
+
     //! Check whether the block associated with this index entry is pruned or not.
     bool IsBlockPruned(const CBlockIndex* pblockindex) EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
 
     //! Create or update a prune lock identified by its name
     void UpdatePruneLock(const std::string& name, const PruneLockInfo& lock_info) EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+
+    /**
+     * Flushes block and undo files. Files that are finished with are flushed
+     * in the background; FlushStateToDisk() waits for those before writing
+     * the block index that refers to their data.
+     */
+    FlatFileFlusher m_flusher{"blkflush"};
+
+    /** Recently read blocks and undo data, for ReadBlock and ReadBlockUndo. */
+    BlockCache<CBlock> m_block_cache{DEFAULT_MAX_BLOCK_CACHE_BYTES / 2};
+    BlockCache<CBlockUndo> m_undo_cache{DEFAULT_MAX_BLOCK_CACHE_BYTES / 2};
+
+    /** Split max_bytes evenly between the block and undo data caches. */
+    void ResizeBlockCache(size_t max_bytes);
+
+    /**
+     * Read the block of index, from the cache if it was read recently. A block
+     * read from disk is only added to the cache if fill_cache is set; readers
+     * of old blocks that are unlikely to be read again, such as peers syncing
+     * from us, unset it so they do not push out the blocks being worked on.
+     * Returns nullptr on failure.
+     */
+    std::shared_ptr<const CBlock> ReadBlock(const CBlockIndex& index, const Consensus::Params& consensus_params, bool fill_cache = true);
+
+    /**
+     * Read the undo data of index, from the cache if it was read recently.
+     * The genesis block has none; it gets an empty CBlockUndo. Returns nullptr
+     * on failure.
+     */
+    std::shared_ptr<const CBlockUndo> ReadBlockUndo(const CBlockIndex& index);
 };
 
 void CleanupBlockRevFiles();
@@ -208,8 +288,13 @@ fs::path GetBlockPosFilename(const FlatFilePos& pos);
 void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune);
 
 /** Functions for disk access for blocks */
-bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const Consensus::Params& consensusParams);
-bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const Consensus::Params& consensusParams, bool check_pow = true);
+/**
+ * Read the block for an index entry and check that it matches the indexed hash.
+ * The proof of work is only recomputed if check_pow is set or the entry is not
+ * yet BLOCK_VALID_TREE.
+ */
+bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams, bool check_pow = false);
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const FlatFilePos& pos, const CMessageHeader::MessageStartChars& message_start);
 
 bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex);
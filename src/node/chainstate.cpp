@@ -65,6 +65,9 @@ ChainstateLoadResult LoadChainstate(ChainstateManager& chainman, const CacheSize
     // fails if it's still open from the previous loop. Close it first:
     pblocktree.reset();
     pblocktree.reset(new CBlockTreeDB(cache_sizes.block_tree_db, options.block_tree_db_in_memory, options.reindex));
+    chainman.m_blockman.m_check_block_index_pow = options.check_block_index_pow;
+    chainman.m_blockman.ResizeBlockCache(options.block_cache_bytes);
+    chainman.m_blockman.m_use_index_snapshot = options.use_index_snapshot;
 
     if (options.reindex) {
         pblocktree->WriteReindexing(true);
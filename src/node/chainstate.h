@@ -27,6 +27,9 @@ struct ChainstateLoadOptions {
     bool prune{false};
     int64_t check_blocks{DEFAULT_CHECKBLOCKS};
     int64_t check_level{DEFAULT_CHECKLEVEL};
+    BlockIndexPoWCheck check_block_index_pow{DEFAULT_CHECKBLOCKINDEXPOW};
+    size_t block_cache_bytes{DEFAULT_MAX_BLOCK_CACHE_BYTES};
+    bool use_index_snapshot{DEFAULT_BLOCK_INDEX_SNAPSHOT};
     std::function<bool()> check_interrupt;
     std::function<void()> coins_error_cb;
 };
@@ -30,6 +30,8 @@ class WalletLoader;
 } // namespace interfaces
 
 namespace node {
+class LiveBlockTemplate;
+
 //! NodeContext struct containing references to chain state and connection
 //! state.
 //!
@@ -61,6 +63,8 @@ struct NodeContext {
     //! opened by the gui.
     interfaces::WalletLoader* wallet_loader{nullptr};
     std::unique_ptr<CScheduler> scheduler;
+    //! Block template kept up to date for getblocktemplate, made on first use.
+    std::shared_ptr<LiveBlockTemplate> block_template;
     std::function<void()> rpc_interruption_point = [] {};
 
     //! Declare default constructor and destructor that are not inline, so code
@@ -13,6 +13,7 @@
 #include <consensus/merkle.h>
 #include <consensus/tx_verify.h>
 #include <consensus/validation.h>
+#include <crypto/Lyra2Z/Lyra2Z.h>
 #include <deploymentstatus.h>
 #include <policy/feerate.h>
 #include <policy/policy.h>
@@ -20,10 +21,18 @@
 #include <primitives/transaction.h>
 #include <timedata.h>
 #include <util/moneystr.h>
+#include <util/strencodings.h>
 #include <util/system.h>
+#include <util/thread.h>
+#include <util/time.h>
 #include <validation.h>
+#include <versionbits.h>
 
 #include <algorithm>
+#include <atomic>
+#include <limits>
+#include <set>
+#include <thread>
 #include <utility>
 
 namespace node {
@@ -65,6 +74,7 @@ BlockAssembler::Options::Options()
 
 BlockAssembler::BlockAssembler(Chainstate& chainstate, const CTxMemPool* mempool, const Options& options)
     : test_block_validity{options.test_block_validity},
+      m_print_priority{gArgs.GetBoolArg("-printpriority", DEFAULT_PRINTPRIORITY)},
       chainparams{chainstate.m_chainman.GetParams()},
       m_mempool(mempool),
       m_chainstate(chainstate)
@@ -86,6 +96,117 @@ void ApplyArgsManOptions(const ArgsManager& gArgs, BlockAssembler::Options& opti
         options.blockMinFeeRate = CFeeRate{DEFAULT_BLOCK_MIN_TX_FEE};
     }
 }
+int GetMinerThreads(const ArgsManager& args)
+{
+    // Like -par, 0 means all cores and a negative value leaves that many free.
+    int threads = args.GetIntArg("-minerthreads", DEFAULT_MINER_THREADS);
+    if (threads <= 0) threads += GetNumCores();
+    return std::max(threads, 1);
+}
+
+/** Nonces a search thread hashes at once, the most scrypt lanes GetPoWHashes() uses. */
+static constexpr size_t NONCE_SEARCH_BATCH{MAX_POW_CHECK_HEADERS};
+
+/** Try the nonces first, first + stride, ... below end, until one at or above found. */
+static void SearchNonces(CBlockHeader header, const Consensus::Params& params, uint64_t first, uint64_t end, uint64_t stride,
+                         std::atomic<uint64_t>& found, const std::function<bool()>& interrupted)
+{
+    const bool lyra2z{(header.nVersion & VERSIONBITS_FORK_LYRA2Z) != 0};
+    lyra2z_midstate midstate;
+    if (lyra2z) lyra2z_midstate_init(&midstate, BEGIN(header.nVersion));
+
+    std::vector<CBlockHeader> batch;
+    std::vector<uint256> hashes;
+    for (uint64_t nonce = first; nonce < end && nonce < found.load(std::memory_order_relaxed) && !interrupted();) {
+        batch.clear();
+        for (; batch.size() < NONCE_SEARCH_BATCH && nonce < end; nonce += stride) {
+            header.nNonce = nonce;
+            batch.push_back(header);
+        }
+        if (lyra2z) {
+            hashes.resize(batch.size());
+            for (size_t i = 0; i < batch.size(); ++i) {
+                lyra2z_hash_midstate(&midstate, BEGIN(batch[i].nVersion), BEGIN(hashes[i]));
+            }
+        } else {
+            hashes = GetPoWHashes(batch);
+        }
+        for (size_t i = 0; i < batch.size(); ++i) {
+            if (!CheckProofOfWork(hashes[i], header.nBits, params)) continue;
+            uint64_t lowest{found.load()};
+            while (batch[i].nNonce < lowest && !found.compare_exchange_weak(lowest, batch[i].nNonce)) {}
+            return;
+        }
+    }
+}
+
+NonceSearcher::NonceSearcher(int threads) : m_threads{std::max(threads, 1)}
+{
+    for (int t = 1; t < m_threads; ++t) {
+        m_workers.emplace_back(&util::TraceThread, strprintf("miner.%i", t), [this, t] { Loop(t); });
+    }
+}
+
+NonceSearcher::~NonceSearcher()
+{
+    WITH_LOCK(m_mutex, m_request_stop = true);
+    m_worker_cv.notify_all();
+    for (std::thread& worker : m_workers) worker.join();
+}
+
+void NonceSearcher::Loop(int thread)
+{
+    uint64_t search{0};
+    while (true) {
+        CBlockHeader header;
+        const Consensus::Params* params;
+        uint64_t end;
+        const std::function<bool()>* interrupted;
+        {
+            WAIT_LOCK(m_mutex, lock);
+            while (m_search == search && !m_request_stop) m_worker_cv.wait(lock);
+            if (m_request_stop) return;
+            search = m_search;
+            header = m_header;
+            params = m_params;
+            end = m_end;
+            interrupted = m_interrupted;
+        }
+        SearchNonces(header, *params, uint64_t{header.nNonce} + thread, end, m_threads, m_found, *interrupted);
+        {
+            LOCK(m_mutex);
+            if (--m_running == 0) m_done_cv.notify_one();
+        }
+    }
+}
+
+bool NonceSearcher::Search(CBlockHeader& header, const Consensus::Params& params, uint64_t& max_tries,
+                           const std::function<bool()>& interrupted)
+{
+    const uint64_t start{header.nNonce};
+    const uint64_t end{start + std::min<uint64_t>(max_tries, std::numeric_limits<uint32_t>::max() - start)};
+    m_found = end;
+    {
+        LOCK(m_mutex);
+        ++m_search;
+        m_header = header;
+        m_params = &params;
+        m_end = end;
+        m_interrupted = &interrupted;
+        m_running = m_workers.size();
+    }
+    m_worker_cv.notify_all();
+    SearchNonces(header, params, start, end, m_threads, m_found, interrupted);
+    {
+        WAIT_LOCK(m_mutex, lock);
+        while (m_running > 0) m_done_cv.wait(lock);
+    }
+
+    header.nNonce = m_found;
+    max_tries -= m_found - start;
+    return m_found < end;
+}
+
 static BlockAssembler::Options ConfiguredOptions()
 {
     BlockAssembler::Options options;
@@ -190,6 +311,190 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     return std::move(pblocktemplate);
 }
 
+std::unique_ptr<CBlockTemplate> BlockAssembler::UpdateBlock(std::unique_ptr<CBlockTemplate> block_template, const std::vector<uint256>& added)
+{
+    const auto time_start{SteadyClock::now()};
+
+    LOCK(::cs_main);
+    CBlockIndex* pindexPrev = m_chainstate.m_chain.Tip();
+    assert(pindexPrev != nullptr);
+    if (!m_mempool || block_template->block.hashPrevBlock != pindexPrev->GetBlockHash()) {
+        return nullptr;
+    }
+
+    resetBlock();
+    pblocktemplate = std::move(block_template);
+    CBlock* const pblock = &pblocktemplate->block; // pointer for convenience
+    nHeight = pindexPrev->nHeight + 1;
+    m_lock_time_cutoff = pindexPrev->GetMedianTimePast();
+
+    LOCK(m_mempool->cs);
+
+    // Keep the transactions still in the mempool, in their order, and drop
+    // the others along with anything spending them.
+    std::vector<CTransactionRef> vtx;
+    vtx.swap(pblock->vtx);
+    pblock->vtx.push_back(vtx[0]);
+    pblocktemplate->vTxFees.resize(1);
+    pblocktemplate->vTxSigOpsCost.resize(1);
+    std::set<uint256> dropped;
+    for (size_t i = 1; i < vtx.size(); ++i) {
+        const auto iter{m_mempool->GetIter(vtx[i]->GetHash())};
+        const bool spends_dropped{std::any_of(vtx[i]->vin.begin(), vtx[i]->vin.end(),
+                                              [&](const CTxIn& txin) { return dropped.count(txin.prevout.hash) > 0; })};
+        if (!iter || spends_dropped) {
+            dropped.insert(vtx[i]->GetHash());
+            continue;
+        }
+        AddToBlock(*iter);
+    }
+    // The room freed might have gone to a package that was left out.
+    if (!dropped.empty() && pblocktemplate->m_packages_left_out) {
+        return nullptr;
+    }
+
+    int nPackagesSelected = 0;
+    for (const uint256& txid : added) {
+        const auto iter{m_mempool->GetIter(txid)};
+        if (!iter || inBlock.count(*iter)) {
+            continue;
+        }
+
+        auto ancestors{m_mempool->AssumeCalculateMemPoolAncestors(__func__, **iter, CTxMemPool::Limits::NoLimits(), /*fSearchForParents=*/false)};
+        onlyUnconfirmed(ancestors);
+        ancestors.insert(*iter);
+
+        uint64_t packageSize{0};
+        CAmount packageFees{0};
+        int64_t packageSigOpsCost{0};
+        for (CTxMemPool::txiter it : ancestors) {
+            packageSize += it->GetTxSize();
+            packageFees += it->GetModifiedFee();
+            packageSigOpsCost += it->GetSigOpCost();
+        }
+        if (packageFees < blockMinFeeRate.GetFee(packageSize)) {
+            continue;
+        }
+        const CFeeRate package_feerate{packageFees, static_cast<uint32_t>(packageSize)};
+
+        if (!TestPackage(packageSize, packageSigOpsCost)) {
+            // Only worth a new block if it would have displaced a package.
+            if (package_feerate > pblocktemplate->m_lowest_package_feerate) {
+                return nullptr;
+            }
+            pblocktemplate->m_packages_left_out = true;
+            continue;
+        }
+        if (!TestPackageTransactions(ancestors)) {
+            continue;
+        }
+
+        std::vector<CTxMemPool::txiter> sortedEntries;
+        SortForBlock(ancestors, sortedEntries);
+        for (CTxMemPool::txiter entry : sortedEntries) {
+            AddToBlock(entry);
+        }
+        ++nPackagesSelected;
+        pblocktemplate->m_lowest_package_feerate = std::min(pblocktemplate->m_lowest_package_feerate, package_feerate);
+    }
+
+    m_last_block_num_txs = nBlockTx;
+    m_last_block_weight = nBlockWeight;
+
+    // Pay the new fees to the coinbase, and recommit to the witnesses.
+    CMutableTransaction coinbaseTx{*pblock->vtx[0]};
+    coinbaseTx.vout.resize(1);
+    coinbaseTx.vout[0].nValue = nFees + GetBlockSubsidy(nHeight, chainparams.GetConsensus());
+    coinbaseTx.vin[0].scriptWitness.SetNull();
+    pblock->vtx[0] = MakeTransactionRef(std::move(coinbaseTx));
+    pblocktemplate->vchCoinbaseCommitment = m_chainstate.m_chainman.GenerateCoinbaseCommitment(*pblock, pindexPrev);
+    pblocktemplate->vTxFees[0] = -nFees;
+
+    UpdateTime(pblock, chainparams.GetConsensus(), pindexPrev);
+
+    BlockValidationState state;
+    if (test_block_validity && !TestBlockValidity(state, chainparams, m_chainstate, *pblock, pindexPrev,
+                                                  GetAdjustedTime, /*fCheckPOW=*/false, /*fCheckMerkleRoot=*/false)) {
+        throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s", __func__, state.ToString()));
+    }
+
+    LogPrint(BCLog::BENCH, "UpdateBlock() %u dropped, %d of %u added packages: %.2fms\n",
+             dropped.size(), nPackagesSelected, added.size(), Ticks<MillisecondsDouble>(SteadyClock::now() - time_start));
+
+    return std::move(pblocktemplate);
+}
+
+/** Last LiveBlockTemplate revision handed out, shared so none is ever reused. */
+static std::atomic<uint64_t> g_live_template_revision{0};
+
+LiveBlockTemplate::LiveBlockTemplate(Chainstate& chainstate, const CTxMemPool& mempool, const CScript& script_pub_key)
+    : LiveBlockTemplate(chainstate, mempool, script_pub_key, ConfiguredOptions()) {}
+
+LiveBlockTemplate::LiveBlockTemplate(Chainstate& chainstate, const CTxMemPool& mempool, const CScript& script_pub_key, const BlockAssembler::Options& options)
+    : m_chainstate{chainstate}, m_mempool{mempool}, m_script_pub_key{script_pub_key}, m_options{options} {}
+
+bool LiveBlockTemplate::NeedsUpdate(unsigned int transactions_updated) const
+{
+    AssertLockHeld(::cs_main);
+
+    const bool new_tip{!m_template || m_template->block.hashPrevBlock != m_chainstate.m_chain.Tip()->GetBlockHash()};
+    return new_tip || (transactions_updated != m_transactions_updated && GetTime() - m_last_update >= LIVE_TEMPLATE_UPDATE_INTERVAL);
+}
+
+CBlockTemplate& LiveBlockTemplate::Get(unsigned int transactions_updated)
+{
+    AssertLockHeld(::cs_main);
+
+    if (!NeedsUpdate(transactions_updated)) return *m_template;
+    const int64_t now{GetTime()};
+
+    std::vector<uint256> added;
+    bool stale;
+    {
+        LOCK(m_added_mutex);
+        added.swap(m_added);
+        stale = std::exchange(m_stale, false);
+    }
+    // UpdateBlock() does not revisit the packages already selected, whose
+    // order a fee delta may have changed.
+    const unsigned int prioritisations_updated{m_mempool.GetPrioritisationsUpdated()};
+    if (prioritisations_updated != m_prioritisations_updated) stale = true;
+
+    m_transactions_updated = transactions_updated;
+    m_prioritisations_updated = prioritisations_updated;
+    m_last_update = now;
+    m_revision = ++g_live_template_revision;
+    if (m_template && !stale) {
+        m_template = BlockAssembler{m_chainstate, &m_mempool, m_options}.UpdateBlock(std::move(m_template), added);
+    } else {
+        m_template.reset();
+    }
+    if (!m_template) {
+        m_template = BlockAssembler{m_chainstate, &m_mempool, m_options}.CreateNewBlock(m_script_pub_key);
+    }
+    return *m_template;
+}
+
+/** Pending additions beyond which the template is made afresh instead. */
+static constexpr size_t MAX_LIVE_TEMPLATE_ADDED{10000};
+
+void LiveBlockTemplate::TransactionAddedToMempool(const CTransactionRef& tx, uint64_t mempool_sequence)
+{
+    LOCK(m_added_mutex);
+    if (m_added.size() >= MAX_LIVE_TEMPLATE_ADDED) {
+        m_added.clear();
+        m_stale = true;
+    }
+    if (!m_stale) m_added.push_back(tx->GetHash());
+}
+
+void LiveBlockTemplate::UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload)
+{
+    // Get() makes a new template for the new tip, from the whole mempool.
+    LOCK(m_added_mutex);
+    m_added.clear();
+}
+
 void BlockAssembler::onlyUnconfirmed(CTxMemPool::setEntries& testSet)
 {
     for (CTxMemPool::setEntries::iterator iit = testSet.begin(); iit != testSet.end(); ) {
@@ -237,8 +542,7 @@ void BlockAssembler::AddToBlock(CTxMemPool::txiter iter)
     nFees += iter->GetFee();
     inBlock.insert(iter);
 
-    bool fPrintPriority = gArgs.GetBoolArg("-printpriority", DEFAULT_PRINTPRIORITY);
-    if (fPrintPriority) {
+    if (m_print_priority) {
         LogPrintf("fee rate %s txid %s\n",
                   CFeeRate(iter->GetModifiedFee(), iter->GetTxSize()).ToString(),
                   iter->GetTx().GetHash().ToString());
@@ -383,6 +687,7 @@ void BlockAssembler::addPackageTxs(const CTxMemPool& mempool, int& nPackagesSele
         }
 
         if (!TestPackage(packageSize, packageSigOpsCost)) {
+            pblocktemplate->m_packages_left_out = true;
             if (fUsingModified) {
                 // Since we always look at the best entry in mapModifiedTx,
                 // we must erase failed entries so that we can consider the
@@ -429,6 +734,7 @@ void BlockAssembler::addPackageTxs(const CTxMemPool& mempool, int& nPackagesSele
         }
 
         ++nPackagesSelected;
+        pblocktemplate->m_lowest_package_feerate = std::min(pblocktemplate->m_lowest_package_feerate, CFeeRate(packageFees, packageSize));
 
         // Update transactions that depend on each of these
         nDescendantsUpdated += UpdatePackagesForAdded(mempool, ancestors, mapModifiedTx);
@@ -6,26 +6,39 @@
 #ifndef BITCOIN_NODE_MINER_H
 #define BITCOIN_NODE_MINER_H
 
+#include <consensus/amount.h>
+#include <kernel/cs_main.h>
+#include <policy/feerate.h>
 #include <primitives/block.h>
+#include <script/script.h>
+#include <sync.h>
 #include <txmempool.h>
+#include <validationinterface.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <functional>
 #include <memory>
 #include <optional>
 #include <stdint.h>
+#include <thread>
+#include <vector>
 
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index_container.hpp>
 
 class ArgsManager;
+class Chainstate;
 class ChainstateManager;
 class CBlockIndex;
 class CChainParams;
-class CScript;
 
 namespace Consensus { struct Params; };
 
 namespace node {
 static const bool DEFAULT_PRINTPRIORITY = false;
+/** Default for -minerthreads, the threads the generate RPCs search nonces on */
+static constexpr int DEFAULT_MINER_THREADS{1};
 
 struct CBlockTemplate
 {
@@ -33,6 +46,10 @@ struct CBlockTemplate
     std::vector<CAmount> vTxFees;
     std::vector<int64_t> vTxSigOpsCost;
     std::vector<unsigned char> vchCoinbaseCommitment;
+    /** Lowest feerate of the packages selected, for BlockAssembler::UpdateBlock() */
+    CFeeRate m_lowest_package_feerate{MAX_MONEY};
+    /** Whether a package paying the minimum feerate was left out for lack of room */
+    bool m_packages_left_out{false};
 };
 
 // Container for tracking updates to ancestor feerate as we include (parent)
@@ -138,6 +155,9 @@ private:
 
     // Whether to call TestBlockValidity() at the end of CreateNewBlock().
     const bool test_block_validity;
+    // Whether to log the feerate of each transaction added (-printpriority),
+    // read once rather than for every transaction.
+    const bool m_print_priority;
 
     // Information on the current status of the block
     uint64_t nBlockWeight;
@@ -168,6 +188,20 @@ public:
     /** Construct a new block template with coinbase to scriptPubKeyIn */
     std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn);
 
+    /**
+     * Bring a template from CreateNewBlock() for the current tip up to date
+     * with the mempool, without walking all of it again. Transactions no
+     * longer in the mempool are dropped along with those spending them, and
+     * the packages of the added transactions are appended where they fit.
+     *
+     * @param[in] added  Transactions added to the mempool since the template
+     *                   was made or last updated; they need not still be there.
+     * @returns the updated template, or nullptr if it must be made afresh:
+     *          the tip changed, or the changes could have made the block
+     *          choose differently among the packages that do not all fit.
+     */
+    std::unique_ptr<CBlockTemplate> UpdateBlock(std::unique_ptr<CBlockTemplate> block_template, const std::vector<uint256>& added);
+
     inline static std::optional<int64_t> m_last_block_num_txs{};
     inline static std::optional<int64_t> m_last_block_weight{};
 
@@ -203,8 +237,127 @@ int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParam
 /** Update an old GenerateCoinbaseCommitment from CreateNewBlock after the block txs have changed */
 void RegenerateCommitments(CBlock& block, ChainstateManager& chainman);
 
+/** Seconds a LiveBlockTemplate for the same tip keeps its transactions before following the mempool again */
+static constexpr int64_t LIVE_TEMPLATE_UPDATE_INTERVAL{5};
+
+/**
+ * A block template for the active chain tip that follows the mempool. It
+ * collects the transactions added to the mempool from the validation
+ * interface and applies them with BlockAssembler::UpdateBlock() when next
+ * asked for the template, so that only a new tip, a package that does not
+ * fit, or a changed fee delta makes it assemble a block from scratch.
+ *
+ * Every update still ends in TestBlockValidity(), so for the same tip the
+ * template follows the mempool at most every LIVE_TEMPLATE_UPDATE_INTERVAL
+ * seconds, as getblocktemplate's rebuilds used to.
+ */
+class LiveBlockTemplate final : public CValidationInterface
+{
+public:
+    LiveBlockTemplate(Chainstate& chainstate, const CTxMemPool& mempool, const CScript& script_pub_key);
+    LiveBlockTemplate(Chainstate& chainstate, const CTxMemPool& mempool, const CScript& script_pub_key, const BlockAssembler::Options& options);
+
+    /**
+     * The template, brought up to date with the tip and the mempool.
+     *
+     * @param[in] transactions_updated  CTxMemPool::GetTransactionsUpdated(),
+     *     read under cs_main before the validation interface queue was last
+     *     synced, so that every transaction it counts has been notified.
+     */
+    CBlockTemplate& Get(unsigned int transactions_updated) EXCLUSIVE_LOCKS_REQUIRED(::cs_main, !m_added_mutex);
+
+    /** Whether Get() would change the template, rather than return it as is. */
+    bool NeedsUpdate(unsigned int transactions_updated) const EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+
+    /** Changes whenever Get() changes the transactions of the template, and
+     *  is never the same for two different LiveBlockTemplates. */
+    uint64_t GetRevision() const EXCLUSIVE_LOCKS_REQUIRED(::cs_main) { return m_revision; }
+
+    /** The transactions_updated the template's transactions follow the mempool up to */
+    unsigned int GetTransactionsUpdated() const EXCLUSIVE_LOCKS_REQUIRED(::cs_main) { return m_transactions_updated; }
+
+protected:
+    void TransactionAddedToMempool(const CTransactionRef& tx, uint64_t mempool_sequence) override EXCLUSIVE_LOCKS_REQUIRED(!m_added_mutex);
+    void UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload) override EXCLUSIVE_LOCKS_REQUIRED(!m_added_mutex);
+
+private:
+    Chainstate& m_chainstate;
+    const CTxMemPool& m_mempool;
+    const CScript m_script_pub_key;
+    const BlockAssembler::Options m_options;
+
+    std::unique_ptr<CBlockTemplate> m_template GUARDED_BY(::cs_main);
+    uint64_t m_revision GUARDED_BY(::cs_main){0};
+    /** The transactions_updated the template was last updated for */
+    unsigned int m_transactions_updated GUARDED_BY(::cs_main){0};
+    /** CTxMemPool::GetPrioritisationsUpdated() when the template was last updated */
+    unsigned int m_prioritisations_updated GUARDED_BY(::cs_main){0};
+    /** When the template's transactions were last updated */
+    int64_t m_last_update GUARDED_BY(::cs_main){0};
+
+    Mutex m_added_mutex;
+    /** Transactions added to the mempool since the template was last updated */
+    std::vector<uint256> m_added GUARDED_BY(m_added_mutex);
+    /** Set when m_added overflowed, so that the template is made afresh */
+    bool m_stale GUARDED_BY(m_added_mutex){false};
+};
+
 /** Apply -blockmintxfee and -blockmaxweight options from ArgsManager to BlockAssembler options. */
 void ApplyArgsManOptions(const ArgsManager& gArgs, BlockAssembler::Options& options);
+
+/** The number of nonce search threads set by -minerthreads. */
+int GetMinerThreads(const ArgsManager& args);
+
+/**
+ * Searches nonces over a number of threads. The threads besides the caller's
+ * are started once and wait between searches, so that mining many blocks in
+ * a row does not start a thread per block.
+ */
+class NonceSearcher
+{
+public:
+    explicit NonceSearcher(int threads);
+    ~NonceSearcher();
+
+    /**
+     * Search the nonces from header.nNonce up, short of UINT32_MAX, for one that
+     * gives the header a valid proof of work, trying at most max_tries of them.
+     * The nonces are interleaved over the threads, which all stop once past the
+     * lowest valid nonce found, so the result does not depend on the thread
+     * count. Lyra2Z headers only rehash the part holding the nonce.
+     *
+     * @returns whether a valid nonce was found. header.nNonce is set to it, or
+     *          else to the first nonce not tried, and max_tries is reduced by the
+     *          number of nonces before it. Once interrupted() returns true, the
+     *          search stops early and its result is meaningless.
+     */
+    bool Search(CBlockHeader& header, const Consensus::Params& params, uint64_t& max_tries,
+                const std::function<bool()>& interrupted) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    void Loop(int thread) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    Mutex m_mutex;
+    //! Workers wait on this for a search, or to stop
+    std::condition_variable m_worker_cv;
+    //! Search() waits on this for the workers to finish
+    std::condition_variable m_done_cv;
+
+    //! The search the workers take part in, counted up for each new one
+    uint64_t m_search GUARDED_BY(m_mutex){0};
+    CBlockHeader m_header GUARDED_BY(m_mutex);
+    const Consensus::Params* m_params GUARDED_BY(m_mutex){nullptr};
+    uint64_t m_end GUARDED_BY(m_mutex){0};
+    const std::function<bool()>* m_interrupted GUARDED_BY(m_mutex){nullptr};
+    //! Workers still searching
+    int m_running GUARDED_BY(m_mutex){0};
+    bool m_request_stop GUARDED_BY(m_mutex){false};
+
+    //! Lowest valid nonce found, or the end of the search
+    std::atomic<uint64_t> m_found{0};
+    const int m_threads;
+    std::vector<std::thread> m_workers;
+};
 } // namespace node
 
 #endif // BITCOIN_NODE_MINER_H
@@ -25,10 +25,11 @@ void ApplyArgsManOptions(const ArgsManager& argsman, ValidationCacheSizes& cache
         //    elements). Therefore, we can use 0 as a floor here.
         // 2. Multiply first, divide after to avoid integer truncation.
         size_t clamped_size_each = std::max<int64_t>(*max_size, 0) * (1 << 20) / 2;
-        cache_sizes = {
-            .signature_cache_bytes = clamped_size_each,
-            .script_execution_cache_bytes = clamped_size_each,
-        };
+        cache_sizes.signature_cache_bytes = clamped_size_each;
+        cache_sizes.script_execution_cache_bytes = clamped_size_each;
+    }
+    if (auto max_size = argsman.GetIntArg("-maxpowcachesize")) {
+        cache_sizes.pow_cache_bytes = std::max<int64_t>(*max_size, 0) * (1 << 20);
     }
 }
 } // namespace node
@@ -5,9 +5,12 @@
 #include <pow.h>
 #include <arith_uint256.h>
 #include <chain.h>
+#include <powcache.h>
 #include <primitives/block.h>
 #include <uint256.h>
 
+#include <algorithm>
+
 unsigned int GetNextWorkRequired_Legacy(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params)
 {
     assert(pindexLast != nullptr);
@@ -91,6 +94,11 @@ bool PermittedDifficultyTransition(const Consensus::Params& params, int64_t heig
 {
     if (params.fPowAllowMinDifficultyBlocks) return true;
 
+    // From the fork on, the target is recomputed every block from a window of
+    // earlier blocks, which old_nbits alone does not bound. See the overload
+    // taking the nBits of that window.
+    if (height >= params.Lyra2zHFHeight) return true;
+
     if (height % params.DifficultyAdjustmentInterval() == 0) {
         int64_t smallest_timespan = params.nPowTargetTimespan/4;
         int64_t largest_timespan = params.nPowTargetTimespan*4;
@@ -155,10 +163,13 @@ bool CheckProofOfWork(uint256 hash, unsigned int nBits, const Consensus::Params&
     return true;
 }
 
+/** Number of past blocks DarkGravityWave averages the target over. */
+static constexpr int64_t DGW_PAST_BLOCKS{24};
+
 unsigned int static DarkGravityWave(const CBlockIndex* pindexLast, const Consensus::Params& params) {
     /* current difficulty formula, dash - DarkGravity v3, written by Evan Duffield - evan@dash.org */
     const arith_uint256 bnPowLimit = UintToArith256(params.powLimit);
-    int64_t nPastBlocks = 24;
+    int64_t nPastBlocks = DGW_PAST_BLOCKS;
 
     // reset to zero at HF height
     if (pindexLast->nHeight+1 == params.Lyra2zHFHeight) {
@@ -282,3 +293,81 @@ unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHead
 
  return DarkGravityWave(pindexLast, params);
 }
+
+size_t DifficultyTransitionWindow(const Consensus::Params& params)
+{
+    return std::max<int64_t>(DGW_PAST_BLOCKS, params.nZawyLwmaAveragingWindow);
+}
+
+bool PermittedDifficultyTransition(const Consensus::Params& params, int64_t height, Span<const uint32_t> recent_nbits, uint32_t new_nbits)
+{
+    if (params.fPowAllowMinDifficultyBlocks || recent_nbits.empty()) return true;
+    if (height < params.Lyra2zHFHeight) {
+        return PermittedDifficultyTransition(params, height, recent_nbits.back(), new_nbits);
+    }
+
+    size_t window;
+    unsigned int factor;
+    if (height < params.ACMZawyLWMAHeight) {
+        // DarkGravityWave resets to powLimit at the fork and until it has a full window.
+        if (height == params.Lyra2zHFHeight || height - 1 < DGW_PAST_BLOCKS) return true;
+        window = DGW_PAST_BLOCKS;
+        factor = 3;
+    } else {
+        // LWMA allows powLimit until it has a full window.
+        if (height - 1 <= params.nZawyLwmaAveragingWindow) return true;
+        window = params.nZawyLwmaAveragingWindow;
+        factor = 6;
+    }
+    if (recent_nbits.size() < window) return true;
+
+    arith_uint256 max_target;
+    for (const uint32_t nbits : recent_nbits.last(window)) {
+        max_target = std::max(max_target, arith_uint256().SetCompact(nbits));
+    }
+    // Divide rather than multiply, which could overflow for forged nBits.
+    return arith_uint256().SetCompact(new_nbits) / factor <= max_target;
+}
+
+bool PermittedDifficultyTransitions(const Consensus::Params& params, const CBlockIndex& prev, const std::vector<CBlockHeader>& headers)
+{
+    if (params.fPowAllowMinDifficultyBlocks) return true;
+
+    // The nBits of enough of prev's ancestors to fill the largest window,
+    // oldest first, followed by those of the headers.
+    const size_t max_window{DifficultyTransitionWindow(params)};
+    std::vector<uint32_t> nbits;
+    for (const CBlockIndex* pindex = &prev; pindex && nbits.size() < max_window; pindex = pindex->pprev) {
+        nbits.push_back(pindex->nBits);
+    }
+    std::reverse(nbits.begin(), nbits.end());
+    const size_t first = nbits.size();
+    for (const CBlockHeader& header : headers) nbits.push_back(header.nBits);
+
+    for (size_t pos = first; pos < nbits.size(); ++pos) {
+        const int64_t height = prev.nHeight + 1 + (pos - first);
+        if (!PermittedDifficultyTransition(params, height, Span{nbits}.first(pos), nbits[pos])) return false;
+    }
+    return true;
+}
+
+bool CPoWCheck::operator()()
+{
+    std::vector<CBlockHeader> headers;
+    std::vector<uint256> block_hashes;
+    for (const CBlockHeader& header : m_headers) {
+        const uint256 block_hash{header.GetHash()};
+        if (PoWCacheContains(block_hash)) continue;
+        headers.push_back(header);
+        block_hashes.push_back(block_hash);
+    }
+    const std::vector<uint256> hashes{GetPoWHashes(headers)};
+    for (size_t i = 0; i < headers.size(); ++i) {
+        if (!CheckProofOfWork(hashes[i], headers[i].nBits, *m_params)) {
+            if (m_failed_hash) *m_failed_hash = block_hashes[i];
+            return false;
+        }
+        PoWCacheInsert(block_hashes[i]);
+    }
+    return true;
+}
@@ -7,10 +7,13 @@
 #define BITCOIN_POW_H
 
 #include <consensus/params.h>
+#include <primitives/block.h>
+#include <span.h>
 
 #include <stdint.h>
+#include <utility>
+#include <vector>
 
-class CBlockHeader;
 class CBlockIndex;
 class uint256;
 
@@ -34,4 +37,62 @@ bool CheckProofOfWork(uint256 hash, unsigned int nBits, const Consensus::Params&
  */
 bool PermittedDifficultyTransition(const Consensus::Params& params, int64_t height, uint32_t old_nbits, uint32_t new_nbits);
 
+/** Number of preceding nBits the overload below needs to bound those of a block. */
+size_t DifficultyTransitionWindow(const Consensus::Params& params);
+
+/**
+ * As above, given the nBits of the blocks right before height, oldest first.
+ * From the Lyra2Z fork on, new_nbits is bounded by the targets of the
+ * DarkGravityWave or LWMA window, as described below. The bound is only
+ * checked once recent_nbits covers that window.
+ */
+bool PermittedDifficultyTransition(const Consensus::Params& params, int64_t height, Span<const uint32_t> recent_nbits, uint32_t new_nbits);
+
+/**
+ * Return false if the nBits of the consecutive headers following prev could
+ * not have been produced by the difficulty adjustment. This is cheap, so it
+ * can run before any proof of work is computed.
+ *
+ * Up to the Lyra2Z fork each transition is checked with
+ * PermittedDifficultyTransition(). After it, DarkGravityWave and then LWMA
+ * retarget every block from the targets of a window of earlier blocks, and
+ * neither can produce a target above 3 (respectively 6) times the largest
+ * target in that window. That upper bound is what is checked there, as the
+ * lower difficulty is what makes headers cheap to forge.
+ */
+bool PermittedDifficultyTransitions(const Consensus::Params& params, const CBlockIndex& prev, const std::vector<CBlockHeader>& headers);
+
+/** Number of headers a CPoWCheck covers, matching the widest scrypt lane count. */
+static constexpr size_t MAX_POW_CHECK_HEADERS{8};
+
+/**
+ * Closure representing the proof-of-work check of a few headers, so that the
+ * memory-hard Lyra2Z/scrypt hashes of many headers can be spread over a
+ * CCheckQueue. Scrypt headers within one check are hashed side by side.
+ *
+ * If failed_hash is given, the hash of a header that fails the check is
+ * stored there, so the caller can tell which one it was.
+ */
+class CPoWCheck
+{
+private:
+    std::vector<CBlockHeader> m_headers;
+    const Consensus::Params* m_params{nullptr};
+    uint256* m_failed_hash{nullptr};
+
+public:
+    CPoWCheck() = default;
+    CPoWCheck(std::vector<CBlockHeader>&& headers, const Consensus::Params& params, uint256* failed_hash = nullptr)
+        : m_headers{std::move(headers)}, m_params{&params}, m_failed_hash{failed_hash} {}
+
+    bool operator()();
+
+    void swap(CPoWCheck& check) noexcept
+    {
+        std::swap(m_headers, check.m_headers);
+        std::swap(m_params, check.m_params);
+        std::swap(m_failed_hash, check.m_failed_hash);
+    }
+};
+
 #endif // BITCOIN_POW_H
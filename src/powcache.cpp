@@ -0,0 +1,121 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <powcache.h>
+
+#include <crypto/sha256.h>
+#include <cuckoocache.h>
+#include <logging.h>
+#include <pow.h>
+#include <primitives/block.h>
+#include <random.h>
+#include <uint256.h>
+#include <util/hasher.h>
+
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <utility>
+
+namespace {
+/**
+ * Cache of headers whose proof of work was verified, so that the same header
+ * arriving from several peers, in a compact block after its headers message,
+ * or read back from disk, is only hashed once.
+ */
+class CPoWCache
+{
+private:
+    //! Entries are SHA256(nonce || nonce || block hash), so peers cannot aim
+    //! their block hashes at particular buckets to evict other entries.
+    CSHA256 m_salted_hasher;
+    CuckooCache::cache<uint256, SignatureCacheHasher> m_valid;
+    std::shared_mutex m_mutex;
+    std::atomic<uint64_t> m_hits{0};
+    std::atomic<uint64_t> m_misses{0};
+
+public:
+    CPoWCache()
+    {
+        uint256 nonce = GetRandHash();
+        m_salted_hasher.Write(nonce.begin(), 32);
+        m_salted_hasher.Write(nonce.begin(), 32);
+        // Usable (if tiny) before InitPoWCache, e.g. in tools that never call it.
+        m_valid.setup(0);
+    }
+
+    uint256 ComputeEntry(const uint256& block_hash) const
+    {
+        uint256 entry;
+        CSHA256 hasher = m_salted_hasher;
+        hasher.Write(block_hash.begin(), 32).Finalize(entry.begin());
+        return entry;
+    }
+
+    bool Get(const uint256& entry)
+    {
+        bool found;
+        {
+            std::shared_lock<std::shared_mutex> lock(m_mutex);
+            found = m_valid.contains(entry, /*erase=*/false);
+        }
+        ++(found ? m_hits : m_misses);
+        return found;
+    }
+
+    void Set(const uint256& entry)
+    {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        m_valid.insert(entry);
+    }
+
+    PoWCacheStats Stats() const
+    {
+        return {m_hits.load(), m_misses.load()};
+    }
+
+    std::optional<std::pair<uint32_t, size_t>> setup_bytes(size_t n)
+    {
+        return m_valid.setup_bytes(n);
+    }
+};
+
+CPoWCache g_pow_cache;
+} // namespace
+
+bool InitPoWCache(size_t max_size_bytes)
+{
+    auto setup_results = g_pow_cache.setup_bytes(max_size_bytes);
+    if (!setup_results) return false;
+
+    const auto [num_elems, approx_size_bytes] = *setup_results;
+    LogPrintf("Using %zu MiB out of %zu MiB requested for proof-of-work cache, able to store %zu elements\n",
+              approx_size_bytes >> 20, max_size_bytes >> 20, num_elems);
+    return true;
+}
+
+bool PoWCacheContains(const uint256& block_hash)
+{
+    return g_pow_cache.Get(g_pow_cache.ComputeEntry(block_hash));
+}
+
+void PoWCacheInsert(const uint256& block_hash)
+{
+    g_pow_cache.Set(g_pow_cache.ComputeEntry(block_hash));
+}
+
+bool CheckBlockHeaderProofOfWork(const CBlockHeader& header, const Consensus::Params& params)
+{
+    const uint256 entry{g_pow_cache.ComputeEntry(header.GetHash())};
+    if (g_pow_cache.Get(entry)) return true;
+    if (!CheckProofOfWork(header.GetPoWHash(), header.nBits, params)) return false;
+    g_pow_cache.Set(entry);
+    return true;
+}
+
+PoWCacheStats GetPoWCacheStats()
+{
+    return g_pow_cache.Stats();
+}
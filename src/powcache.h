@@ -0,0 +1,48 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_POWCACHE_H
+#define BITCOIN_POWCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+
+class CBlockHeader;
+class uint256;
+
+namespace Consensus {
+struct Params;
+}
+
+// The cache holds 32-byte entries, so 4MiB is over 130000 headers.
+static constexpr size_t DEFAULT_MAX_POW_CACHE_BYTES{4 << 20};
+
+/** Number of proof-of-work checks answered from the cache and computed. */
+struct PoWCacheStats {
+    uint64_t hits{0};
+    uint64_t misses{0};
+};
+
+/**
+ * Look up whether the header with the given block hash already passed its
+ * proof-of-work check. Headers are remembered by (salted) block hash, which
+ * commits to nBits, so a hit means the memory-hard hash need not be redone.
+ */
+bool PoWCacheContains(const uint256& block_hash);
+
+/** Remember that the header with the given block hash has valid proof of work. */
+void PoWCacheInsert(const uint256& block_hash);
+
+/**
+ * Check the header's proof of work against its nBits, consulting the cache
+ * first and remembering the header if it passes.
+ */
+bool CheckBlockHeaderProofOfWork(const CBlockHeader& header, const Consensus::Params& params);
+
+PoWCacheStats GetPoWCacheStats();
+
+// To be called once in AppInitMain/BasicTestingSetup to initialize the cache.
+[[nodiscard]] bool InitPoWCache(size_t max_size_bytes);
+
+#endif // BITCOIN_POWCACHE_H
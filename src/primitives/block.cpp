@@ -40,6 +40,23 @@ uint256 CBlockHeader::GetPoWHash() const
 		return GetPoWScryptHash();
 }
 
+std::vector<uint256> GetPoWHashes(const std::vector<CBlockHeader>& headers)
+{
+    std::vector<uint256> hashes(headers.size());
+    std::vector<const char*> scrypt_in;
+    std::vector<char*> scrypt_out;
+    for (size_t i = 0; i < headers.size(); ++i) {
+        if (headers[i].nVersion & VERSIONBITS_FORK_LYRA2Z) {
+            hashes[i] = headers[i].GetPoWLyra2ZHash();
+        } else {
+            scrypt_in.push_back(BEGIN(headers[i].nVersion));
+            scrypt_out.push_back(BEGIN(hashes[i]));
+        }
+    }
+    scrypt_1024_1_1_256_multi(scrypt_in.data(), scrypt_out.data(), scrypt_in.size());
+    return hashes;
+}
+
 std::string CBlock::ToString() const
 {
     std::stringstream s;
@@ -71,6 +71,13 @@ public:
 };
 
 
+/**
+ * Compute GetPoWHash() for each of the headers. Scrypt-era headers are hashed
+ * several at a time (scrypt_1024_1_1_256_multi), so prefer this over calling
+ * GetPoWHash() in a loop when checking many headers.
+ */
+std::vector<uint256> GetPoWHashes(const std::vector<CBlockHeader>& headers);
+
 class CBlock : public CBlockHeader
 {
 public:
@@ -58,9 +58,7 @@ using kernel::CoinStatsHashType;
 
 using node::BlockManager;
 using node::NodeContext;
-using node::ReadBlockFromDisk;
 using node::SnapshotMetadata;
-using node::UndoReadFromDisk;
 
 struct CUpdatedBlock
 {
@@ -181,14 +179,14 @@ UniValue blockToJSON(BlockManager& blockman, const CBlock& block, const CBlockIn
 
         case TxVerbosity::SHOW_DETAILS:
         case TxVerbosity::SHOW_DETAILS_AND_PREVOUT:
-            CBlockUndo blockUndo;
             const bool is_not_pruned{WITH_LOCK(::cs_main, return !blockman.IsBlockPruned(blockindex))};
-            const bool have_undo{is_not_pruned && UndoReadFromDisk(blockUndo, blockindex)};
+            const std::shared_ptr<const CBlockUndo> blockUndo{is_not_pruned ? blockman.ReadBlockUndo(*blockindex) : nullptr};
+            const bool have_undo{blockUndo != nullptr};
 
             for (size_t i = 0; i < block.vtx.size(); ++i) {
                 const CTransactionRef& tx = block.vtx.at(i);
                 // coinbase transaction (i.e. i == 0) doesn't have undo data
-                const CTxUndo* txundo = (have_undo && i > 0) ? &blockUndo.vtxundo.at(i - 1) : nullptr;
+                const CTxUndo* txundo = (have_undo && i > 0) ? &blockUndo->vtxundo.at(i - 1) : nullptr;
                 UniValue objTx(UniValue::VOBJ);
                 TxToUniv(*tx, /*block_hash=*/uint256(), /*entry=*/objTx, /*include_hex=*/true, RPCSerializationFlags(), txundo, verbosity);
                 txs.push_back(objTx);
@@ -576,9 +574,8 @@ static RPCHelpMan getblockheader()
     };
 }
 
-static CBlock GetBlockChecked(BlockManager& blockman, const CBlockIndex* pblockindex)
+static std::shared_ptr<const CBlock> GetBlockChecked(BlockManager& blockman, const CBlockIndex* pblockindex)
 {
-    CBlock block;
     {
         LOCK(cs_main);
         if (blockman.IsBlockPruned(pblockindex)) {
@@ -586,7 +583,8 @@ static CBlock GetBlockChecked(BlockManager& blockman, const CBlockIndex* pblocki
         }
     }
 
-    if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus())) {
+    std::shared_ptr<const CBlock> block{blockman.ReadBlock(*pblockindex, Params().GetConsensus())};
+    if (!block) {
         // Block not found on disk. This could be because we have the block
         // header in our index but not yet have the block or did not accept the
         // block. Or if the block was pruned right after we released the lock above.
@@ -596,12 +594,10 @@ static CBlock GetBlockChecked(BlockManager& blockman, const CBlockIndex* pblocki
     return block;
 }
 
-static CBlockUndo GetUndoChecked(BlockManager& blockman, const CBlockIndex* pblockindex)
+static std::shared_ptr<const CBlockUndo> GetUndoChecked(BlockManager& blockman, const CBlockIndex* pblockindex)
 {
-    CBlockUndo blockUndo;
-
     // The Genesis block does not have undo data
-    if (pblockindex->nHeight == 0) return blockUndo;
+    if (pblockindex->nHeight == 0) return std::make_shared<const CBlockUndo>();
 
     {
         LOCK(cs_main);
@@ -610,7 +606,8 @@ static CBlockUndo GetUndoChecked(BlockManager& blockman, const CBlockIndex* pblo
         }
     }
 
-    if (!UndoReadFromDisk(blockUndo, pblockindex)) {
+    std::shared_ptr<const CBlockUndo> blockUndo{blockman.ReadBlockUndo(*pblockindex)};
+    if (!blockUndo) {
         throw JSONRPCError(RPC_MISC_ERROR, "Can't read undo data from disk");
     }
 
@@ -736,12 +733,12 @@ static RPCHelpMan getblock()
         }
     }
 
-    const CBlock block{GetBlockChecked(chainman.m_blockman, pblockindex)};
+    const std::shared_ptr<const CBlock> block{GetBlockChecked(chainman.m_blockman, pblockindex)};
 
     if (verbosity <= 0)
     {
         CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-        ssBlock << block;
+        ssBlock << *block;
         std::string strHex = HexStr(ssBlock);
         return strHex;
     }
@@ -755,7 +752,7 @@ static RPCHelpMan getblock()
         tx_verbosity = TxVerbosity::SHOW_DETAILS_AND_PREVOUT;
     }
 
-    return blockToJSON(chainman.m_blockman, block, tip, pblockindex, tx_verbosity);
+    return blockToJSON(chainman.m_blockman, *block, tip, pblockindex, tx_verbosity);
 },
     };
 }
@@ -1817,8 +1814,10 @@ static RPCHelpMan getblockstats()
         }
     }
 
-    const CBlock& block = GetBlockChecked(chainman.m_blockman, &pindex);
-    const CBlockUndo& blockUndo = GetUndoChecked(chainman.m_blockman, &pindex);
+    const std::shared_ptr<const CBlock> block_ptr{GetBlockChecked(chainman.m_blockman, &pindex)};
+    const std::shared_ptr<const CBlockUndo> block_undo_ptr{GetUndoChecked(chainman.m_blockman, &pindex)};
+    const CBlock& block = *block_ptr;
+    const CBlockUndo& blockUndo = *block_undo_ptr;
 
     const bool do_all = stats.size() == 0; // Calculate everything if nothing selected (default)
     const bool do_mediantxsize = do_all || stats.count("mediantxsize") != 0;
@@ -2273,8 +2272,10 @@ public:
 
 static bool CheckBlockFilterMatches(BlockManager& blockman, const CBlockIndex& blockindex, const GCSFilter::ElementSet& needles)
 {
-    const CBlock block{GetBlockChecked(blockman, &blockindex)};
-    const CBlockUndo block_undo{GetUndoChecked(blockman, &blockindex)};
+    const std::shared_ptr<const CBlock> block_ptr{GetBlockChecked(blockman, &blockindex)};
+    const std::shared_ptr<const CBlockUndo> block_undo_ptr{GetUndoChecked(blockman, &blockindex)};
+    const CBlock& block{*block_ptr};
+    const CBlockUndo& block_undo{*block_undo_ptr};
 
     // Check if any of the outputs match the scriptPubKey
     for (const auto& tx : block.vtx) {
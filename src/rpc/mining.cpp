@@ -38,12 +38,19 @@
 #include <validationinterface.h>
 #include <warnings.h>
 
+#include <algorithm>
+#include <deque>
+#include <map>
 #include <memory>
+#include <set>
 #include <stdint.h>
 
 using node::BlockAssembler;
 using node::CBlockTemplate;
+using node::GetMinerThreads;
+using node::LiveBlockTemplate;
 using node::NodeContext;
+using node::NonceSearcher;
 using node::RegenerateCommitments;
 using node::UpdateTime;
 
@@ -115,19 +122,17 @@ static RPCHelpMan getnetworkhashps()
     };
 }
 
-static bool GenerateBlock(ChainstateManager& chainman, CBlock& block, uint64_t& max_tries, uint256& block_hash)
+static bool GenerateBlock(ChainstateManager& chainman, CBlock& block, uint64_t& max_tries, NonceSearcher& searcher, uint256& block_hash)
 {
     block_hash.SetNull();
     block.hashMerkleRoot = BlockMerkleRoot(block);
 
-    while (max_tries > 0 && block.nNonce < std::numeric_limits<uint32_t>::max() && !CheckProofOfWork(block.GetPoWHash(), block.nBits, chainman.GetConsensus()) && !ShutdownRequested()) {
-        ++block.nNonce;
-        --max_tries;
-    }
+    const bool found{searcher.Search(block, chainman.GetConsensus(), max_tries, ShutdownRequested)};
     if (max_tries == 0 || ShutdownRequested()) {
         return false;
     }
-    if (block.nNonce == std::numeric_limits<uint32_t>::max()) {
+    if (!found) {
+        // Out of nonces, the caller retries with a new block.
         return true;
     }
 
@@ -140,9 +145,10 @@ static bool GenerateBlock(ChainstateManager& chainman, CBlock& block, uint64_t&
     return true;
 }
 
-static UniValue generateBlocks(ChainstateManager& chainman, const CTxMemPool& mempool, const CScript& coinbase_script, int nGenerate, uint64_t nMaxTries)
+static UniValue generateBlocks(ChainstateManager& chainman, const CTxMemPool& mempool, const CScript& coinbase_script, int nGenerate, uint64_t nMaxTries, int threads)
 {
     UniValue blockHashes(UniValue::VARR);
+    NonceSearcher searcher{threads};
     while (nGenerate > 0 && !ShutdownRequested()) {
         std::unique_ptr<CBlockTemplate> pblocktemplate(BlockAssembler{chainman.ActiveChainstate(), &mempool}.CreateNewBlock(coinbase_script));
         if (!pblocktemplate.get())
@@ -150,7 +156,7 @@ static UniValue generateBlocks(ChainstateManager& chainman, const CTxMemPool& me
         CBlock *pblock = &pblocktemplate->block;
 
         uint256 block_hash;
-        if (!GenerateBlock(chainman, *pblock, nMaxTries, block_hash)) {
+        if (!GenerateBlock(chainman, *pblock, nMaxTries, searcher, block_hash)) {
             break;
         }
 
@@ -229,7 +235,7 @@ static RPCHelpMan generatetodescriptor()
     const CTxMemPool& mempool = EnsureMemPool(node);
     ChainstateManager& chainman = EnsureChainman(node);
 
-    return generateBlocks(chainman, mempool, coinbase_script, num_blocks, max_tries);
+    return generateBlocks(chainman, mempool, coinbase_script, num_blocks, max_tries, GetMinerThreads(EnsureArgsman(node)));
 },
     };
 }
@@ -277,7 +283,7 @@ static RPCHelpMan generatetoaddress()
 
     CScript coinbase_script = GetScriptForDestination(destination);
 
-    return generateBlocks(chainman, mempool, coinbase_script, num_blocks, max_tries);
+    return generateBlocks(chainman, mempool, coinbase_script, num_blocks, max_tries, GetMinerThreads(EnsureArgsman(node)));
 },
     };
 }
@@ -378,8 +384,9 @@ static RPCHelpMan generateblock()
 
     uint256 block_hash;
     uint64_t max_tries{DEFAULT_MAX_TRIES};
+    NonceSearcher searcher{GetMinerThreads(EnsureArgsman(node))};
 
-    if (!GenerateBlock(chainman, block, max_tries, block_hash) || block_hash.IsNull()) {
+    if (!GenerateBlock(chainman, block, max_tries, searcher, block_hash) || block_hash.IsNull()) {
         throw JSONRPCError(RPC_MISC_ERROR, "Failed to make block.");
     }
 
@@ -500,6 +507,16 @@ static std::string gbt_vb_name(const Consensus::DeploymentPos pos) {
     return s;
 }
 
+/** Client rule sets whose getblocktemplate results are kept at most. */
+static constexpr size_t MAX_CACHED_TEMPLATE_RESULTS{8};
+
+/** getblocktemplate results for one revision of the live template, by client rules, oldest first. */
+struct BlockTemplateResults {
+    uint64_t revision{0};
+    std::deque<std::pair<std::set<std::string>, UniValue>> by_rules;
+};
+static BlockTemplateResults g_template_results GUARDED_BY(cs_main);
+
 static RPCHelpMan getblocktemplate()
 {
     return RPCHelpMan{"getblocktemplate",
@@ -728,31 +745,29 @@ static RPCHelpMan getblocktemplate()
         throw JSONRPCError(RPC_INVALID_PARAMETER, "getblocktemplate must be called with the segwit rule set (call with {\"rules\": [\"segwit\"]})");
     }
 
-    // Update block
-    static CBlockIndex* pindexPrev;
-    static int64_t time_start;
-    static std::unique_ptr<CBlockTemplate> pblocktemplate;
-    if (pindexPrev != active_chain.Tip() ||
-        (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - time_start > 5))
-    {
-        // Clear pindexPrev so future calls make a new block, despite any failures from here on
-        pindexPrev = nullptr;
-
-        // Store the pindexBest used before CreateNewBlock, to avoid races
-        nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
-        CBlockIndex* pindexPrevNew = active_chain.Tip();
-        time_start = GetTime();
-
-        // Create new block
+    // Update block. The template follows the mempool from one call to the
+    // next, and is only assembled from scratch for a new tip.
+    if (!node.block_template) {
         CScript scriptDummy = CScript() << OP_TRUE;
-        pblocktemplate = BlockAssembler{active_chainstate, &mempool}.CreateNewBlock(scriptDummy);
-        if (!pblocktemplate)
-            throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
-
-        // Need to update only after we know CreateNewBlock succeeded
-        pindexPrev = pindexPrevNew;
+        node.block_template = std::make_shared<LiveBlockTemplate>(active_chainstate, mempool, scriptDummy);
+        RegisterSharedValidationInterface(node.block_template);
+    }
+    // The template learns of new transactions from the validation interface
+    // queue. When it is due an update, wait for the queue to deliver those the
+    // mempool has counted so far. The tip may move meanwhile, so it is only
+    // read below, once cs_main is held again.
+    const unsigned int transactions_updated{mempool.GetTransactionsUpdated()};
+    if (node.block_template->NeedsUpdate(transactions_updated)) {
+        LEAVE_CRITICAL_SECTION(cs_main);
+        SyncWithValidationInterfaceQueue();
+        ENTER_CRITICAL_SECTION(cs_main);
     }
-    CHECK_NONFATAL(pindexPrev);
+    CBlockTemplate* const pblocktemplate = &node.block_template->Get(transactions_updated);
+    // Store the mempool state the template follows, so that a longpoll
+    // returns as soon as there is anything the template does not have yet
+    nTransactionsUpdatedLast = node.block_template->GetTransactionsUpdated();
+    const CBlockIndex* const pindexPrev = active_chain.Tip();
+    CHECK_NONFATAL(pblocktemplate->block.hashPrevBlock == pindexPrev->GetBlockHash());
     CBlock* pblock = &pblocktemplate->block; // pointer for convenience
 
     // Update nTime
@@ -762,6 +777,25 @@ static RPCHelpMan getblocktemplate()
     // NOTE: If at some point we support pre-segwit miners post-segwit-activation, this needs to take segwit support into consideration
     const bool fPreSegWit = !DeploymentActiveAfter(pindexPrev, chainman, Consensus::DEPLOYMENT_SEGWIT);
 
+    // Apart from the time and the longpoll id, the result only depends on the
+    // template and the client's rules. Serve it from the last call's if they
+    // are the same, rather than encoding every transaction again.
+    const std::string longpollid{active_chain.Tip()->GetBlockHash().GetHex() + ToString(nTransactionsUpdatedLast)};
+    if (g_template_results.revision != node.block_template->GetRevision()) {
+        g_template_results.revision = node.block_template->GetRevision();
+        g_template_results.by_rules.clear();
+    }
+    const auto cached{std::find_if(g_template_results.by_rules.begin(), g_template_results.by_rules.end(),
+                                   [&](const auto& entry) { return entry.first == setClientRules; })};
+    if (cached != g_template_results.by_rules.end()) {
+        UniValue result{cached->second};
+        result.pushKV("longpollid", longpollid);
+        result.pushKV("target", arith_uint256().SetCompact(pblock->nBits).GetHex());
+        result.pushKV("curtime", pblock->GetBlockTime());
+        result.pushKV("bits", strprintf("%08x", pblock->nBits));
+        return result;
+    }
+
     UniValue aCaps(UniValue::VARR); aCaps.push_back("proposal");
 
     UniValue transactions(UniValue::VARR);
@@ -823,6 +857,9 @@ static RPCHelpMan getblocktemplate()
         aRules.push_back("!signet");
     }
 
+    // The live template outlasts this call, so adjust the version for the
+    // client's rules on a copy.
+    int32_t block_version{pblock->nVersion};
     UniValue vbavailable(UniValue::VOBJ);
     for (int j = 0; j < (int)Consensus::MAX_VERSION_BITS_DEPLOYMENTS; ++j) {
         Consensus::DeploymentPos pos = Consensus::DeploymentPos(j);
@@ -834,7 +871,7 @@ static RPCHelpMan getblocktemplate()
                 break;
             case ThresholdState::LOCKED_IN:
                 // Ensure bit is set in block version
-                pblock->nVersion |= chainman.m_versionbitscache.Mask(consensusParams, pos);
+                block_version |= chainman.m_versionbitscache.Mask(consensusParams, pos);
                 [[fallthrough]];
             case ThresholdState::STARTED:
             {
@@ -843,7 +880,7 @@ static RPCHelpMan getblocktemplate()
                 if (setClientRules.find(vbinfo.name) == setClientRules.end()) {
                     if (!vbinfo.gbt_force) {
                         // If the client doesn't support this, don't indicate it in the [default] version
-                        pblock->nVersion &= ~chainman.m_versionbitscache.Mask(consensusParams, pos);
+                        block_version &= ~chainman.m_versionbitscache.Mask(consensusParams, pos);
                     }
                 }
                 break;
@@ -863,7 +900,7 @@ static RPCHelpMan getblocktemplate()
             }
         }
     }
-    result.pushKV("version", pblock->nVersion);
+    result.pushKV("version", block_version);
     result.pushKV("rules", aRules);
     result.pushKV("vbavailable", vbavailable);
     result.pushKV("vbrequired", int(0));
@@ -872,7 +909,7 @@ static RPCHelpMan getblocktemplate()
     result.pushKV("transactions", transactions);
     result.pushKV("coinbaseaux", aux);
     result.pushKV("coinbasevalue", (int64_t)pblock->vtx[0]->vout[0].nValue);
-    result.pushKV("longpollid", active_chain.Tip()->GetBlockHash().GetHex() + ToString(nTransactionsUpdatedLast));
+    result.pushKV("longpollid", longpollid);
     result.pushKV("target", hashTarget.GetHex());
     result.pushKV("mintime", (int64_t)pindexPrev->GetMedianTimePast()+1);
     result.pushKV("mutable", aMutable);
@@ -902,6 +939,8 @@ static RPCHelpMan getblocktemplate()
         result.pushKV("default_witness_commitment", HexStr(pblocktemplate->vchCoinbaseCommitment));
     }
 
+    if (g_template_results.by_rules.size() >= MAX_CACHED_TEMPLATE_RESULTS) g_template_results.by_rules.pop_front();
+    g_template_results.by_rules.emplace_back(setClientRules, result);
     return result;
 },
     };
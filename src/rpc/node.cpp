@@ -4,6 +4,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <chainparams.h>
+#include <flatfile.h>
 #include <httpserver.h>
 #include <index/blockfilterindex.h>
 #include <index/coinstatsindex.h>
@@ -13,7 +14,9 @@
 #include <interfaces/init.h>
 #include <interfaces/ipc.h>
 #include <kernel/cs_main.h>
+#include <node/blockcache.h>
 #include <node/context.h>
+#include <powcache.h>
 #include <rpc/server.h>
 #include <rpc/server_util.h>
 #include <rpc/util.h>
@@ -23,6 +26,8 @@
 #include <util/check.h>
 #include <util/syscall_sandbox.h>
 #include <util/system.h>
+#include <util/time.h>
+#include <validation.h>
 #ifdef HAVE_MALLOC_INFO
 #include <malloc.h>
 #endif
@@ -140,6 +145,32 @@ static UniValue RPCLockedMemoryInfo() {
   return obj;
 }
 
+static UniValue RPCBlockCacheInfo(const node::BlockCacheStats& stats) {
+  UniValue obj(UniValue::VOBJ);
+  obj.pushKV("hits", stats.hits);
+  obj.pushKV("misses", stats.misses);
+  obj.pushKV("entries", (uint64_t)stats.entries);
+  obj.pushKV("usage", (uint64_t)stats.usage);
+  return obj;
+}
+
+static UniValue RPCBlockFlushInfo(const FlatFileFlushStats& stats) {
+  UniValue obj(UniValue::VOBJ);
+  obj.pushKV("flushes", stats.flushes);
+  obj.pushKV("pending", (uint64_t)stats.pending);
+  obj.pushKV("total_time_ms", Ticks<std::chrono::milliseconds>(stats.total_time));
+  obj.pushKV("max_time_ms", Ticks<std::chrono::milliseconds>(stats.max_time));
+  return obj;
+}
+
+static UniValue RPCPoWCacheInfo() {
+  const PoWCacheStats stats{GetPoWCacheStats()};
+  UniValue obj(UniValue::VOBJ);
+  obj.pushKV("hits", stats.hits);
+  obj.pushKV("misses", stats.misses);
+  return obj;
+}
+
 #ifdef HAVE_MALLOC_INFO
 static std::string RPCMallocInfo() {
   char* ptr = nullptr;
@@ -198,6 +229,50 @@ static RPCHelpMan getmemoryinfo() {
                        {RPCResult::Type::NUM, "chunks_free",
                         "Number unused chunks"},
                    }},
+                  {RPCResult::Type::OBJ,
+                   "powcache",
+                   "Information about the proof-of-work cache",
+                   {
+                       {RPCResult::Type::NUM, "hits",
+                        "Number of proof-of-work checks answered from the cache"},
+                       {RPCResult::Type::NUM, "misses",
+                        "Number of proof-of-work checks that had to hash the header"},
+                   }},
+                  {RPCResult::Type::OBJ,
+                   "blockcache",
+                   "Information about the caches of recently read blocks and undo data",
+                   {
+                       {RPCResult::Type::OBJ, "blocks", "The block cache",
+                        {
+                            {RPCResult::Type::NUM, "hits", "Number of blocks read from the cache"},
+                            {RPCResult::Type::NUM, "misses", "Number of blocks read from disk"},
+                            {RPCResult::Type::NUM, "entries", "Number of blocks in the cache"},
+                            {RPCResult::Type::NUM, "usage", "Estimated memory usage of the cached blocks in bytes"},
+                        }},
+                       {RPCResult::Type::OBJ, "undo", "The undo data cache",
+                        {
+                            {RPCResult::Type::NUM, "hits", "Number of undo data reads from the cache"},
+                            {RPCResult::Type::NUM, "misses", "Number of undo data reads from disk"},
+                            {RPCResult::Type::NUM, "entries", "Number of blocks' undo data in the cache"},
+                            {RPCResult::Type::NUM, "usage", "Estimated memory usage of the cached undo data in bytes"},
+                        }},
+                   }},
+                  {RPCResult::Type::OBJ,
+                   "blockindex",
+                   "Information about the in-memory block index",
+                   {
+                       {RPCResult::Type::NUM, "entries", "Number of block index entries"},
+                       {RPCResult::Type::NUM, "usage", "Estimated memory usage of the block index in bytes"},
+                   }},
+                  {RPCResult::Type::OBJ,
+                   "blockflush",
+                   "Information about flushing block and undo files to disk",
+                   {
+                       {RPCResult::Type::NUM, "flushes", "Number of files flushed"},
+                       {RPCResult::Type::NUM, "pending", "Number of finished files waiting to be flushed in the background"},
+                       {RPCResult::Type::NUM, "total_time_ms", "Total time spent flushing, in milliseconds"},
+                       {RPCResult::Type::NUM, "max_time_ms", "Longest time a single flush took, in milliseconds"},
+                   }},
               }},
           RPCResult{"mode \"mallocinfo\"", RPCResult::Type::STR, "",
                     "\"<malloc version=\"1\">...\""},
@@ -210,6 +285,20 @@ static RPCHelpMan getmemoryinfo() {
         if (mode == "stats") {
           UniValue obj(UniValue::VOBJ);
           obj.pushKV("locked", RPCLockedMemoryInfo());
+          obj.pushKV("powcache", RPCPoWCacheInfo());
+          const ChainstateManager& chainman{EnsureAnyChainman(request.context)};
+          UniValue blockcache(UniValue::VOBJ);
+          blockcache.pushKV("blocks", RPCBlockCacheInfo(chainman.m_blockman.m_block_cache.GetStats()));
+          blockcache.pushKV("undo", RPCBlockCacheInfo(chainman.m_blockman.m_undo_cache.GetStats()));
+          obj.pushKV("blockcache", blockcache);
+          UniValue blockindex(UniValue::VOBJ);
+          {
+              LOCK(cs_main);
+              blockindex.pushKV("entries", (uint64_t)chainman.m_blockman.m_block_index.size());
+              blockindex.pushKV("usage", (uint64_t)chainman.m_blockman.BlockIndexMemoryUsage());
+          }
+          obj.pushKV("blockindex", blockindex);
+          obj.pushKV("blockflush", RPCBlockFlushInfo(chainman.m_blockman.m_flusher.GetStats()));
           return obj;
         } else if (mode == "mallocinfo") {
 #ifdef HAVE_MALLOC_INFO
@@ -3,14 +3,23 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <chainparams.h>
+#include <checkqueue.h>
+#include <fs.h>
 #include <node/blockstorage.h>
+#include <pow.h>
 #include <node/context.h>
+#include <txdb.h>
+#include <undo.h>
+#include <util/system.h>
 #include <validation.h>
 
 #include <boost/test/unit_test.hpp>
+#include <test/util/logging.h>
 #include <test/util/setup_common.h>
 
+using node::BlockCache;
 using node::BlockManager;
+using node::BlockMap;
 using node::BLOCK_SERIALIZATION_HEADER_SIZE;
 
 // use BasicTestingSetup here for the data directory configuration, setup, and cleanup
@@ -39,4 +48,258 @@ BOOST_AUTO_TEST_CASE(blockmanager_find_block_pos)
     BOOST_CHECK_EQUAL(actual.nPos, BLOCK_SERIALIZATION_HEADER_SIZE + ::GetSerializeSize(params->GenesisBlock(), CLIENT_VERSION) + BLOCK_SERIALIZATION_HEADER_SIZE);
 }
 
+/** A block index entry as written by a client with a higher CLIENT_VERSION. */
+struct VersionedDiskBlockIndex {
+    const CBlockIndex* index;
+    int version;
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        OverrideStream<Stream> os{&s, s.GetType(), version};
+        os << CDiskBlockIndex{index};
+    }
+};
+
+BOOST_AUTO_TEST_CASE(blockmanager_pow_checksum)
+{
+    const auto params {CreateChainParams(ArgsManager{}, CBaseChainParams::MAIN)};
+    const CBlock& genesis{params->GenesisBlock()};
+    const uint256 hash{genesis.GetHash()};
+    CBlockIndex index{genesis};
+    index.phashBlock = &hash;
+
+    LOCK(cs_main);
+    CBlockTreeDB db{1 << 20, /*fMemory=*/true};
+    CCheckQueue<CPoWCheck> pow_queue{8};
+    pow_queue.StartWorkerThreads(2);
+    auto try_load = [&](BlockIndexPoWCheck pow_check, bool parallel, size_t& missing) {
+        BlockMap::allocator_type::ResourceType resource;
+        BlockMap loaded{0, BlockHasher{}, BlockMap::key_equal{}, &resource};
+        std::vector<CBlockIndex*> missing_checksum;
+        bool ret{db.LoadBlockIndexGuts(params->GetConsensus(), [&](const uint256& h) -> CBlockIndex* {
+            if (h.IsNull()) return nullptr;
+            auto [it, inserted]{loaded.try_emplace(h)};
+            it->second.phashBlock = &it->first;
+            return &it->second;
+        }, pow_check, missing_checksum, parallel ? &pow_queue : nullptr)};
+        missing = missing_checksum.size();
+        return ret;
+    };
+    auto load = [&](BlockIndexPoWCheck pow_check, bool parallel = false) {
+        size_t missing{0};
+        BOOST_CHECK(try_load(pow_check, parallel, missing));
+        return missing;
+    };
+
+    // An entry without a checksum has its PoW checked and is reported for rewriting
+    BOOST_CHECK(db.Write(std::make_pair(uint8_t{'b'}, hash), CDiskBlockIndex{&index}));
+    BOOST_CHECK_EQUAL(load(BlockIndexPoWCheck::NONE), 1U);
+
+    // The record version does not matter: old clients wrote higher ones
+    BOOST_CHECK(db.Write(std::make_pair(uint8_t{'b'}, hash), VersionedDiskBlockIndex{&index, 259900}));
+    BOOST_CHECK_EQUAL(load(BlockIndexPoWCheck::NONE), 1U);
+
+    // Entries written through WriteBatchSync carry a valid checksum
+    BOOST_CHECK(db.WriteBatchSync({}, 0, {&index}));
+    BOOST_CHECK_EQUAL(load(BlockIndexPoWCheck::NONE), 0U);
+    BOOST_CHECK_EQUAL(load(BlockIndexPoWCheck::FULL), 0U);
+    BOOST_CHECK_EQUAL(load(BlockIndexPoWCheck::FULL, /*parallel=*/true), 0U);
+
+    // The checksum outlives rewrites of the entry by versions that do not know it
+    BOOST_CHECK(db.Write(std::make_pair(uint8_t{'b'}, hash), CDiskBlockIndex{&index}));
+    BOOST_CHECK_EQUAL(load(BlockIndexPoWCheck::NONE), 0U);
+
+    // An entry without a checksum whose PoW does not meet its target fails the
+    // load, whether it is checked inline or on the check queue, and is named
+    CBlockIndex bad_index{genesis};
+    bad_index.nBits = 0x1b0404cb;
+    bad_index.nHeight = 7;
+    const uint256 bad_hash{bad_index.GetBlockHeader().GetHash()};
+    bad_index.phashBlock = &bad_hash;
+    BOOST_CHECK(db.Write(std::make_pair(uint8_t{'b'}, bad_hash), CDiskBlockIndex{&bad_index}));
+    size_t missing{0};
+    {
+        ASSERT_DEBUG_LOG(strprintf("nHeight=7, merkle=%s, hashBlock=%s", genesis.hashMerkleRoot.ToString(), bad_hash.ToString()));
+        BOOST_CHECK(!try_load(BlockIndexPoWCheck::NONE, /*parallel=*/false, missing));
+    }
+    {
+        ASSERT_DEBUG_LOG(strprintf("nHeight=7, merkle=%s, hashBlock=%s", genesis.hashMerkleRoot.ToString(), bad_hash.ToString()));
+        BOOST_CHECK(!try_load(BlockIndexPoWCheck::NONE, /*parallel=*/true, missing));
+    }
+
+    pow_queue.StopWorkerThreads();
+}
+
+BOOST_AUTO_TEST_CASE(blockmanager_block_cache)
+{
+    // Least recently used entries are dropped once over the limit
+    BlockCache<int> cache{10};
+    for (int i = 0; i < 3; ++i) {
+        cache.Insert(uint256{uint8_t(i)}, std::make_shared<const int>(i), 4);
+    }
+    BOOST_CHECK(!cache.Get(uint256{0}));
+    BOOST_CHECK_EQUAL(*cache.Get(uint256{1}), 1);
+    cache.Insert(uint256{3}, std::make_shared<const int>(3), 4);
+    BOOST_CHECK(cache.Get(uint256{1}));
+    BOOST_CHECK(!cache.Get(uint256{2}));
+    // Entries larger than the whole cache are not kept
+    cache.Insert(uint256{4}, std::make_shared<const int>(4), 11);
+    BOOST_CHECK(!cache.Get(uint256{4}));
+    BOOST_CHECK_EQUAL(cache.GetStats().hits, 2U);
+    BOOST_CHECK_EQUAL(cache.GetStats().misses, 3U);
+    BOOST_CHECK_EQUAL(cache.GetStats().entries, 2U);
+    BOOST_CHECK_EQUAL(cache.GetStats().usage, 8U);
+
+    // BlockManager reads blocks through its cache
+    const auto params {CreateChainParams(ArgsManager{}, CBaseChainParams::MAIN)};
+    const CBlock& genesis{params->GenesisBlock()};
+    BlockManager blockman {};
+    CChain chain {};
+    const FlatFilePos pos{blockman.SaveBlockToDisk(genesis, 0, chain, *params, nullptr)};
+    const uint256 hash{genesis.GetHash()};
+    CBlockIndex index{genesis};
+    index.phashBlock = &hash;
+    {
+        LOCK(cs_main);
+        index.nFile = pos.nFile;
+        index.nDataPos = pos.nPos;
+        index.nStatus = BLOCK_VALID_TRANSACTIONS | BLOCK_HAVE_DATA;
+    }
+
+    // Unless asked not to
+    const auto uncached{blockman.ReadBlock(index, params->GetConsensus(), /*fill_cache=*/false)};
+    BOOST_REQUIRE(uncached);
+    BOOST_CHECK_EQUAL(uncached->GetHash(), hash);
+    BOOST_CHECK_EQUAL(blockman.m_block_cache.GetStats().entries, 0U);
+
+    const auto block{blockman.ReadBlock(index, params->GetConsensus())};
+    BOOST_REQUIRE(block);
+    BOOST_CHECK_EQUAL(block->GetHash(), hash);
+    BOOST_CHECK(blockman.ReadBlock(index, params->GetConsensus()) == block);
+    // A block in the cache is returned from there either way
+    BOOST_CHECK(blockman.ReadBlock(index, params->GetConsensus(), /*fill_cache=*/false) == block);
+    BOOST_CHECK_EQUAL(blockman.m_block_cache.GetStats().hits, 2U);
+    BOOST_CHECK_EQUAL(blockman.m_block_cache.GetStats().misses, 2U);
+
+    blockman.ResizeBlockCache(0);
+    BOOST_CHECK_EQUAL(blockman.m_block_cache.GetStats().entries, 0U);
+    const auto reread{blockman.ReadBlock(index, params->GetConsensus())};
+    BOOST_REQUIRE(reread);
+    BOOST_CHECK(reread != block);
+    BOOST_CHECK_EQUAL(blockman.m_block_cache.GetStats().misses, 3U);
+
+    // The genesis block has empty undo data
+    const auto undo{blockman.ReadBlockUndo(index)};
+    BOOST_REQUIRE(undo);
+    BOOST_CHECK(undo->vtxundo.empty());
+}
+
+BOOST_AUTO_TEST_CASE(blockmanager_index_snapshot)
+{
+    const auto params {CreateChainParams(ArgsManager{}, CBaseChainParams::MAIN)};
+    LOCK(cs_main);
+    BlockManager blockman {};
+    blockman.m_block_tree_db = std::make_unique<CBlockTreeDB>(1 << 20, /*fMemory=*/true);
+    blockman.m_use_index_snapshot = true;
+    // Start up on the empty database, which sets up the block file info
+    BOOST_CHECK(blockman.LoadBlockIndexDB(params->GetConsensus()));
+
+    // A chain of headers with a fork, transactions for the first few blocks
+    // and for one further on that is not linked to them
+    CBlockIndex* best_header{nullptr};
+    CBlockHeader header{params->GenesisBlock()};
+    std::vector<CBlockIndex*> chain{blockman.AddToBlockIndex(header, best_header)};
+    for (uint32_t i = 1; i < 20; ++i) {
+        header.hashPrevBlock = chain.back()->GetBlockHash();
+        header.nTime += 60;
+        header.nNonce = i;
+        chain.push_back(blockman.AddToBlockIndex(header, best_header));
+    }
+    header.hashPrevBlock = chain[10]->GetBlockHash();
+    header.nNonce = 100;
+    blockman.AddToBlockIndex(header, best_header);
+    for (unsigned int i = 0; i < 5; ++i) {
+        chain[i]->nTx = 1;
+        chain[i]->nChainTx = i + 1;
+    }
+    chain[7]->nTx = 1;
+
+    // Nothing is saved before the index is in the database
+    BOOST_CHECK(!blockman.WriteBlockIndexSnapshot());
+    BOOST_CHECK(blockman.WriteBlockIndexDB());
+
+    // Load into a new BlockManager on the same database, which has to end up
+    // with the same index whether or not it uses the snapshot
+    const auto check_load{[&]() EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+        BlockManager loaded {};
+        loaded.m_use_index_snapshot = true;
+        loaded.m_block_tree_db = std::move(blockman.m_block_tree_db);
+        BOOST_CHECK(loaded.LoadBlockIndexDB(params->GetConsensus()));
+        blockman.m_block_tree_db = std::move(loaded.m_block_tree_db);
+        BOOST_CHECK_EQUAL(loaded.m_block_index.size(), blockman.m_block_index.size());
+        for (const auto& [hash, index] : blockman.m_block_index) {
+            const CBlockIndex* other{loaded.LookupBlockIndex(hash)};
+            BOOST_REQUIRE(other);
+            // Covers the header fields and pprev
+            BOOST_CHECK_EQUAL(other->GetBlockHeader().GetHash(), hash);
+            BOOST_CHECK_EQUAL(other->nHeight, index.nHeight);
+            BOOST_CHECK_EQUAL(other->pskip ? other->pskip->GetBlockHash() : uint256{}, index.pskip ? index.pskip->GetBlockHash() : uint256{});
+            BOOST_CHECK(other->nChainWork == index.nChainWork);
+            BOOST_CHECK_EQUAL(other->nStatus, index.nStatus);
+            BOOST_CHECK_EQUAL(other->nTx, index.nTx);
+            BOOST_CHECK_EQUAL(other->nChainTx, index.nChainTx);
+            BOOST_CHECK_EQUAL(other->nTimeMax, index.nTimeMax);
+        }
+        BOOST_CHECK_EQUAL(loaded.m_blocks_unlinked.size(), 1U);
+    }};
+
+    {
+        ASSERT_DEBUG_LOG("Loaded 21 block index entries from the snapshot");
+        BOOST_CHECK(blockman.WriteBlockIndexSnapshot());
+        check_load();
+    }
+    // The snapshot is only used once; then the database is read again
+    check_load();
+
+    // A corrupted snapshot is not used
+    {
+        ASSERT_DEBUG_LOG("Checksum mismatch");
+        BOOST_CHECK(blockman.WriteBlockIndexSnapshot());
+        FILE* file{fsbridge::fopen(gArgs.GetDataDirNet() / "blockindex.dat", "r+b")};
+        BOOST_REQUIRE(file);
+        BOOST_REQUIRE_EQUAL(fseek(file, -64, SEEK_END), 0);
+        const int byte{fgetc(file)};
+        BOOST_REQUIRE_EQUAL(fseek(file, -64, SEEK_END), 0);
+        fputc(byte ^ 1, file);
+        fclose(file);
+        check_load();
+    }
+
+    // Nor one followed by a block index write, as done by versions that do not
+    // know about the snapshot when pruning, accepting headers or invalidating
+    // a block
+    {
+        BOOST_CHECK(blockman.WriteBlockIndexSnapshot());
+        chain[19]->nStatus |= BLOCK_FAILED_VALID;
+        BOOST_CHECK(blockman.m_block_tree_db->WriteBatchSync({}, 0, {chain[19]}));
+        uint256 id;
+        BOOST_CHECK(!blockman.m_block_tree_db->ReadIndexSnapshotId(id));
+        check_load();
+    }
+
+    // Nor one whose id survived a change to the block files
+    {
+        ASSERT_DEBUG_LOG("Block files changed since it was written");
+        BOOST_CHECK(blockman.WriteBlockIndexSnapshot());
+        uint256 id;
+        BOOST_CHECK(blockman.m_block_tree_db->ReadIndexSnapshotId(id));
+        CBlockFileInfo info;
+        info.AddBlock(/*nHeightIn=*/0, /*nTimeIn=*/header.nTime);
+        BOOST_CHECK(blockman.m_block_tree_db->WriteBatchSync({{0, &info}}, 0, {}));
+        BOOST_CHECK(blockman.m_block_tree_db->WriteIndexSnapshotId(0, id));
+        check_load();
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
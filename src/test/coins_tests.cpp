@@ -12,7 +12,9 @@
 #include <undo.h>
 #include <util/strencodings.h>
 
+#include <iterator>
 #include <map>
+#include <unordered_map>
 #include <vector>
 
 #include <boost/test/unit_test.hpp>
@@ -53,9 +55,9 @@ public:
 
     uint256 GetBestBlock() const override { return hashBestBlock_; }
 
-    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock) override
+    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock, bool erase = true) override
     {
-        for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end(); ) {
+        for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end(); it = erase ? mapCoins.erase(it) : std::next(it)) {
             if (it->second.flags & CCoinsCacheEntry::DIRTY) {
                 // Same optimization used in CCoinsViewDB is to only write dirty entries.
                 map_[it->first] = it->second.coin;
@@ -64,7 +66,6 @@ public:
                     map_.erase(it->first);
                 }
             }
-            mapCoins.erase(it++);
         }
         if (!hashBlock.IsNull())
             hashBestBlock_ = hashBlock;
@@ -212,11 +213,12 @@ void SimulationTest(CCoinsView* base, bool fake_best_block)
         }
 
         if (InsecureRandRange(100) == 0) {
-            // Every 100 iterations, flush an intermediate cache
+            // Every 100 iterations, flush or sync an intermediate cache
             if (stack.size() > 1 && InsecureRandBool() == 0) {
                 unsigned int flushIndex = InsecureRandRange(stack.size() - 1);
                 if (fake_best_block) stack[flushIndex]->SetBestBlock(InsecureRand256());
-                BOOST_CHECK(stack[flushIndex]->Flush());
+                bool should_erase = InsecureRandRange(4) < 3;
+                BOOST_CHECK(should_erase ? stack[flushIndex]->Flush() : stack[flushIndex]->Sync());
             }
         }
         if (InsecureRandRange(100) == 0) {
@@ -270,6 +272,9 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
 
     CCoinsViewDB db_base{"test", /*nCacheSize=*/1 << 23, /*fMemory=*/true, /*fWipe=*/false};
     SimulationTest(&db_base, true);
+
+    CCoinsViewDB write_behind_base{"test", /*nCacheSize=*/1 << 23, /*fMemory=*/true, /*fWipe=*/false, /*write_behind=*/true};
+    SimulationTest(&write_behind_base, true);
 }
 
 // Store of all necessary tx and undo data for next test
@@ -460,10 +465,11 @@ BOOST_AUTO_TEST_CASE(updatecoins_simulation_test)
         }
 
         if (InsecureRandRange(100) == 0) {
-            // Every 100 iterations, flush an intermediate cache
+            // Every 100 iterations, flush or sync an intermediate cache
             if (stack.size() > 1 && InsecureRandBool() == 0) {
                 unsigned int flushIndex = InsecureRandRange(stack.size() - 1);
-                BOOST_CHECK(stack[flushIndex]->Flush());
+                bool should_erase = InsecureRandRange(4) < 3;
+                BOOST_CHECK(should_erase ? stack[flushIndex]->Flush() : stack[flushIndex]->Sync());
             }
         }
         if (InsecureRandRange(100) == 0) {
@@ -608,7 +614,8 @@ void GetCoinsMapEntry(const CCoinsMap& map, CAmount& value, char& flags)
 
 void WriteCoinsViewEntry(CCoinsView& view, CAmount value, char flags)
 {
-    CCoinsMap map;
+    CCoinsMapMemoryResource resource;
+    CCoinsMap map{0, SaltedOutpointHasher{}, CCoinsMap::key_equal{}, &resource};
     InsertCoinsMapEntry(map, value, flags);
     BOOST_CHECK(view.BatchWrite(map, {}));
 }
@@ -877,4 +884,118 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+BOOST_AUTO_TEST_CASE(ccoins_pool_usage)
+{
+    CCoinsView root;
+    CCoinsViewCacheTest base{&root};
+    CCoinsViewCacheTest cache{&base};
+    const size_t empty_usage{cache.DynamicMemoryUsage()};
+
+    std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> std_map;
+    for (uint32_t i = 0; i < 100000; ++i) {
+        const COutPoint outpoint{InsecureRand256(), i % 4};
+        Coin coin;
+        SetCoinsValue(VALUE1, coin);
+        cache.AddCoin(outpoint, std::move(coin), /*possible_overwrite=*/false);
+        std_map.try_emplace(outpoint);
+    }
+    cache.SelfTest();
+
+    // Nodes packed into the pool's chunks are accounted for as using less
+    // memory than nodes allocated one by one
+    BOOST_CHECK_LT(memusage::DynamicUsage(cache.map()), memusage::DynamicUsage(std_map));
+
+    // Flushing gives the chunks back
+    cache.SetBestBlock(InsecureRand256());
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK_EQUAL(cache.DynamicMemoryUsage(), empty_usage);
+    BOOST_CHECK_EQUAL(base.GetCacheSize(), 100000U);
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_sync)
+{
+    CCoinsView root;
+    CCoinsViewCacheTest base{&root};
+    CCoinsViewCacheTest cache{&base};
+    const COutPoint created{InsecureRand256(), 0};
+    const COutPoint spent{InsecureRand256(), 1};
+
+    Coin coin;
+    SetCoinsValue(VALUE1, coin);
+    base.AddCoin(spent, Coin{coin}, /*possible_overwrite=*/false);
+    cache.AddCoin(created, std::move(coin), /*possible_overwrite=*/false);
+    BOOST_CHECK(cache.SpendCoin(spent));
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 2U);
+
+    // The base learns about both changes, while the cache keeps only the
+    // unspent coin, no longer modified.
+    cache.SetBestBlock(InsecureRand256());
+    BOOST_CHECK(cache.Sync());
+    cache.SelfTest();
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 1U);
+    BOOST_CHECK(cache.HaveCoinInCache(created));
+    BOOST_CHECK(cache.map().find(created)->second.flags == 0);
+    BOOST_CHECK(base.HaveCoinInCache(created));
+    BOOST_CHECK(!base.HaveCoinInCache(spent));
+    BOOST_CHECK_EQUAL(base.GetBestBlock(), cache.GetBestBlock());
+
+    // Spending the cached coin and syncing again reaches the base too.
+    BOOST_CHECK(cache.SpendCoin(created));
+    BOOST_CHECK(cache.Sync());
+    cache.SelfTest();
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+    BOOST_CHECK(!base.HaveCoin(created));
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_db_write_behind)
+{
+    CCoinsViewDB db{"test", /*nCacheSize=*/1 << 23, /*fMemory=*/true, /*fWipe=*/false, /*write_behind=*/true};
+    const COutPoint outpoint{InsecureRand256(), 0};
+    Coin coin;
+    SetCoinsValue(VALUE1, coin);
+
+    // Whether or not the write is still in flight, the database view
+    // already reflects it.
+    const uint256 first_block{InsecureRand256()};
+    {
+        CCoinsViewCache cache{&db};
+        cache.AddCoin(outpoint, Coin{coin}, /*possible_overwrite=*/false);
+        cache.SetBestBlock(first_block);
+        BOOST_CHECK(cache.Flush());
+    }
+    BOOST_CHECK(db.HaveCoin(outpoint));
+    Coin read;
+    BOOST_CHECK(db.GetCoin(outpoint, read));
+    BOOST_CHECK(read.out == coin.out);
+    BOOST_CHECK_EQUAL(db.GetBestBlock(), first_block);
+    BOOST_CHECK(db.GetHeadBlocks().empty());
+
+    // The cursor sees the committed write.
+    auto cursor{db.Cursor()};
+    BOOST_CHECK(!db.WriteFailed());
+    BOOST_CHECK_EQUAL(cursor->GetBestBlock(), first_block);
+    BOOST_REQUIRE(cursor->Valid());
+    COutPoint key;
+    BOOST_CHECK(cursor->GetKey(key));
+    BOOST_CHECK(key == outpoint);
+    cursor.reset();
+
+    // A spent coin hides the one on disk until it is erased there too.
+    const uint256 second_block{InsecureRand256()};
+    {
+        CCoinsViewCache cache{&db};
+        BOOST_CHECK(cache.SpendCoin(outpoint));
+        cache.SetBestBlock(second_block);
+        BOOST_CHECK(cache.Flush());
+    }
+    BOOST_CHECK(!db.HaveCoin(outpoint));
+    BOOST_CHECK(!db.GetCoin(outpoint, read));
+    BOOST_CHECK_EQUAL(db.GetBestBlock(), second_block);
+    BOOST_CHECK(db.WaitForWrite());
+    BOOST_CHECK_EQUAL(db.PendingMemoryUsage(), 0U);
+    BOOST_CHECK(!db.HaveCoin(outpoint));
+    BOOST_CHECK_EQUAL(db.GetBestBlock(), second_block);
+    BOOST_CHECK(db.GetHeadBlocks().empty());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -2,6 +2,9 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <crypto/Lyra2Z/Lyra2Z.h>
+#include <crypto/Lyra2Z/Sponge.h>
+#include <crypto/Lyra2Z/SpongeDispatch.h>
 #include <crypto/aes.h>
 #include <crypto/chacha20.h>
 #include <crypto/chacha_poly_aead.h>
@@ -10,6 +13,7 @@
 #include <crypto/hmac_sha512.h>
 #include <crypto/poly1305.h>
 #include <crypto/ripemd160.h>
+#include <crypto/scrypt.h>
 #include <crypto/sha1.h>
 #include <crypto/sha256.h>
 #include <crypto/sha3.h>
@@ -204,6 +208,60 @@ static std::string LongTestString()
 
 const std::string test1 = LongTestString();
 
+static void TestLyra2Z(const std::vector<unsigned char>& in, const std::string& hexout)
+{
+    BOOST_REQUIRE_EQUAL(in.size(), 80U);
+    uint256 hash;
+    lyra2z_hash((const char*)in.data(), (char*)hash.begin());
+    BOOST_CHECK_EQUAL(HexStr(hash), hexout);
+}
+
+BOOST_AUTO_TEST_CASE(lyra2z_testvectors)
+{
+    // Vectors produced by the original scalar implementation; every sponge
+    // implementation must reproduce them exactly.
+    auto check_vectors = [] {
+        TestLyra2Z(std::vector<unsigned char>(80, 0), "9b63bf262ec6f678d73e101f57dadcfe07b6d1f01c2b6ebfbc84ed3fa2be947d");
+        const char* expected[] = {
+            "d589a56f62a65ab13b816d3531518cd8e7a53c114be052269488b473563e5535",
+            "c5d2bb85a261f51c6f20a32b800a8f8a135f2c733922f7bc6e5f641b367e3055",
+            "13d97a97bb57dd774b51ff2b1c9aad9368fd918606c0560fa82880f785746761",
+        };
+        for (int k = 0; k < 3; ++k) {
+            std::vector<unsigned char> in(80);
+            for (int i = 0; i < 80; ++i) in[i] = i * 7 + k;
+            TestLyra2Z(in, expected[k]);
+        }
+    };
+
+    lyra2_sponge = lyra2_sponge_generic;
+    check_vectors();
+    BOOST_TEST_MESSAGE("Checking Lyra2 sponge implementation " << Lyra2SpongeAutoDetect());
+    check_vectors();
+}
+
+BOOST_AUTO_TEST_CASE(scrypt_multi)
+{
+    // Every lane count (and the scalar tail) must match the one-at-a-time hash.
+    for (size_t count : {1, 3, 4, 7, 8, 13}) {
+        std::vector<std::vector<char>> in;
+        std::vector<uint256> expected(count), hashes(count);
+        std::vector<const char*> in_ptrs;
+        std::vector<char*> out_ptrs;
+        for (size_t i = 0; i < count; ++i) {
+            std::vector<unsigned char> bytes{g_insecure_rand_ctx.randbytes(80)};
+            in.emplace_back(bytes.begin(), bytes.end());
+        }
+        for (size_t i = 0; i < count; ++i) {
+            scrypt_1024_1_1_256(in[i].data(), (char*)expected[i].begin());
+            in_ptrs.push_back(in[i].data());
+            out_ptrs.push_back((char*)hashes[i].begin());
+        }
+        scrypt_1024_1_1_256_multi(in_ptrs.data(), out_ptrs.data(), count);
+        BOOST_CHECK(hashes == expected);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(ripemd160_testvectors) {
     TestRIPEMD160("", "9c1185a5c5e9fc54612808977ee8f548b2258d31");
     TestRIPEMD160("abc", "8eb208f7e05d987a9b044a8e98c6b087f15a0bfc");
@@ -4,10 +4,12 @@
 
 // Unit tests for denial-of-service detection/prevention code
 
+#include <arith_uint256.h>
 #include <banman.h>
 #include <chainparams.h>
 #include <net.h>
 #include <net_processing.h>
+#include <pow.h>
 #include <pubkey.h>
 #include <script/sign.h>
 #include <script/signingprovider.h>
@@ -20,6 +22,7 @@
 #include <util/system.h>
 #include <util/time.h>
 #include <validation.h>
+#include <versionbits.h>
 
 #include <array>
 #include <stdint.h>
@@ -404,4 +407,105 @@ BOOST_AUTO_TEST_CASE(DoS_bantime)
     peerLogic->FinalizeNode(dummyNode);
 }
 
+static CBlockHeader MineHeader(const CBlockIndex& prev, const Consensus::Params& consensus)
+{
+    CBlockHeader header;
+    header.nVersion = VERSIONBITS_TOP_BITS | VERSIONBITS_FORK_LYRA2Z;
+    header.hashPrevBlock = prev.GetBlockHash();
+    // Spaced far enough apart to be allowed the minimum difficulty
+    header.nTime = prev.GetBlockTime() + 3 * consensus.nPowTargetSpacing;
+    header.nBits = UintToArith256(consensus.powLimit).GetCompact();
+    while (!CheckProofOfWork(header.GetPoWHash(), header.nBits, consensus)) ++header.nNonce;
+    return header;
+}
+
+// Test that headers from a peer whose headers PoW time budget is spent are
+// dropped without penalty, and that we ask for them again once it refills.
+BOOST_FIXTURE_TEST_CASE(headers_pow_budget, RegTestingSetup)
+{
+    LOCK(NetEventsInterface::g_msgproc_mutex);
+
+    ConnmanTestMsg& connman = static_cast<ConnmanTestMsg&>(*m_node.connman);
+    connman.SetPeerConnectTimeout(99999s);
+    PeerManager& peerman = *m_node.peerman;
+    const Consensus::Params& consensus{Params().GetConsensus()};
+    const std::atomic<bool> interrupt_dummy{false};
+
+    auto now{GetTime<std::chrono::seconds>()};
+    SetMockTime(now);
+
+    CAddress addr1(ip(0xa0b0c001), NODE_NONE);
+    CNode dummyNode1{/*id=*/0,
+                     /*sock=*/nullptr,
+                     addr1,
+                     /*nKeyedNetGroupIn=*/0,
+                     /*nLocalHostNonceIn=*/0,
+                     CAddress(),
+                     /*addrNameIn=*/"",
+                     ConnectionType::OUTBOUND_FULL_RELAY,
+                     /*inbound_onion=*/false};
+    connman.Handshake(
+        /*node=*/dummyNode1,
+        /*successfully_connected=*/true,
+        /*remote_services=*/ServiceFlags(NODE_NETWORK | NODE_WITNESS),
+        /*local_services=*/ServiceFlags(NODE_NETWORK | NODE_WITNESS),
+        /*version=*/PROTOCOL_VERSION,
+        /*relay_txs=*/true);
+    TestOnlyResetTimeData();
+
+    const auto getheaders_bytes{[&] {
+        CNodeStats stats;
+        dummyNode1.CopyStats(stats);
+        return stats.mapSendBytesPerMsgType[NetMsgType::GETHEADERS];
+    }};
+    const auto send_headers{[&](const CBlockHeader& header) {
+        CDataStream stream{SER_NETWORK, PROTOCOL_VERSION};
+        stream << std::vector<CBlock>{CBlock{header}};
+        peerman.ProcessMessage(dummyNode1, NetMsgType::HEADERS, stream, GetTime<std::chrono::microseconds>(), interrupt_dummy);
+    }};
+    const auto known{[&](const CBlockHeader& header) {
+        return WITH_LOCK(cs_main, return m_node.chainman->m_blockman.LookupBlockIndex(header.GetHash()) != nullptr);
+    }};
+
+    // The initial getheaders goes out with a full budget.
+    BOOST_CHECK(peerman.SendMessages(&dummyNode1));
+    uint64_t sent{getheaders_bytes()};
+    BOOST_CHECK(sent > 0);
+
+    // With some budget left the headers are checked, and hashing them
+    // spends it. The clock is mocked, so nothing is earned back.
+    const CBlockHeader header1{MineHeader(*WITH_LOCK(cs_main, return m_node.chainman->ActiveChain().Tip()), consensus)};
+    peerman.UnitTestSetHeadersPoWBudget(dummyNode1.GetId(), 1us);
+    send_headers(header1);
+    BOOST_CHECK(known(header1));
+
+    // Once it is spent, further headers are dropped without penalty and a
+    // getheaders is held back.
+    const CBlockHeader header2{MineHeader(*WITH_LOCK(cs_main, return m_node.chainman->m_blockman.LookupBlockIndex(header1.GetHash())), consensus)};
+    send_headers(header2);
+    BOOST_CHECK(!known(header2));
+    BOOST_CHECK(peerman.SendMessages(&dummyNode1));
+    BOOST_CHECK(!dummyNode1.fDisconnect);
+    BOOST_CHECK(!m_node.banman->IsDiscouraged(addr1));
+    BOOST_CHECK_EQUAL(getheaders_bytes(), sent);
+
+    // The budget refills at a quarter of the time that passes.
+    peerman.UnitTestSetHeadersPoWBudget(dummyNode1.GetId(), -1s);
+    now += 2s;
+    SetMockTime(now);
+    BOOST_CHECK(peerman.SendMessages(&dummyNode1));
+    BOOST_CHECK_EQUAL(getheaders_bytes(), sent);
+
+    // When it is positive again the deferred getheaders is sent, and the
+    // headers it brings are accepted.
+    now += 4s;
+    SetMockTime(now);
+    BOOST_CHECK(peerman.SendMessages(&dummyNode1));
+    BOOST_CHECK(getheaders_bytes() > sent);
+    send_headers(header2);
+    BOOST_CHECK(known(header2));
+
+    peerman.FinalizeNode(dummyNode1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -10,6 +10,9 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <utility>
+#include <vector>
+
 BOOST_FIXTURE_TEST_SUITE(flatfile_tests, BasicTestingSetup)
 
 BOOST_AUTO_TEST_CASE(flatfile_filename)
@@ -123,4 +126,113 @@ BOOST_AUTO_TEST_CASE(flatfile_flush)
     BOOST_CHECK_EQUAL(fs::file_size(seq.FileName(FlatFilePos(0, 1))), 1U);
 }
 
+BOOST_AUTO_TEST_CASE(flatfile_flusher)
+{
+    const auto data_dir = m_args.GetDataDirBase();
+    FlatFileSeq seq(data_dir, "a", 100);
+    FlatFileFlusher flusher{"testflush"};
+
+    bool out_of_space;
+    seq.Allocate(FlatFilePos(0, 0), 1, out_of_space);
+    seq.Allocate(FlatFilePos(1, 0), 1, out_of_space);
+
+    // Flushes in the background are done in order, and are all done after Wait().
+    std::vector<std::pair<int, bool>> done;
+    for (int file : {0, 1}) {
+        flusher.Add(seq, FlatFilePos(file, 1), true, [&done, file](bool ok) { done.emplace_back(file, ok); });
+    }
+    flusher.WaitFor(seq.FileName(FlatFilePos(0, 1)));
+    BOOST_CHECK_EQUAL(fs::file_size(seq.FileName(FlatFilePos(0, 1))), 1U);
+    BOOST_CHECK(flusher.Wait());
+    BOOST_CHECK(done == (std::vector<std::pair<int, bool>>{{0, true}, {1, true}}));
+    BOOST_CHECK_EQUAL(fs::file_size(seq.FileName(FlatFilePos(1, 1))), 1U);
+
+    // Flushes on the calling thread are counted as well.
+    BOOST_CHECK(flusher.Flush(seq, FlatFilePos(0, 1), false));
+    const FlatFileFlushStats stats{flusher.GetStats()};
+    BOOST_CHECK_EQUAL(stats.flushes, 3U);
+    BOOST_CHECK_EQUAL(stats.pending, 0U);
+    BOOST_CHECK(stats.max_time <= stats.total_time);
+}
+
+BOOST_AUTO_TEST_CASE(flatfile_map)
+{
+    const auto data_dir = m_args.GetDataDirBase();
+    FlatFileSeq seq(data_dir, "a", 100);
+    FlatFileMapper mapper(2);
+
+    const std::string line("The root problem with conventional currency is all the trust that's required to make it work.");
+    for (int n = 0; n < 3; ++n) {
+        AutoFile file{seq.Open(FlatFilePos(n, 0))};
+        file << LIMITED_STRING(line, 256);
+    }
+    const fs::path path0 = seq.FileName(FlatFilePos(0, 0));
+
+    // Files are only mapped once finalized.
+    BOOST_CHECK(!mapper.Get(path0));
+    mapper.Finalize(path0);
+    const auto mapping0 = mapper.Get(path0);
+    BOOST_REQUIRE(mapping0);
+    BOOST_CHECK_EQUAL(mapping0->Data().size(), GetSerializeSize(line, CLIENT_VERSION));
+    BOOST_CHECK(mapper.Get(path0) == mapping0);
+    {
+        std::string text;
+        SpanReader reader{SER_DISK, CLIENT_VERSION, UCharSpanCast(mapping0->Data())};
+        reader >> LIMITED_STRING(text, 256);
+        BOOST_CHECK_EQUAL(text, line);
+    }
+
+    // Missing files are not mapped.
+    mapper.Finalize(seq.FileName(FlatFilePos(3, 0)));
+    BOOST_CHECK(!mapper.Get(seq.FileName(FlatFilePos(3, 0))));
+
+    // Mapping a third file drops the least recently used mapping, file 1.
+    for (int n = 1; n < 3; ++n) mapper.Finalize(seq.FileName(FlatFilePos(n, 0)));
+    const auto mapping1 = mapper.Get(seq.FileName(FlatFilePos(1, 0)));
+    BOOST_CHECK(mapper.Get(path0) == mapping0);
+    BOOST_CHECK(mapper.Get(seq.FileName(FlatFilePos(2, 0))));
+    BOOST_CHECK(mapper.Get(path0) == mapping0);
+    BOOST_CHECK(mapper.Get(seq.FileName(FlatFilePos(1, 0))) != mapping1);
+
+    // Unfinalizing drops the mapping, while readers can keep using theirs.
+    mapper.Unfinalize(path0);
+    BOOST_CHECK(!mapper.Get(path0));
+    {
+        std::string text;
+        SpanReader reader{SER_DISK, CLIENT_VERSION, UCharSpanCast(mapping0->Data())};
+        reader >> LIMITED_STRING(text, 256);
+        BOOST_CHECK_EQUAL(text, line);
+    }
+
+    // A read past the mapping maps the file again, in case it grew.
+    const size_t size{GetSerializeSize(line, CLIENT_VERSION)};
+    mapper.Finalize(path0);
+    BOOST_CHECK_EQUAL(mapper.Get(path0)->Data().size(), size);
+    {
+        AutoFile file{seq.Open(FlatFilePos(0, size))};
+        file << LIMITED_STRING(line, 256);
+    }
+    BOOST_CHECK_EQUAL(mapper.Get(path0)->Data().size(), size);
+    const auto grown = mapper.Get(path0, size);
+    BOOST_REQUIRE(grown);
+    BOOST_CHECK_EQUAL(grown->Data().size(), 2 * size);
+    BOOST_CHECK(mapper.Get(path0) == grown);
+    {
+        std::string text;
+        SpanReader reader{SER_DISK, CLIENT_VERSION, UCharSpanCast(grown->Data().subspan(size))};
+        reader >> LIMITED_STRING(text, 256);
+        BOOST_CHECK_EQUAL(text, line);
+    }
+
+    // A file found to have shrunk below its mapping is no longer mapped.
+    {
+        FILE* file = seq.Open(FlatFilePos(0, 0));
+        BOOST_REQUIRE(file);
+        BOOST_CHECK(TruncateFile(file, 10));
+        fclose(file);
+    }
+    BOOST_CHECK(!mapper.Get(path0, 2 * size));
+    BOOST_CHECK(!mapper.Get(path0));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
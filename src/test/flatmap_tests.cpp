@@ -0,0 +1,178 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <flatmap.h>
+#include <memusage.h>
+#include <support/allocators/pool.h>
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+namespace {
+/** Spreads keys over the whole hash, including the tag byte. */
+struct SpreadHasher {
+    size_t operator()(uint32_t key) const { return key * size_t{0x9E3779B97F4A7C15}; }
+};
+
+/** Only 32 distinct hashes, so that entries pile up in long probe sequences and wrap around the table. */
+struct CollidingHasher {
+    size_t operator()(uint32_t key) const { return SpreadHasher{}(key % 32) | (key % 32); }
+};
+
+/** Only 4 distinct hashes, all pointing at the last slots of the table, so that every probe sequence wraps around. */
+struct WrappingHasher {
+    size_t operator()(uint32_t key) const { return ~size_t{0} - key % 4; }
+};
+
+template <typename Map>
+void CheckEqual(const Map& map, const std::unordered_map<uint32_t, std::string>& expected)
+{
+    BOOST_REQUIRE_EQUAL(map.size(), expected.size());
+    size_t visited{0};
+    for (const auto& [key, value] : map) {
+        const auto it{expected.find(key)};
+        BOOST_REQUIRE(it != expected.end());
+        BOOST_CHECK_EQUAL(value, it->second);
+        ++visited;
+    }
+    BOOST_CHECK_EQUAL(visited, expected.size());
+}
+
+/** Apply the same random operations to map and a std::unordered_map, comparing the results. */
+template <typename Map>
+void RandomOperations(Map& map, uint32_t key_range)
+{
+    std::unordered_map<uint32_t, std::string> expected;
+    for (int i = 0; i < 20000; ++i) {
+        const uint32_t key = InsecureRandRange(key_range);
+        const std::string value{std::to_string(InsecureRand32())};
+        switch (InsecureRandRange(5)) {
+        case 0: {
+            const auto [it, inserted]{map.try_emplace(key, value)};
+            const auto [expected_it, expected_inserted]{expected.try_emplace(key, value)};
+            BOOST_CHECK_EQUAL(inserted, expected_inserted);
+            BOOST_CHECK_EQUAL(it->second, expected_it->second);
+            break;
+        }
+        case 1: {
+            const auto [it, inserted]{map.emplace(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(value))};
+            BOOST_CHECK_EQUAL(inserted, expected.emplace(key, value).second);
+            BOOST_CHECK_EQUAL(it->first, key);
+            break;
+        }
+        case 2:
+            map[key] = value;
+            expected[key] = value;
+            break;
+        case 3:
+            BOOST_CHECK_EQUAL(map.erase(key), expected.erase(key));
+            break;
+        case 4: {
+            const auto it{map.find(key)};
+            const auto expected_it{expected.find(key)};
+            BOOST_REQUIRE_EQUAL(it != map.end(), expected_it != expected.end());
+            if (it != map.end()) BOOST_CHECK_EQUAL(it->second, expected_it->second);
+            BOOST_CHECK_EQUAL(map.count(key), expected.count(key));
+            break;
+        }
+        }
+    }
+    CheckEqual(map, expected);
+
+    // Erasing some of the entries while iterating visits each exactly once.
+    const size_t size_before{map.size()};
+    std::unordered_set<uint32_t> visited;
+    for (auto it = map.begin(); it != map.end();) {
+        BOOST_CHECK(visited.insert(it->first).second);
+        if (it->first % 2 == 0) {
+            ++it;
+            continue;
+        }
+        BOOST_CHECK_EQUAL(expected.erase(it->first), 1U);
+        it = map.erase(it);
+    }
+    BOOST_CHECK_EQUAL(visited.size(), size_before);
+    CheckEqual(map, expected);
+
+    // Erasing every entry while iterating visits each exactly once.
+    for (auto it = map.begin(); it != map.end(); it = map.erase(it)) {
+        BOOST_CHECK_EQUAL(expected.erase(it->first), 1U);
+    }
+    BOOST_CHECK(expected.empty());
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.begin() == map.end());
+}
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(flatmap_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(random_operations)
+{
+    FlatHashMap<uint32_t, std::string, SpreadHasher> map;
+    RandomOperations(map, 2000);
+}
+
+BOOST_AUTO_TEST_CASE(colliding_hashes)
+{
+    // Long probe sequences, wrapped around the end of the table, exercise
+    // the shifting on insert and erase and the growth past MAX_DIST.
+    FlatHashMap<uint32_t, std::string, CollidingHasher> map;
+    RandomOperations(map, 1000);
+}
+
+BOOST_AUTO_TEST_CASE(wrapped_probe_sequences)
+{
+    // An erase near the end of the table shifts entries from its start back
+    // to the end, which iterating must not visit again.
+    FlatHashMap<uint32_t, std::string, WrappingHasher> map;
+    RandomOperations(map, 100);
+}
+
+BOOST_AUTO_TEST_CASE(reserve_and_clear)
+{
+    FlatHashMap<uint32_t, std::string, SpreadHasher> map;
+    BOOST_CHECK_EQUAL(map.AllocatedBytes(), 0U);
+    BOOST_CHECK(map.begin() == map.end());
+    BOOST_CHECK(map.find(1) == map.end());
+
+    map.reserve(1000);
+    const size_t reserved{map.AllocatedBytes()};
+    BOOST_CHECK(reserved > 0);
+    for (uint32_t i = 0; i < 1000; ++i) {
+        map.try_emplace(i, std::to_string(i));
+    }
+    BOOST_CHECK_EQUAL(map.size(), 1000U);
+    BOOST_CHECK_EQUAL(map.AllocatedBytes(), reserved);
+
+    // clear() keeps the table.
+    map.clear();
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.find(1) == map.end());
+    BOOST_CHECK_EQUAL(map.AllocatedBytes(), reserved);
+    map[7] = "seven";
+    BOOST_CHECK_EQUAL(map.find(7)->second, "seven");
+    BOOST_CHECK_EQUAL(memusage::DynamicUsage(map), memusage::MallocUsage(reserved));
+}
+
+BOOST_AUTO_TEST_CASE(pool_allocator)
+{
+    // As with the coins cache, the table is larger than the pool's blocks and
+    // bypasses it, so the resource never needs a chunk.
+    using Map = FlatHashMap<uint32_t, std::string, SpreadHasher, std::equal_to<uint32_t>,
+                            PoolAllocator<std::pair<const uint32_t, std::string>, 64>>;
+    Map::allocator_type::ResourceType resource{4096};
+    Map map{0, SpreadHasher{}, Map::key_equal{}, &resource};
+    RandomOperations(map, 2000);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 0U);
+    BOOST_CHECK_EQUAL(memusage::DynamicUsage(map), memusage::MallocUsage(map.AllocatedBytes()));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -143,4 +143,46 @@ BOOST_AUTO_TEST_CASE(headers_sync_state)
     BOOST_CHECK(result.success);
 }
 
+// The difficulty bound of the retargeting window after the Lyra2Z fork is
+// applied in presync, across headers messages.
+BOOST_AUTO_TEST_CASE(headers_sync_difficulty_window)
+{
+    const auto chain_params{CreateChainParams(*m_node.args, CBaseChainParams::MAIN)};
+    const Consensus::Params& consensus{chain_params->GetConsensus()};
+    const uint32_t nbits{0x1c0fffff};
+    const arith_uint256 target{arith_uint256().SetCompact(nbits)};
+
+    std::vector<uint256> hashes(100);
+    std::vector<CBlockIndex> blocks(100);
+    for (size_t i = 0; i < blocks.size(); i++) {
+        hashes[i] = uint256{uint8_t(i + 1)};
+        blocks[i].phashBlock = &hashes[i];
+        blocks[i].pprev = i ? &blocks[i - 1] : nullptr;
+        blocks[i].nHeight = consensus.ACMZawyLWMAHeight + 100 + i;
+        blocks[i].nTime = 1600000000 + i * consensus.nPowTargetSpacing;
+        blocks[i].nBits = nbits;
+    }
+
+    auto sync = [&](uint32_t last_nbits) {
+        std::vector<CBlockHeader> headers(4);
+        uint256 prev_hash{blocks.back().GetBlockHeader().GetHash()};
+        for (size_t i = 0; i < headers.size(); i++) {
+            headers[i].hashPrevBlock = prev_hash;
+            headers[i].nTime = blocks.back().nTime + (i + 1) * consensus.nPowTargetSpacing;
+            headers[i].nBits = i + 1 < headers.size() ? nbits : last_nbits;
+            prev_hash = headers[i].GetHash();
+        }
+        HeadersSyncState hss{0, consensus, &blocks.back(), /*minimum_required_work=*/~arith_uint256{}};
+        const std::vector<CBlockHeader> first(headers.begin(), headers.begin() + 2);
+        if (!hss.ProcessNextHeaders(first, true).success) return false;
+        const std::vector<CBlockHeader> second(headers.begin() + 2, headers.end());
+        return hss.ProcessNextHeaders(second, true).success;
+    };
+
+    // LWMA eases the difficulty by at most a factor of 6 over its window.
+    BOOST_CHECK(sync(nbits));
+    BOOST_CHECK(sync(arith_uint256{target * 6}.GetCompact()));
+    BOOST_CHECK(!sync(arith_uint256{target * 7}.GetCompact()));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
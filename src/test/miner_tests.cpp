@@ -8,7 +8,11 @@
 #include <consensus/tx_verify.h>
 #include <node/miner.h>
 #include <policy/policy.h>
+#include <pow.h>
+#include <rpc/request.h>
+#include <rpc/server.h>
 #include <script/standard.h>
+#include <test/util/script.h>
 #include <test/util/txmempool.h>
 #include <timedata.h>
 #include <txmempool.h>
@@ -17,9 +21,12 @@
 #include <util/system.h>
 #include <util/time.h>
 #include <validation.h>
+#include <validationinterface.h>
 #include <versionbits.h>
 
+#include <test/util/mining.h>
 #include <test/util/setup_common.h>
+#include <univalue.h>
 
 #include <memory>
 
@@ -27,6 +34,8 @@
 
 using node::BlockAssembler;
 using node::CBlockTemplate;
+using node::LIVE_TEMPLATE_UPDATE_INTERVAL;
+using node::LiveBlockTemplate;
 
 namespace miner_tests {
 struct MinerTestingSetup : public TestingSetup {
@@ -652,4 +661,232 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     TestPrioritisedMining(scriptPubKey, txFirst);
 }
 
+BOOST_AUTO_TEST_CASE(search_nonce)
+{
+    const auto chainParams = CreateChainParams(*m_node.args, CBaseChainParams::REGTEST);
+    const Consensus::Params& consensus{chainParams->GetConsensus()};
+    for (const int32_t version : {VERSIONBITS_TOP_BITS, VERSIONBITS_TOP_BITS | VERSIONBITS_FORK_LYRA2Z}) {
+        CBlockHeader header;
+        header.nVersion = version;
+        header.hashPrevBlock = InsecureRand256();
+        header.hashMerkleRoot = InsecureRand256();
+        // About one nonce in 128 is valid.
+        header.nBits = 0x2000ffff;
+
+        // Any thread count finds the lowest valid nonce.
+        uint64_t max_tries{10000};
+        node::NonceSearcher single{/*threads=*/1};
+        BOOST_CHECK(single.Search(header, consensus, max_tries, [] { return false; }));
+        BOOST_CHECK(CheckProofOfWork(header.GetPoWHash(), header.nBits, consensus));
+        const uint32_t nonce{header.nNonce};
+        BOOST_CHECK_EQUAL(max_tries, 10000U - nonce);
+        for (const int threads : {2, 3}) {
+            node::NonceSearcher searcher{threads};
+            // The same threads serve one search after another.
+            for (int search = 0; search < 2; ++search) {
+                header.nNonce = 0;
+                max_tries = 10000;
+                BOOST_CHECK(searcher.Search(header, consensus, max_tries, [] { return false; }));
+                BOOST_CHECK_EQUAL(header.nNonce, nonce);
+                BOOST_CHECK_EQUAL(max_tries, 10000U - nonce);
+            }
+
+            // Running out of tries stops at the first nonce not tried.
+            header.nNonce = 0;
+            max_tries = nonce;
+            BOOST_CHECK(!searcher.Search(header, consensus, max_tries, [] { return false; }));
+            BOOST_CHECK_EQUAL(header.nNonce, nonce);
+            BOOST_CHECK_EQUAL(max_tries, 0U);
+        }
+    }
+}
+
+static std::set<uint256> TemplateTxids(const CBlockTemplate& block_template)
+{
+    std::set<uint256> txids;
+    for (const auto& tx : block_template.block.vtx) {
+        if (!tx->IsCoinBase()) txids.insert(tx->GetHash());
+    }
+    return txids;
+}
+
+BOOST_AUTO_TEST_CASE(update_block)
+{
+    CTxMemPool& tx_mempool{MakeMempool()};
+    BlockAssembler::Options options;
+    options.test_block_validity = false;
+    const auto assembler{[&] { return BlockAssembler{m_node.chainman->ActiveChainstate(), &tx_mempool, options}; }};
+
+    TestMemPoolEntryHelper entry;
+    const auto add_tx{[&](const uint256& prev_hash, CAmount fee) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].scriptSig = CScript() << OP_1;
+        tx.vin[0].prevout = COutPoint{prev_hash, 0};
+        tx.vout.resize(1);
+        tx.vout[0].nValue = 5000000000LL - fee;
+        LOCK2(::cs_main, tx_mempool.cs);
+        tx_mempool.addUnchecked(entry.Fee(fee).FromTx(tx));
+        return tx.GetHash();
+    }};
+
+    std::vector<uint256> parents;
+    for (int i = 0; i < 10; ++i) parents.push_back(add_tx(InsecureRand256(), 5000));
+    const uint256 free_parent{add_tx(InsecureRand256(), 0)};
+    auto block_template{assembler().CreateNewBlock(P2WSH_OP_TRUE)};
+    BOOST_REQUIRE(block_template);
+    BOOST_CHECK_EQUAL(block_template->block.vtx.size(), 11U);
+
+    // With room to spare, updating for the added transactions gives the block
+    // a fresh assembly would: here the children of the parents, a child paying
+    // for the free parent, and a free transaction that is left out.
+    std::vector<uint256> added;
+    for (int i = 0; i < 5; ++i) added.push_back(add_tx(parents[i], 5000));
+    added.push_back(add_tx(free_parent, 50000));
+    added.push_back(add_tx(InsecureRand256(), 0));
+    block_template = assembler().UpdateBlock(std::move(block_template), added);
+    BOOST_REQUIRE(block_template);
+    BOOST_CHECK_EQUAL(block_template->block.vtx.size(), 18U);
+    auto fresh{assembler().CreateNewBlock(P2WSH_OP_TRUE)};
+    BOOST_CHECK(TemplateTxids(*block_template) == TemplateTxids(*fresh));
+    BOOST_CHECK_EQUAL(block_template->vTxFees[0], fresh->vTxFees[0]);
+    BOOST_CHECK_EQUAL(block_template->block.vtx[0]->vout[0].nValue, fresh->block.vtx[0]->vout[0].nValue);
+
+    // Transactions gone from the mempool are dropped, with those spending them.
+    {
+        LOCK2(::cs_main, tx_mempool.cs);
+        tx_mempool.removeRecursive(*tx_mempool.get(parents[0]), MemPoolRemovalReason::CONFLICT);
+    }
+    block_template = assembler().UpdateBlock(std::move(block_template), {});
+    BOOST_REQUIRE(block_template);
+    BOOST_CHECK_EQUAL(block_template->block.vtx.size(), 16U);
+    fresh = assembler().CreateNewBlock(P2WSH_OP_TRUE);
+    BOOST_CHECK(TemplateTxids(*block_template) == TemplateTxids(*fresh));
+    BOOST_CHECK_EQUAL(block_template->vTxFees[0], fresh->vTxFees[0]);
+
+    // A template for another tip is made afresh.
+    block_template->block.hashPrevBlock = InsecureRand256();
+    BOOST_CHECK(!assembler().UpdateBlock(std::move(block_template), {}));
+}
+
+BOOST_AUTO_TEST_CASE(live_block_template)
+{
+    CTxMemPool& tx_mempool{MakeMempool()};
+    BlockAssembler::Options options;
+    options.test_block_validity = false;
+    auto live{std::make_shared<LiveBlockTemplate>(m_node.chainman->ActiveChainstate(), tx_mempool, P2WSH_OP_TRUE, options)};
+    RegisterSharedValidationInterface(live);
+
+    TestMemPoolEntryHelper entry;
+    const auto add_tx{[&](CAmount fee) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].scriptSig = CScript() << OP_1;
+        tx.vin[0].prevout = COutPoint{InsecureRand256(), 0};
+        tx.vout.resize(1);
+        tx.vout[0].nValue = 5000000000LL - fee;
+        const CTransactionRef ptx{MakeTransactionRef(tx)};
+        {
+            LOCK2(::cs_main, tx_mempool.cs);
+            tx_mempool.addUnchecked(entry.Fee(fee).FromTx(ptx));
+            GetMainSignals().TransactionAddedToMempool(ptx, tx_mempool.GetAndIncrementSequence());
+        }
+        SyncWithValidationInterfaceQueue();
+        return ptx->GetHash();
+    }};
+    const auto get{[&] {
+        LOCK(::cs_main);
+        auto txids{TemplateTxids(live->Get(tx_mempool.GetTransactionsUpdated()))};
+        return std::make_pair(txids, live->GetRevision());
+    }};
+
+    int64_t now{GetTime()};
+    SetMockTime(now);
+    const uint256 paying{add_tx(5000)};
+    const uint256 free{add_tx(0)};
+    auto [txids, revision]{get()};
+    BOOST_CHECK(txids == std::set<uint256>{paying});
+
+    const auto needs_update{[&] { return WITH_LOCK(::cs_main, return live->NeedsUpdate(tx_mempool.GetTransactionsUpdated())); }};
+
+    // Unchanged while the mempool is, and while it was updated just now.
+    BOOST_CHECK(!needs_update());
+    BOOST_CHECK(get() == std::make_pair(txids, revision));
+    const uint256 added{add_tx(5000)};
+    BOOST_CHECK(!needs_update());
+    BOOST_CHECK(get() == std::make_pair(txids, revision));
+
+    // Then it picks up the notified transactions.
+    SetMockTime(now += LIVE_TEMPLATE_UPDATE_INTERVAL);
+    BOOST_CHECK(needs_update());
+    std::tie(txids, revision) = get();
+    BOOST_CHECK(txids == (std::set<uint256>{paying, added}));
+
+    // A fee delta on a transaction it has not selected is picked up too.
+    tx_mempool.PrioritiseTransaction(free, 10000);
+    SetMockTime(now += LIVE_TEMPLATE_UPDATE_INTERVAL);
+    auto [prioritised_txids, prioritised_revision]{get()};
+    BOOST_CHECK(prioritised_txids == (std::set<uint256>{paying, added, free}));
+    BOOST_CHECK(prioritised_revision != revision);
+
+    // And so is taking it away again.
+    tx_mempool.PrioritiseTransaction(free, -10000);
+    SetMockTime(now += LIVE_TEMPLATE_UPDATE_INTERVAL);
+    BOOST_CHECK(get().first == txids);
+
+    UnregisterSharedValidationInterface(live);
+}
+
+static UniValue GetBlockTemplate(node::NodeContext& node, const std::vector<std::string>& rules)
+{
+    UniValue client_rules{UniValue::VARR};
+    for (const std::string& rule : rules) client_rules.push_back(rule);
+    UniValue template_request{UniValue::VOBJ};
+    template_request.pushKV("rules", client_rules);
+    JSONRPCRequest request;
+    request.context = &node;
+    request.strMethod = "getblocktemplate";
+    request.params = UniValue{UniValue::VARR};
+    request.params.push_back(template_request);
+    if (RPCIsInWarmup(nullptr)) SetRPCWarmupFinished();
+    try {
+        return tableRPC.execute(request);
+    } catch (const UniValue& error) {
+        throw std::runtime_error(find_value(error, "message").get_str());
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(getblocktemplate_cache, RegTestingSetup)
+{
+    // The template for height 2 needs the Lyra2Z version bit.
+    m_node.args->ForceSetArg("-blockversion", ToString(VERSIONBITS_TOP_BITS | VERSIONBITS_FORK_LYRA2Z));
+    int64_t now{GetTime()};
+    SetMockTime(now);
+    const UniValue first{GetBlockTemplate(m_node, {"segwit"})};
+
+    // A repeated call only refreshes the time.
+    SetMockTime(++now);
+    UniValue cached{GetBlockTemplate(m_node, {"segwit"})};
+    BOOST_CHECK_EQUAL(cached["curtime"].getInt<int64_t>(), now);
+    cached.pushKV("curtime", first["curtime"]);
+    BOOST_CHECK_EQUAL(cached.write(), first.write());
+
+    // Results are kept per set of rules, the oldest making way for new ones.
+    UniValue expected{first};
+    expected.pushKV("curtime", now);
+    for (int i = 0; i < 10; ++i) {
+        BOOST_CHECK_EQUAL(GetBlockTemplate(m_node, {"segwit", strprintf("rule%d", i)}).write(), expected.write());
+    }
+    BOOST_CHECK_EQUAL(GetBlockTemplate(m_node, {"segwit"}).write(), expected.write());
+
+    // A new tip is picked up at once.
+    const auto block{CreateBlockChain(1, Params()).front()};
+    BOOST_CHECK(m_node.chainman->ProcessNewBlock(block, /*force_processing=*/true, /*min_pow_checked=*/true, nullptr));
+    const UniValue next{GetBlockTemplate(m_node, {"segwit"})};
+    BOOST_CHECK_EQUAL(next["previousblockhash"].get_str(), block->GetHash().GetHex());
+    BOOST_CHECK_EQUAL(next["height"].getInt<int>(), 2);
+    BOOST_CHECK(next["longpollid"].get_str() != first["longpollid"].get_str());
+    SetMockTime(0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,93 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <memusage.h>
+#include <support/allocators/pool.h>
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(pool_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(freelist_reuse)
+{
+    PoolResource<128, 8> resource{1024};
+
+    // Blocks are handed out one after another from the chunk.
+    std::byte* a{static_cast<std::byte*>(resource.Allocate(8, 8))};
+    std::byte* b{static_cast<std::byte*>(resource.Allocate(8, 8))};
+    BOOST_CHECK_EQUAL(b - a, 8);
+
+    // A freed block is reused for the next allocation of the same size only.
+    resource.Deallocate(a, 8, 8);
+    std::byte* c{static_cast<std::byte*>(resource.Allocate(16, 8))};
+    BOOST_CHECK(c != a);
+    BOOST_CHECK(resource.Allocate(7, 8) == a);
+    resource.Deallocate(b, 8, 8);
+    resource.Deallocate(c, 16, 8);
+    resource.Deallocate(a, 7, 8);
+
+    // Larger blocks, or stricter alignment, bypass the pool.
+    void* big{resource.Allocate(256, 8)};
+    void* aligned{resource.Allocate(8, 64)};
+    BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(aligned) % 64, 0U);
+    resource.Deallocate(big, 256, 8);
+    resource.Deallocate(aligned, 8, 64);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(new_chunks)
+{
+    PoolResource<128, 8> resource{1024};
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 0U);
+
+    // Once a chunk is used up a new one is requested; nothing else is lost.
+    std::vector<void*> blocks;
+    for (size_t i = 0; i < 1024 / 128 + 1; ++i) {
+        blocks.push_back(resource.Allocate(128, 8));
+    }
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 2U);
+    for (void* block : blocks) {
+        resource.Deallocate(block, 128, 8);
+    }
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        resource.Allocate(128, 8);
+    }
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(unordered_map)
+{
+    using Map = std::unordered_map<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>,
+                                   PoolAllocator<std::pair<const uint64_t, uint64_t>, sizeof(std::pair<const uint64_t, uint64_t>) + sizeof(void*) * 4>>;
+    Map::allocator_type::ResourceType resource{4096};
+    {
+        Map map{0, std::hash<uint64_t>{}, Map::key_equal{}, &resource};
+        for (uint64_t i = 0; i < 10000; ++i) {
+            map.emplace(i, i * 2);
+        }
+        for (uint64_t i = 0; i < 10000; i += 2) {
+            map.erase(i);
+        }
+        BOOST_CHECK_EQUAL(map.size(), 5000U);
+        for (uint64_t i = 1; i < 10000; i += 2) {
+            BOOST_CHECK_EQUAL(map.at(i), i * 2);
+        }
+
+        // Erased nodes are reused rather than new chunks requested.
+        const size_t chunks{resource.NumAllocatedChunks()};
+        for (uint64_t i = 0; i < 10000; i += 2) {
+            map.emplace(i, i);
+        }
+        BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), chunks);
+        BOOST_CHECK(memusage::DynamicUsage(map) >= chunks * resource.ChunkSizeBytes());
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -5,6 +5,8 @@
 #include <chain.h>
 #include <chainparams.h>
 #include <pow.h>
+#include <powcache.h>
+#include <versionbits.h>
 #include <test/util/setup_common.h>
 
 #include <boost/test/unit_test.hpp>
@@ -201,4 +203,64 @@ BOOST_AUTO_TEST_CASE(ChainParams_SIGNET_sanity)
     sanity_check_chainparams(*m_node.args, CBaseChainParams::SIGNET);
 }
 
+BOOST_AUTO_TEST_CASE(pow_cache)
+{
+    const auto chainParams = CreateChainParams(*m_node.args, CBaseChainParams::REGTEST);
+    const Consensus::Params& consensus{chainParams->GetConsensus()};
+
+    CBlockHeader header;
+    header.nVersion = VERSIONBITS_FORK_LYRA2Z;
+    header.nBits = UintToArith256(consensus.powLimit).GetCompact();
+    while (!CheckProofOfWork(header.GetPoWHash(), header.nBits, consensus)) ++header.nNonce;
+
+    // The first check hashes the header, the second is answered by the cache.
+    const PoWCacheStats before{GetPoWCacheStats()};
+    BOOST_CHECK(!PoWCacheContains(header.GetHash()));
+    BOOST_CHECK(CheckBlockHeaderProofOfWork(header, consensus));
+    BOOST_CHECK(CheckBlockHeaderProofOfWork(header, consensus));
+    BOOST_CHECK(PoWCacheContains(header.GetHash()));
+    const PoWCacheStats after{GetPoWCacheStats()};
+    BOOST_CHECK_EQUAL(after.misses - before.misses, 2U);
+    BOOST_CHECK_EQUAL(after.hits - before.hits, 2U);
+
+    // A header failing its check is not remembered. The block hash commits to
+    // nBits, so the same nonce with a harder target is a different entry.
+    header.nBits = 0x1b00ffff;
+    BOOST_CHECK(!CheckBlockHeaderProofOfWork(header, consensus));
+    BOOST_CHECK(!PoWCacheContains(header.GetHash()));
+}
+
+BOOST_AUTO_TEST_CASE(permitted_difficulty_transitions)
+{
+    const auto chainParams = CreateChainParams(*m_node.args, CBaseChainParams::MAIN);
+    const Consensus::Params& consensus{chainParams->GetConsensus()};
+    const uint32_t nbits{0x1c0fffff};
+    const arith_uint256 target{arith_uint256().SetCompact(nbits)};
+
+    // Every block is retargeted after the fork, by DGW and then by LWMA.
+    for (const int start : {consensus.Lyra2zHFHeight + 100, consensus.ACMZawyLWMAHeight + 100}) {
+        const unsigned int factor = start < consensus.ACMZawyLWMAHeight ? 3 : 6;
+        std::vector<CBlockIndex> blocks(100);
+        for (size_t i = 0; i < blocks.size(); i++) {
+            blocks[i].pprev = i ? &blocks[i - 1] : nullptr;
+            blocks[i].nHeight = start + i;
+            blocks[i].nBits = nbits;
+        }
+
+        std::vector<CBlockHeader> headers(3);
+        for (CBlockHeader& header : headers) header.nBits = nbits;
+        BOOST_CHECK(PermittedDifficultyTransitions(consensus, blocks.back(), headers));
+
+        // Easing by the most the algorithm allows is fine, more is not.
+        headers[1].nBits = arith_uint256{target * factor}.GetCompact();
+        BOOST_CHECK(PermittedDifficultyTransitions(consensus, blocks.back(), headers));
+        headers[1].nBits = arith_uint256{target * (factor + 1)}.GetCompact();
+        BOOST_CHECK(!PermittedDifficultyTransitions(consensus, blocks.back(), headers));
+
+        // Any increase of the difficulty is permitted.
+        headers[1].nBits = arith_uint256{target >> 8}.GetCompact();
+        BOOST_CHECK(PermittedDifficultyTransitions(consensus, blocks.back(), headers));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
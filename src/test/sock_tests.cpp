@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <compat/compat.h>
+#include <fs.h>
 #include <test/util/setup_common.h>
 #include <util/sock.h>
 #include <util/system.h>
@@ -11,6 +12,8 @@
 #include <boost/test/unit_test.hpp>
 
 #include <cassert>
+#include <cstdio>
+#include <string>
 #include <thread>
 
 using namespace std::chrono_literals;
@@ -157,6 +160,32 @@ BOOST_AUTO_TEST_CASE(recv_until_terminator_limit)
     receiver.join();
 }
 
+BOOST_AUTO_TEST_CASE(send_file)
+{
+    int s[2];
+    CreateSocketPair(s);
+
+    Sock sock_send(s[0]);
+    Sock sock_recv(s[1]);
+
+    const std::string contents{"0123456789abcdef"};
+    const fs::path path{m_args.GetDataDirBase() / "send_file"};
+    FILE* file{fsbridge::fopen(path, "wb+")};
+    BOOST_REQUIRE(file);
+    BOOST_REQUIRE_EQUAL(fwrite(contents.data(), 1, contents.size(), file), contents.size());
+    BOOST_REQUIRE_EQUAL(fflush(file), 0);
+
+    BOOST_REQUIRE_EQUAL(sock_send.SendFile(fileno(file), 4, 8), 8);
+    char buf[8];
+    BOOST_REQUIRE_EQUAL(sock_recv.Recv(buf, sizeof(buf), 0), 8);
+    BOOST_CHECK_EQUAL(std::string(buf, sizeof(buf)), "456789ab");
+
+    // Nothing left to send past the end of the file is an error, not a zero-length send.
+    BOOST_CHECK_EQUAL(sock_send.SendFile(fileno(file), contents.size(), 1), -1);
+
+    fclose(file);
+}
+
 #endif /* WIN32 */
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -4,6 +4,7 @@
 
 #include <test/util/mining.h>
 
+#include <arith_uint256.h>
 #include <chainparams.h>
 #include <consensus/merkle.h>
 #include <key_io.h>
@@ -43,14 +44,16 @@ std::vector<std::shared_ptr<CBlock>> CreateBlockChain(size_t total_height, const
         coinbase_tx.vin[0].scriptSig = CScript() << (height + 1) << OP_0;
         block.vtx = {MakeTransactionRef(std::move(coinbase_tx))};
 
-        block.nVersion = VERSIONBITS_LAST_OLD_BLOCK_VERSION;
+        block.nVersion = VERSIONBITS_TOP_BITS | VERSIONBITS_FORK_LYRA2Z;
         block.hashPrevBlock = (height >= 1 ? *ret.at(height - 1) : params.GenesisBlock()).GetHash();
         block.hashMerkleRoot = BlockMerkleRoot(block);
-        block.nTime = ++time;
-        block.nBits = params.GenesisBlock().nBits;
+        // Spaced far enough apart to be allowed the minimum difficulty
+        time += 3 * params.GetConsensus().nPowTargetSpacing;
+        block.nTime = time;
+        block.nBits = UintToArith256(params.GetConsensus().powLimit).GetCompact();
         block.nNonce = 0;
 
-        while (!CheckProofOfWork(block.GetHash(), block.nBits, params.GetConsensus())) {
+        while (!CheckProofOfWork(block.GetPoWHash(), block.nBits, params.GetConsensus())) {
             ++block.nNonce;
             assert(block.nNonce);
         }
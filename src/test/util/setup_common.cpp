@@ -30,6 +30,7 @@
 #include <policy/fees.h>
 #include <policy/fees_args.h>
 #include <pow.h>
+#include <powcache.h>
 #include <rpc/blockchain.h>
 #include <rpc/register.h>
 #include <rpc/server.h>
@@ -145,6 +146,7 @@ BasicTestingSetup::BasicTestingSetup(const std::string& chainName, const std::ve
     ApplyArgsManOptions(*m_node.args, validation_cache_sizes);
     Assert(InitSignatureCache(validation_cache_sizes.signature_cache_bytes));
     Assert(InitScriptExecutionCache(validation_cache_sizes.script_execution_cache_bytes));
+    Assert(InitPoWCache(validation_cache_sizes.pow_cache_bytes));
 
     m_node.chain = interfaces::MakeChain(m_node);
     static bool noui_connected = false;
@@ -181,13 +183,14 @@ ChainTestingSetup::ChainTestingSetup(const std::string& chainName, const std::ve
     const ChainstateManager::Options chainman_opts{
         .chainparams = chainparams,
         .adjusted_time_callback = GetAdjustedTime,
-        .check_block_index = true,
+        .check_block_index = m_node.args->GetBoolArg("-checkblockindex", true),
     };
     m_node.chainman = std::make_unique<ChainstateManager>(chainman_opts);
     m_node.chainman->m_blockman.m_block_tree_db = std::make_unique<CBlockTreeDB>(m_cache_sizes.block_tree_db, true);
 
     constexpr int script_check_threads = 2;
     StartScriptCheckWorkerThreads(script_check_threads);
+    StartCoinFetchWorkerThreads(DEFAULT_COIN_FETCH_THREADS);
 }
 
 ChainTestingSetup::~ChainTestingSetup()
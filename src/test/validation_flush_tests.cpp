@@ -2,12 +2,18 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 //
+#include <chainparams.h>
 #include <sync.h>
+#include <test/util/mining.h>
 #include <test/util/setup_common.h>
+#include <txdb.h>
 #include <validation.h>
 
 #include <boost/test/unit_test.hpp>
 
+#include <chrono>
+#include <future>
+
 BOOST_FIXTURE_TEST_SUITE(validation_flush_tests, TestingSetup)
 
 //! Test utilities for detecting when we need to flush the coins cache based
@@ -47,7 +53,9 @@ BOOST_AUTO_TEST_CASE(getcoinscachesizestate)
         BOOST_TEST_MESSAGE("CCoinsViewCache memory usage: " << view.DynamicMemoryUsage());
     };
 
-    constexpr size_t MAX_COINS_CACHE_BYTES = 1024;
+    // PoolResource allocates a 256 KiB chunk for the first coin, so we'll take that and leave room for
+    // the coins on top of it.
+    constexpr size_t MAX_COINS_CACHE_BYTES = 262144 + 32768;
 
     // Without any coins in the cache, we shouldn't need to flush.
     BOOST_CHECK_EQUAL(
@@ -76,13 +84,14 @@ BOOST_AUTO_TEST_CASE(getcoinscachesizestate)
     print_view_mem_usage(view);
     BOOST_CHECK_EQUAL(view.DynamicMemoryUsage(), is_64_bit ? 32U : 16U);
 
-    // We should be able to add COINS_UNTIL_CRITICAL coins to the cache before going CRITICAL.
+    // We should be able to add COINS_UNTIL_LARGE coins to the cache before going LARGE.
     // This is contingent not only on the dynamic memory usage of the Coins
     // that we're adding (COIN_SIZE bytes per), but also on how much memory the
-    // cacheCoins (unordered_map) preallocates.
-    constexpr int COINS_UNTIL_CRITICAL{3};
+    // cacheCoins (unordered_map) allocates: the first coin brings in the pool's
+    // chunk, and the buckets grow with the coins.
+    constexpr int COINS_UNTIL_LARGE{33};
 
-    for (int i{0}; i < COINS_UNTIL_CRITICAL; ++i) {
+    for (int i{0}; i < COINS_UNTIL_LARGE; ++i) {
         COutPoint res = add_coin(view);
         print_view_mem_usage(view);
         BOOST_CHECK_EQUAL(view.AccessCoin(res).DynamicMemoryUsage(), COIN_SIZE);
@@ -91,15 +100,25 @@ BOOST_AUTO_TEST_CASE(getcoinscachesizestate)
             CoinsCacheSizeState::OK);
     }
 
-    // Adding some additional coins will push us over the edge to CRITICAL.
-    for (int i{0}; i < 4; ++i) {
+    // The next coin puts us >90% but not yet critical.
+    add_coin(view);
+    print_view_mem_usage(view);
+    BOOST_CHECK_EQUAL(
+        chainstate.GetCoinsCacheSizeState(MAX_COINS_CACHE_BYTES, /*max_mempool_size_bytes=*/0),
+        CoinsCacheSizeState::LARGE);
+
+    // Adding some additional coins to fill the last 10% will push us over the edge to CRITICAL.
+    for (int i{0}; i < 400; ++i) {
         add_coin(view);
-        print_view_mem_usage(view);
         if (chainstate.GetCoinsCacheSizeState(MAX_COINS_CACHE_BYTES, /*max_mempool_size_bytes=*/0) ==
             CoinsCacheSizeState::CRITICAL) {
             break;
         }
+        BOOST_CHECK_EQUAL(
+            chainstate.GetCoinsCacheSizeState(MAX_COINS_CACHE_BYTES, /*max_mempool_size_bytes=*/0),
+            CoinsCacheSizeState::LARGE);
     }
+    print_view_mem_usage(view);
 
     BOOST_CHECK_EQUAL(
         chainstate.GetCoinsCacheSizeState(MAX_COINS_CACHE_BYTES, /*max_mempool_size_bytes=*/0),
@@ -107,30 +126,36 @@ BOOST_AUTO_TEST_CASE(getcoinscachesizestate)
 
     // Passing non-zero max mempool usage should allow us more headroom.
     BOOST_CHECK_EQUAL(
-        chainstate.GetCoinsCacheSizeState(MAX_COINS_CACHE_BYTES, /*max_mempool_size_bytes=*/1 << 10),
+        chainstate.GetCoinsCacheSizeState(MAX_COINS_CACHE_BYTES, /*max_mempool_size_bytes=*/1 << 16),
         CoinsCacheSizeState::OK);
 
-    for (int i{0}; i < 3; ++i) {
+    for (int i{0}; i < 300; ++i) {
         add_coin(view);
-        print_view_mem_usage(view);
         BOOST_CHECK_EQUAL(
-            chainstate.GetCoinsCacheSizeState(MAX_COINS_CACHE_BYTES, /*max_mempool_size_bytes=*/1 << 10),
+            chainstate.GetCoinsCacheSizeState(MAX_COINS_CACHE_BYTES, /*max_mempool_size_bytes=*/1 << 16),
             CoinsCacheSizeState::OK);
     }
+    print_view_mem_usage(view);
 
-    // Adding another coin with the additional mempool room will put us >90%
+    // Adding some more coins with the additional mempool room will put us >90%
     // but not yet critical.
-    add_coin(view);
+    for (int i{0}; i < 100; ++i) {
+        add_coin(view);
+        if (chainstate.GetCoinsCacheSizeState(MAX_COINS_CACHE_BYTES, /*max_mempool_size_bytes=*/1 << 16) !=
+            CoinsCacheSizeState::OK) {
+            break;
+        }
+    }
     print_view_mem_usage(view);
 
     // Only perform these checks on 64 bit hosts; I haven't done the math for 32.
     if (is_64_bit) {
-        float usage_percentage = (float)view.DynamicMemoryUsage() / (MAX_COINS_CACHE_BYTES + (1 << 10));
+        float usage_percentage = (float)view.DynamicMemoryUsage() / (MAX_COINS_CACHE_BYTES + (1 << 16));
         BOOST_TEST_MESSAGE("CoinsTip usage percentage: " << usage_percentage);
         BOOST_CHECK(usage_percentage >= 0.9);
         BOOST_CHECK(usage_percentage < 1);
         BOOST_CHECK_EQUAL(
-            chainstate.GetCoinsCacheSizeState(MAX_COINS_CACHE_BYTES, 1 << 10),
+            chainstate.GetCoinsCacheSizeState(MAX_COINS_CACHE_BYTES, 1 << 16),
             CoinsCacheSizeState::LARGE);
     }
 
@@ -142,20 +167,76 @@ BOOST_AUTO_TEST_CASE(getcoinscachesizestate)
             CoinsCacheSizeState::OK);
     }
 
-    // Flushing the view doesn't take us back to OK because cacheCoins has
-    // preallocated memory that doesn't get reclaimed even after flush.
-
     BOOST_CHECK_EQUAL(
         chainstate.GetCoinsCacheSizeState(MAX_COINS_CACHE_BYTES, 0),
         CoinsCacheSizeState::CRITICAL);
 
+    // Flushing the view takes us back to OK, as cacheCoins and its pool are
+    // reallocated and the pool has no chunk until the next coin.
     view.SetBestBlock(InsecureRand256());
     BOOST_CHECK(view.Flush());
     print_view_mem_usage(view);
+    // Coins written to the database in the background count until they are.
+    BOOST_CHECK(chainstate.CoinsDB().WaitForWrite());
 
     BOOST_CHECK_EQUAL(
         chainstate.GetCoinsCacheSizeState(MAX_COINS_CACHE_BYTES, 0),
-        CoinsCacheSizeState::CRITICAL);
+        CoinsCacheSizeState::OK);
+}
+
+/** A small mempool, so that its headroom does not keep the coins cache from filling up. */
+struct SmallMempoolSetup : public TestingSetup {
+    SmallMempoolSetup()
+        : TestingSetup{CBaseChainParams::REGTEST, {"-maxmempool=5"}} {}
+};
+
+//! Connecting a block does not wait for the coins of an earlier flush to be
+//! written, although they make the cache look full until they are.
+BOOST_FIXTURE_TEST_CASE(connect_block_with_write_in_flight, SmallMempoolSetup)
+{
+    ChainstateManager& chainman{*Assert(m_node.chainman)};
+    Chainstate& chainstate{chainman.ActiveChainstate()};
+    CCoinsViewDB& db{WITH_LOCK(::cs_main, return chainstate.CoinsDB())};
+    const auto chain{CreateBlockChain(2, Params())};
+    BOOST_REQUIRE(chainman.ProcessNewBlock(chain[0], /*force_processing=*/true, /*min_pow_checked=*/true, nullptr));
+
+    // Flush more coins than the cache and the mempool headroom have room for,
+    // and keep the background thread from writing them.
+    db.PauseWrites(true);
+    {
+        LOCK(::cs_main);
+        chainstate.m_coinstip_cache_size_bytes = 1 << 20;
+        CCoinsViewCache& view{chainstate.CoinsTip()};
+        for (int i{0}; i < 40000; ++i) {
+            Coin coin;
+            coin.nHeight = 1;
+            coin.out.nValue = InsecureRand32();
+            coin.out.scriptPubKey.assign(uint32_t{56}, 1);
+            view.AddCoin(COutPoint{InsecureRand256(), 0}, std::move(coin), false);
+        }
+        BOOST_CHECK_EQUAL(chainstate.GetCoinsCacheSizeState(), CoinsCacheSizeState::CRITICAL);
+        BlockValidationState state;
+        BOOST_CHECK(chainstate.FlushStateToDisk(state, FlushStateMode::IF_NEEDED));
+        BOOST_CHECK(db.WriteInFlight());
+        BOOST_CHECK_EQUAL(chainstate.GetCoinsCacheSizeState(), CoinsCacheSizeState::CRITICAL);
+        BOOST_CHECK_EQUAL(
+            chainstate.GetCoinsCacheSizeState(chainstate.m_coinstip_cache_size_bytes, 5'000'000, /*count_pending_write=*/false),
+            CoinsCacheSizeState::OK);
+    }
+
+    auto connect{std::async(std::launch::async, [&] {
+        return chainman.ProcessNewBlock(chain[1], /*force_processing=*/true, /*min_pow_checked=*/true, nullptr);
+    })};
+    BOOST_CHECK(connect.wait_for(std::chrono::seconds{30}) == std::future_status::ready);
+    BOOST_CHECK(db.WriteInFlight());
+    db.PauseWrites(false);
+    BOOST_CHECK(connect.get());
+    BOOST_CHECK_EQUAL(WITH_LOCK(::cs_main, return chainman.ActiveTip()->GetBlockHash()), chain[1]->GetHash());
+
+    // Once the write is done, the cache is below the limit again.
+    BOOST_CHECK(db.WaitForWrite());
+    BOOST_CHECK(!db.WriteInFlight());
+    BOOST_CHECK_EQUAL(WITH_LOCK(::cs_main, return chainstate.GetCoinsCacheSizeState()), CoinsCacheSizeState::OK);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
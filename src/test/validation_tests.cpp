@@ -2,13 +2,18 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <arith_uint256.h>
 #include <chainparams.h>
 #include <consensus/amount.h>
 #include <net.h>
+#include <node/blockstorage.h>
+#include <pow.h>
 #include <signet.h>
 #include <uint256.h>
 #include <validation.h>
+#include <versionbits.h>
 
+#include <test/util/mining.h>
 #include <test/util/setup_common.h>
 
 #include <boost/test/unit_test.hpp>
@@ -144,4 +149,275 @@ BOOST_AUTO_TEST_CASE(test_assumeutxo)
     BOOST_CHECK_EQUAL(out210.nChainTx, 200U);
 }
 
+BOOST_AUTO_TEST_CASE(process_new_block_headers_pow)
+{
+    ChainstateManager& chainman{*Assert(m_node.chainman)};
+    const CBlockHeader genesis{Params().GenesisBlock().GetBlockHeader()};
+
+    // Headers already in the block index are not hashed again.
+    BlockValidationState state;
+    BOOST_CHECK(chainman.ProcessNewBlockHeaders({genesis}, true, state));
+    BOOST_CHECK(state.IsValid());
+
+    // Enough headers to be spread over the PoW check threads, none of which
+    // meets its target. The failure is still reported for the first one.
+    std::vector<CBlockHeader> headers;
+    uint256 prev{genesis.GetHash()};
+    for (size_t i = 0; i < 3 * MAX_POW_CHECK_HEADERS; ++i) {
+        CBlockHeader header{genesis};
+        header.hashPrevBlock = prev;
+        header.nTime = genesis.nTime + i + 1;
+        header.nBits = 0x1b00ffff;
+        headers.push_back(header);
+        prev = header.GetHash();
+    }
+    BOOST_CHECK(!chainman.ProcessNewBlockHeaders(headers, true, state));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "high-hash");
+    LOCK(cs_main);
+    for (const CBlockHeader& header : headers) {
+        BOOST_CHECK(!chainman.m_blockman.LookupBlockIndex(header.GetHash()));
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(process_new_block_headers_pow_prefix, RegTestingSetup)
+{
+    ChainstateManager& chainman{*Assert(m_node.chainman)};
+    const Consensus::Params& consensus{Params().GetConsensus()};
+
+    // Two valid headers, followed by enough invalid ones to be spread over
+    // the PoW check threads, and a valid header after those.
+    std::vector<CBlockHeader> headers;
+    CBlockHeader prev{Params().GenesisBlock().GetBlockHeader()};
+    for (size_t i = 0; i < 2 + 2 * MAX_POW_CHECK_HEADERS + 1; ++i) {
+        CBlockHeader header;
+        header.nVersion = VERSIONBITS_TOP_BITS | VERSIONBITS_FORK_LYRA2Z;
+        header.hashPrevBlock = prev.GetHash();
+        header.nTime = prev.nTime + 3 * consensus.nPowTargetSpacing;
+        header.nBits = UintToArith256(consensus.powLimit).GetCompact();
+        const bool valid{i < 2 || i == 2 + 2 * MAX_POW_CHECK_HEADERS};
+        if (!valid) header.nBits = 0x1b00ffff;
+        while (CheckProofOfWork(header.GetPoWHash(), header.nBits, consensus) != valid) ++header.nNonce;
+        headers.push_back(header);
+        prev = header;
+    }
+
+    // The valid prefix is accepted and the first invalid header rejected.
+    BlockValidationState state;
+    const CBlockIndex* last{nullptr};
+    BOOST_CHECK(!chainman.ProcessNewBlockHeaders(headers, true, state, &last));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "high-hash");
+    BOOST_CHECK_EQUAL(Assert(last)->GetBlockHash(), headers[1].GetHash());
+    LOCK(cs_main);
+    for (size_t i = 0; i < headers.size(); ++i) {
+        BOOST_CHECK_EQUAL(chainman.m_blockman.LookupBlockIndex(headers[i].GetHash()) != nullptr, i < 2);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(pre_check_headers)
+{
+    const auto chainParams = CreateChainParams(*m_node.args, CBaseChainParams::MAIN);
+    const Consensus::Params& consensus{chainParams->GetConsensus()};
+    const uint32_t nbits{0x1c0fffff};
+    const int64_t start_time{1600000000};
+
+    std::vector<CBlockIndex> blocks(100);
+    for (size_t i = 0; i < blocks.size(); i++) {
+        blocks[i].pprev = i ? &blocks[i - 1] : nullptr;
+        blocks[i].nHeight = consensus.ACMZawyLWMAHeight + 100 + i;
+        blocks[i].nTime = start_time + i * consensus.nPowTargetSpacing;
+        blocks[i].nBits = nbits;
+    }
+    const CBlockIndex& prev{blocks.back()};
+    const NodeClock::time_point now{std::chrono::seconds{prev.GetBlockTime() + 3600}};
+
+    std::vector<CBlockHeader> headers(3);
+    for (size_t i = 0; i < headers.size(); i++) {
+        headers[i].nTime = prev.GetBlockTime() + (i + 1) * consensus.nPowTargetSpacing;
+        headers[i].nBits = nbits;
+    }
+
+    LOCK(cs_main);
+    BlockValidationState state;
+    BOOST_CHECK(PreCheckHeaders(headers, &prev, consensus, now, state));
+
+    // Timestamps must be after the median time past...
+    auto too_old{headers};
+    too_old[0].nTime = prev.GetMedianTimePast() + 1;
+    BOOST_CHECK(PreCheckHeaders(too_old, &prev, consensus, now, state));
+    too_old[0].nTime = prev.GetMedianTimePast();
+    BOOST_CHECK(!PreCheckHeaders(too_old, &prev, consensus, now, state));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "time-too-old");
+
+    // ... and not too far in the future.
+    auto too_new{headers};
+    too_new[2].nTime = TicksSinceEpoch<std::chrono::seconds>(now) + MAX_FUTURE_BLOCK_TIME;
+    state = BlockValidationState{};
+    BOOST_CHECK(PreCheckHeaders(too_new, &prev, consensus, now, state));
+    too_new[2].nTime += 1;
+    BOOST_CHECK(!PreCheckHeaders(too_new, &prev, consensus, now, state));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "time-too-new");
+
+    // Difficulty transitions are checked against the known parent.
+    auto bad_bits{headers};
+    bad_bits[1].nBits = arith_uint256{arith_uint256().SetCompact(nbits) * 7}.GetCompact();
+    state = BlockValidationState{};
+    BOOST_CHECK(!PreCheckHeaders(bad_bits, &prev, consensus, now, state));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "bad-diffbits");
+
+    // Without the parent, neither the transitions nor the median time past
+    // of the first headers can be checked.
+    state = BlockValidationState{};
+    BOOST_CHECK(PreCheckHeaders(bad_bits, nullptr, consensus, now, state));
+    BOOST_CHECK(PreCheckHeaders(too_old, nullptr, consensus, now, state));
+    BOOST_CHECK(!PreCheckHeaders(too_new, nullptr, consensus, now, state));
+}
+
+BOOST_AUTO_TEST_CASE(prefetch_block_inputs)
+{
+    LOCK(cs_main);
+    Chainstate& chainstate{m_node.chainman->ActiveChainstate()};
+    CCoinsViewCache& tip{chainstate.CoinsTip()};
+
+    // Coins in the database, but no longer in the cache.
+    std::vector<COutPoint> on_disk;
+    for (uint32_t i = 0; i < 100; ++i) {
+        on_disk.emplace_back(InsecureRand256(), i);
+        Coin coin;
+        coin.out.nValue = 1000 + i;
+        coin.nHeight = 1;
+        tip.AddCoin(on_disk.back(), std::move(coin), /*possible_overwrite=*/false);
+    }
+    BOOST_CHECK(tip.Flush());
+    const COutPoint cached{on_disk.back()};
+    tip.AccessCoin(cached);
+    const COutPoint missing{InsecureRand256(), 0};
+
+    // A block spending the first half of them, one already cached, one that
+    // does not exist, and one created in the block itself.
+    CBlock block;
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vout.resize(1);
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+    CMutableTransaction spend;
+    for (size_t i = 0; i < on_disk.size() / 2; ++i) {
+        spend.vin.emplace_back(on_disk[i]);
+    }
+    spend.vin.emplace_back(cached);
+    spend.vin.emplace_back(missing);
+    spend.vout.resize(1);
+    const CTransactionRef spend_tx{MakeTransactionRef(spend)};
+    block.vtx.push_back(spend_tx);
+    CMutableTransaction child;
+    child.vin.emplace_back(spend_tx->GetHash(), 0);
+    child.vout.resize(1);
+    block.vtx.push_back(MakeTransactionRef(child));
+
+    BOOST_CHECK_EQUAL(PrefetchBlockInputs(block, tip, chainstate.CoinsDB()), on_disk.size() / 2);
+    for (size_t i = 0; i < on_disk.size() - 1; ++i) {
+        BOOST_CHECK_EQUAL(tip.HaveCoinInCache(on_disk[i]), i < on_disk.size() / 2);
+    }
+    BOOST_CHECK_EQUAL(tip.AccessCoin(on_disk.front()).out.nValue, 1000);
+    BOOST_CHECK(!tip.HaveCoinInCache(missing));
+    BOOST_CHECK(!tip.HaveCoinInCache(COutPoint{spend_tx->GetHash(), 0}));
+
+    // The coins are cached unmodified, and nothing is read twice.
+    BOOST_CHECK_EQUAL(PrefetchBlockInputs(block, tip, chainstate.CoinsDB()), 0U);
+    tip.Uncache(on_disk.front());
+    BOOST_CHECK(!tip.HaveCoinInCache(on_disk.front()));
+}
+
+BOOST_FIXTURE_TEST_CASE(load_external_block_file, RegTestingSetup)
+{
+    ChainstateManager& chainman{*Assert(m_node.chainman)};
+    const auto chain{CreateBlockChain(20, Params())};
+
+    // A block file as left behind by a reindex: blocks 15 to 19 come before
+    // their parents, there is junk between blocks, and block 3 is there twice.
+    CDataStream stream{SER_DISK, CLIENT_VERSION};
+    const auto append{[&](const CBlock& block) {
+        stream << Params().MessageStart() << static_cast<uint32_t>(GetSerializeSize(block, CLIENT_VERSION)) << block;
+    }};
+    for (size_t i = 0; i < 10; ++i) append(*chain[i]);
+    for (size_t i = 15; i < 20; ++i) append(*chain[i]);
+    stream << uint64_t{0xdeadbeef} << uint8_t{0};
+    for (size_t i = 10; i < 15; ++i) append(*chain[i]);
+    append(*chain[3]);
+
+    FlatFilePos pos{1, 0};
+    FILE* file{fsbridge::fopen(node::GetBlockPosFilename(pos), "wb+")};
+    BOOST_REQUIRE(file);
+    BOOST_REQUIRE_EQUAL(fwrite(stream.data(), 1, stream.size(), file), stream.size());
+    rewind(file);
+
+    std::multimap<uint256, FlatFilePos> blocks_with_unknown_parent;
+    chainman.ActiveChainstate().LoadExternalBlockFile(file, &pos, &blocks_with_unknown_parent);
+    BOOST_CHECK(blocks_with_unknown_parent.empty());
+
+    LOCK(cs_main);
+    for (size_t i = 0; i < chain.size(); ++i) {
+        const CBlockIndex* index{chainman.m_blockman.LookupBlockIndex(chain[i]->GetHash())};
+        BOOST_REQUIRE(index);
+        BOOST_CHECK_EQUAL(index->nHeight, int(i + 1));
+        BOOST_CHECK(index->nStatus & BLOCK_HAVE_DATA);
+        BOOST_CHECK(index->IsValid(BLOCK_VALID_TRANSACTIONS));
+        BOOST_CHECK_EQUAL(index->nFile, 1);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(load_external_block_file_batches, RegTestingSetup)
+{
+    ChainstateManager& chainman{*Assert(m_node.chainman)};
+    const auto chain{CreateBlockChain(20, Params())};
+
+    // Blocks are read out a couple at a time, so the batches are checked and
+    // accepted while later ones are read. The first copy of block 5 does not
+    // deserialize, so its children in the next batches wait for the second.
+    // Neither does the first copy of block 15, whose second copy is read out
+    // right after it, before it is checked.
+    CDataStream stream{SER_DISK, CLIENT_VERSION};
+    const auto append{[&](Span<const std::byte> data) {
+        stream << Params().MessageStart() << static_cast<uint32_t>(data.size());
+        stream.write(data);
+    }};
+    const auto append_block{[&](const CBlock& block) {
+        CDataStream block_stream{SER_DISK, CLIENT_VERSION};
+        block_stream << block;
+        append(block_stream);
+    }};
+    const auto append_bad_block{[&](const CBlock& block) {
+        CDataStream bad_block{SER_DISK, CLIENT_VERSION};
+        bad_block << block.GetBlockHeader();
+        bad_block << std::vector<uint8_t>(GetSerializeSize(block, CLIENT_VERSION) - bad_block.size(), 0xff);
+        append(bad_block);
+    }};
+    for (size_t i = 0; i < 5; ++i) append_block(*chain[i]);
+    append_bad_block(*chain[5]);
+    for (size_t i = 6; i < 10; ++i) append_block(*chain[i]);
+    append_block(*chain[5]);
+    for (size_t i = 10; i < 15; ++i) append_block(*chain[i]);
+    append_bad_block(*chain[15]);
+    for (size_t i = 15; i < 20; ++i) append_block(*chain[i]);
+
+    FlatFilePos pos{1, 0};
+    FILE* file{fsbridge::fopen(node::GetBlockPosFilename(pos), "wb+")};
+    BOOST_REQUIRE(file);
+    BOOST_REQUIRE_EQUAL(fwrite(stream.data(), 1, stream.size(), file), stream.size());
+    rewind(file);
+
+    std::multimap<uint256, FlatFilePos> blocks_with_unknown_parent;
+    const uint64_t batch_bytes{2 * GetSerializeSize(*chain[0], CLIENT_VERSION)};
+    chainman.ActiveChainstate().LoadExternalBlockFile(file, &pos, &blocks_with_unknown_parent, batch_bytes);
+    BOOST_CHECK(blocks_with_unknown_parent.empty());
+
+    LOCK(cs_main);
+    for (size_t i = 0; i < chain.size(); ++i) {
+        const CBlockIndex* index{chainman.m_blockman.LookupBlockIndex(chain[i]->GetHash())};
+        BOOST_REQUIRE(index);
+        BOOST_CHECK_EQUAL(index->nHeight, int(i + 1));
+        BOOST_CHECK(index->nStatus & BLOCK_HAVE_DATA);
+        BOOST_CHECK(index->IsValid(BLOCK_VALID_TRANSACTIONS));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
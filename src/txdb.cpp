@@ -6,14 +6,23 @@
 #include <txdb.h>
 
 #include <chain.h>
+#include <checkqueue.h>
+#include <crypto/siphash.h>
+#include <memusage.h>
 #include <pow.h>
 #include <random.h>
 #include <shutdown.h>
 #include <uint256.h>
+#include <util/syscall_sandbox.h>
 #include <util/system.h>
+#include <util/thread.h>
+#include <util/time.h>
 #include <util/translation.h>
 #include <util/vector.h>
 
+#include <algorithm>
+#include <deque>
+#include <iterator>
 #include <stdint.h>
 
 static constexpr uint8_t DB_COIN{'C'};
@@ -25,6 +34,8 @@ static constexpr uint8_t DB_HEAD_BLOCKS{'H'};
 static constexpr uint8_t DB_FLAG{'F'};
 static constexpr uint8_t DB_REINDEX_FLAG{'R'};
 static constexpr uint8_t DB_LAST_BLOCK{'l'};
+static constexpr uint8_t DB_POW_CHECKSUM_KEY{'P'};
+static constexpr uint8_t DB_POW_CHECKSUM{'p'};
 
 // Keys used in previous version that might still be found in the DB:
 static constexpr uint8_t DB_COINS{'c'};
@@ -70,16 +81,31 @@ struct CoinEntry {
 
 } // namespace
 
-CCoinsViewDB::CCoinsViewDB(fs::path ldb_path, size_t nCacheSize, bool fMemory, bool fWipe) :
+CCoinsViewDB::CCoinsViewDB(fs::path ldb_path, size_t nCacheSize, bool fMemory, bool fWipe, bool write_behind) :
     m_db(std::make_unique<CDBWrapper>(ldb_path, nCacheSize, fMemory, fWipe, true)),
     m_ldb_path(ldb_path),
-    m_is_memory(fMemory) { }
+    m_is_memory(fMemory)
+{
+    if (write_behind) {
+        m_write_thread = std::thread(&util::TraceThread, "coinsflush", [this] { ThreadWrite(); });
+    }
+}
+
+CCoinsViewDB::~CCoinsViewDB()
+{
+    if (!m_write_thread.joinable()) return;
+    WITH_LOCK(m_write_mutex, m_stop = true);
+    m_write_cv.notify_all();
+    m_write_thread.join();
+}
 
 void CCoinsViewDB::ResizeCache(size_t new_cache_size)
 {
     // We can't do this operation with an in-memory DB since we'll lose all the coins upon
     // reset.
     if (!m_is_memory) {
+        // The database is reopened below, so it must not be written to meanwhile.
+        WaitForWrite();
         // Have to do a reset first to get the original `m_db` state to release its
         // filesystem lock.
         m_db.reset();
@@ -89,14 +115,42 @@ void CCoinsViewDB::ResizeCache(size_t new_cache_size)
 }
 
 bool CCoinsViewDB::GetCoin(const COutPoint &outpoint, Coin &coin) const {
+    {
+        // Coins not written yet take precedence. Any other coin is not touched
+        // by the write in flight, so the database can be read without the lock.
+        LOCK(m_write_mutex);
+        if (m_pending_write) {
+            const auto it{m_pending_write->coins.find(outpoint)};
+            if (it != m_pending_write->coins.end()) {
+                if (it->second.coin.IsSpent()) return false;
+                coin = it->second.coin;
+                return true;
+            }
+        }
+    }
     return m_db->Read(CoinEntry(&outpoint), coin);
 }
 
 bool CCoinsViewDB::HaveCoin(const COutPoint &outpoint) const {
+    {
+        LOCK(m_write_mutex);
+        if (m_pending_write) {
+            const auto it{m_pending_write->coins.find(outpoint)};
+            if (it != m_pending_write->coins.end()) return !it->second.coin.IsSpent();
+        }
+    }
     return m_db->Exists(CoinEntry(&outpoint));
 }
 
 uint256 CCoinsViewDB::GetBestBlock() const {
+    {
+        LOCK(m_write_mutex);
+        if (m_pending_write) return m_pending_write->best_block;
+    }
+    return ReadBestBlock();
+}
+
+uint256 CCoinsViewDB::ReadBestBlock() const {
     uint256 hashBestChain;
     if (!m_db->Read(DB_BEST_BLOCK, hashBestChain))
         return uint256();
@@ -104,6 +158,12 @@ uint256 CCoinsViewDB::GetBestBlock() const {
 }
 
 std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
+    // Together with the coins not written yet, the view is consistent.
+    if (WITH_LOCK(m_write_mutex, return m_pending_write != nullptr)) return {};
+    return ReadHeadBlocks();
+}
+
+std::vector<uint256> CCoinsViewDB::ReadHeadBlocks() const {
     std::vector<uint256> vhashHeadBlocks;
     if (!m_db->Read(DB_HEAD_BLOCKS, vhashHeadBlocks)) {
         return std::vector<uint256>();
@@ -111,7 +171,90 @@ std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
     return vhashHeadBlocks;
 }
 
-bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool erase) {
+    if (!m_write_thread.joinable()) return WriteCoins(mapCoins, hashBlock, erase);
+
+    assert(!hashBlock.IsNull());
+    // The next write builds on the one in flight, so wait for that first.
+    if (!WaitForWrite()) return false;
+    auto pending{std::make_unique<PendingWrite>()};
+    pending->best_block = hashBlock;
+    size_t coins_usage{0};
+    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end(); it = erase ? mapCoins.erase(it) : std::next(it)) {
+        if (!(it->second.flags & CCoinsCacheEntry::DIRTY)) continue;
+        CCoinsCacheEntry& entry{pending->coins.try_emplace(it->first).first->second};
+        entry.coin = erase ? std::move(it->second.coin) : it->second.coin;
+        entry.flags = CCoinsCacheEntry::DIRTY;
+        coins_usage += entry.coin.DynamicMemoryUsage();
+    }
+    m_pending_usage = memusage::DynamicUsage(pending->coins) + coins_usage;
+    WITH_LOCK(m_write_mutex, m_pending_write = std::move(pending));
+    m_write_cv.notify_all();
+    return true;
+}
+
+bool CCoinsViewDB::WaitForWrite() const
+{
+    WAIT_LOCK(m_write_mutex, lock);
+    m_write_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex) { return !m_pending_write || m_write_failed; });
+    return !m_write_failed;
+}
+
+bool CCoinsViewDB::WriteFailed() const
+{
+    return WITH_LOCK(m_write_mutex, return m_write_failed);
+}
+
+bool CCoinsViewDB::WriteInFlight() const
+{
+    LOCK(m_write_mutex);
+    return m_pending_write && !m_write_failed;
+}
+
+void CCoinsViewDB::PauseWrites(bool paused)
+{
+    WITH_LOCK(m_write_mutex, m_writes_paused = paused);
+    m_write_cv.notify_all();
+}
+
+void CCoinsViewDB::ThreadWrite()
+{
+    SetSyscallSandboxPolicy(SyscallSandboxPolicy::VALIDATION_FILE_FLUSH);
+    while (true) {
+        PendingWrite* pending;
+        {
+            WAIT_LOCK(m_write_mutex, lock);
+            m_write_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex) { return m_stop || (m_pending_write && !m_write_failed && !m_writes_paused); });
+            // The write in flight is still finished when stopping.
+            if (!m_pending_write || m_write_failed) return;
+            // Only this thread resets m_pending_write, and lookups only read the coins.
+            pending = m_pending_write.get();
+        }
+        const auto start{SteadyClock::now()};
+        bool ok;
+        try {
+            ok = WriteCoins(pending->coins, pending->best_block, /*erase=*/false);
+        } catch (const std::exception& e) {
+            LogPrintf("Error writing to the coin database: %s\n", e.what());
+            ok = false;
+        }
+        LogPrint(BCLog::BENCH, "Wrote %u coins to the coin database in the background in %.2fms\n",
+                 pending->coins.size(), Ticks<MillisecondsDouble>(SteadyClock::now() - start));
+        {
+            LOCK(m_write_mutex);
+            if (ok) {
+                m_pending_write.reset();
+                m_pending_usage = 0;
+            } else {
+                // Keep answering lookups from the coins that did not make it.
+                m_write_failed = true;
+            }
+        }
+        m_write_cv.notify_all();
+    }
+}
+
+bool CCoinsViewDB::WriteCoins(CCoinsMap &mapCoins, const uint256 &hashBlock, bool erase) {
     CDBBatch batch(*m_db);
     size_t count = 0;
     size_t changed = 0;
@@ -119,10 +262,10 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     int crash_simulate = gArgs.GetIntArg("-dbcrashratio", 0);
     assert(!hashBlock.IsNull());
 
-    uint256 old_tip = GetBestBlock();
+    uint256 old_tip = ReadBestBlock();
     if (old_tip.IsNull()) {
         // We may be in the middle of replaying.
-        std::vector<uint256> old_heads = GetHeadBlocks();
+        std::vector<uint256> old_heads = ReadHeadBlocks();
         if (old_heads.size() == 2) {
             assert(old_heads[0] == hashBlock);
             old_tip = old_heads[1];
@@ -146,8 +289,7 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
             changed++;
         }
         count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
+        it = erase ? mapCoins.erase(it) : std::next(it);
         if (batch.SizeEstimate() > batch_size) {
             LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
             m_db->WriteBatch(batch);
@@ -177,7 +319,24 @@ size_t CCoinsViewDB::EstimateSize() const
     return m_db->EstimateSize(DB_COIN, uint8_t(DB_COIN + 1));
 }
 
+std::optional<BlockIndexPoWCheck> BlockIndexPoWCheckFromString(const std::string& str)
+{
+    if (str == "none") return BlockIndexPoWCheck::NONE;
+    if (str == "sample") return BlockIndexPoWCheck::SAMPLE;
+    if (str == "full") return BlockIndexPoWCheck::FULL;
+    return std::nullopt;
+}
+
 CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(gArgs.GetDataDirNet() / "blocks" / "index", nCacheSize, fMemory, fWipe) {
+    if (!Read(DB_POW_CHECKSUM_KEY, m_pow_checksum_key)) {
+        m_pow_checksum_key = {GetRand<uint64_t>(), GetRand<uint64_t>()};
+        Write(DB_POW_CHECKSUM_KEY, m_pow_checksum_key);
+    }
+}
+
+uint64_t CBlockTreeDB::PoWChecksum(const uint256& hash) const
+{
+    return SipHashUint256(m_pow_checksum_key.first, m_pow_checksum_key.second, hash);
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
@@ -224,6 +383,8 @@ private:
 
 std::unique_ptr<CCoinsViewCursor> CCoinsViewDB::Cursor() const
 {
+    // The cursor iterates over the database only.
+    WaitForWrite();
     auto i = std::make_unique<CCoinsViewDBCursor>(
         const_cast<CDBWrapper&>(*m_db).NewIterator(), GetBestBlock());
     /* It seems that there are no "const iterators" for LevelDB.  Since we
@@ -280,6 +441,9 @@ bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockF
     batch.Write(DB_LAST_BLOCK, nLastFile);
     for (std::vector<const CBlockIndex*>::const_iterator it=blockinfo.begin(); it != blockinfo.end(); it++) {
         batch.Write(std::make_pair(DB_BLOCK_INDEX, (*it)->GetBlockHash()), CDiskBlockIndex(*it));
+        // Every entry in the in-memory index has had its proof-of-work checked
+        // (on acceptance or on load), so it can be vouched for here.
+        batch.Write(std::make_pair(DB_POW_CHECKSUM, (*it)->GetBlockHash()), PoWChecksum((*it)->GetBlockHash()));
     }
     return WriteBatch(batch, true);
 }
@@ -296,11 +460,85 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
     return true;
 }
 
-bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
+bool CBlockTreeDB::WriteIndexSnapshotId(int nLastFile, const uint256& id) {
+    // Kept in the last block file record, which every WriteBatchSync()
+    // overwrites, including that of versions that do not know about the
+    // snapshot. These ignore the trailing id when reading the record.
+    return Write(DB_LAST_BLOCK, std::make_pair(nLastFile, id), /*fSync=*/true);
+}
+
+bool CBlockTreeDB::ReadIndexSnapshotId(uint256& id) {
+    std::pair<int, uint256> last_block;
+    if (!Read(DB_LAST_BLOCK, last_block)) return false;
+    id = last_block.second;
+    return true;
+}
+
+bool CBlockTreeDB::EraseIndexSnapshotId() {
+    int nFile;
+    if (!ReadLastBlockFile(nFile)) return false;
+    return Write(DB_LAST_BLOCK, nFile, /*fSync=*/true);
+}
+
+bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex,
+                                      BlockIndexPoWCheck pow_check, std::vector<CBlockIndex*>& missing_checksum,
+                                      CCheckQueue<CPoWCheck>* pow_queue)
 {
     AssertLockHeld(::cs_main);
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
     pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, uint256()));
+    // The checksums are keyed by block hash too, so they are read in step
+    // with the entries from a second cursor.
+    std::unique_ptr<CDBIterator> checksum_cursor(NewIterator());
+    checksum_cursor->Seek(std::make_pair(DB_POW_CHECKSUM, uint256()));
+    const auto read_checksum{[&](const uint256& hash) -> std::optional<uint64_t> {
+        std::pair<uint8_t, uint256> key;
+        while (checksum_cursor->Valid() && checksum_cursor->GetKey(key) && key.first == DB_POW_CHECKSUM) {
+            if (hash < key.second) break;
+            uint64_t checksum;
+            const bool found{key.second == hash && checksum_cursor->GetValue(checksum)};
+            checksum_cursor->Next();
+            if (found) return checksum;
+        }
+        return std::nullopt;
+    }};
+    FastRandomContext rng;
+
+    // Headers to check are grouped into CPoWChecks of MAX_POW_CHECK_HEADERS so
+    // their hashes can be computed side by side. With a check queue, those are
+    // handed to its workers in batches while this thread keeps reading. The
+    // queue is drained every BLOCK_INDEX_POW_MAX_PENDING headers so the headers
+    // in flight stay bounded. Each check in flight gets a slot to store the hash
+    // of a failing header in, so the failing entry can be reported.
+    CCheckQueueControl<CPoWCheck> control(pow_queue);
+    std::vector<CPoWCheck> pow_checks;
+    std::vector<CBlockHeader> pow_headers;
+    std::deque<uint256> failed_hashes;
+    size_t pending{0};
+    const auto check_headers = [&]() {
+        if (pow_headers.empty()) return true;
+        pending += pow_headers.size();
+        CPoWCheck check{std::move(pow_headers), consensusParams, &failed_hashes.emplace_back()};
+        pow_headers.clear();
+        if (!pow_queue) return check();
+        pow_checks.emplace_back();
+        check.swap(pow_checks.back());
+        if (pow_checks.size() * MAX_POW_CHECK_HEADERS >= BLOCK_INDEX_POW_BATCH_SIZE) {
+            control.Add(pow_checks);
+            pow_checks.clear();
+        }
+        if (pending >= BLOCK_INDEX_POW_MAX_PENDING) {
+            pending = 0;
+            if (!control.Wait()) return false;
+            failed_hashes.clear();
+        }
+        return true;
+    };
+    const auto pow_error = [&]() {
+        const auto failed{std::find_if(failed_hashes.begin(), failed_hashes.end(), [](const uint256& h) { return !h.IsNull(); })};
+        if (failed == failed_hashes.end()) return error("%s: CheckProofOfWork failed for a block index entry", __func__);
+        return error("%s: CheckProofOfWork failed: %s", __func__, insertBlockIndex(*failed)->ToString());
+    };
 
     // Load m_block_index
     while (pcursor->Valid()) {
@@ -310,7 +548,8 @@ bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams,
             CDiskBlockIndex diskindex;
             if (pcursor->GetValue(diskindex)) {
                 // Construct block index object
-                CBlockIndex* pindexNew = insertBlockIndex(diskindex.ConstructBlockHash());
+                const uint256 hash{diskindex.ConstructBlockHash()};
+                CBlockIndex* pindexNew = insertBlockIndex(hash);
                 pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
                 pindexNew->nHeight        = diskindex.nHeight;
                 pindexNew->nFile          = diskindex.nFile;
@@ -324,9 +563,17 @@ bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams,
                 pindexNew->nStatus        = diskindex.nStatus;
                 pindexNew->nTx            = diskindex.nTx;
 
-                if (!CheckProofOfWork(pindexNew->GetBlockPoWHash(), pindexNew->nBits, consensusParams)) {
-                    return error("%s: CheckProofOfWork failed: %s", __func__, pindexNew->ToString());
+                // A matching checksum means we checked this header's proof-of-work
+                // when it was written, so the memory-hard hash can be skipped.
+                const bool checksum_valid{read_checksum(key.second) == PoWChecksum(hash)};
+                if (!checksum_valid || pow_check == BlockIndexPoWCheck::FULL ||
+                    (pow_check == BlockIndexPoWCheck::SAMPLE && rng.randrange(BLOCK_INDEX_POW_SAMPLE_RATE) == 0)) {
+                    pow_headers.push_back(diskindex.ConstructBlockHeader());
+                    if (pow_headers.size() >= MAX_POW_CHECK_HEADERS && !check_headers()) {
+                        return pow_error();
+                    }
                 }
+                if (!checksum_valid) missing_checksum.push_back(pindexNew);
 
                 pcursor->Next();
             } else {
@@ -337,5 +584,13 @@ bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams,
         }
     }
 
+    if (!check_headers()) {
+        return pow_error();
+    }
+    control.Add(pow_checks);
+    if (!control.Wait()) {
+        return pow_error();
+    }
+
     return true;
 }
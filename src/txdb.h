@@ -12,15 +12,21 @@
 #include <sync.h>
 #include <fs.h>
 
+#include <atomic>
+#include <condition_variable>
 #include <memory>
 #include <optional>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
 class CBlockFileInfo;
 class CBlockIndex;
+class CPoWCheck;
 class uint256;
+template <typename T>
+class CCheckQueue;
 namespace Consensus {
 struct Params;
 };
@@ -45,32 +51,101 @@ static const int64_t max_filter_index_cache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
 
-/** CCoinsView backed by the coin database (chainstate/) */
+/** How much header proof-of-work is recomputed when loading the block index (-checkblockindexpow) */
+enum class BlockIndexPoWCheck {
+    NONE,   //!< only entries without a valid PoW checksum
+    SAMPLE, //!< additionally a random sample of one in BLOCK_INDEX_POW_SAMPLE_RATE entries
+    FULL,   //!< every entry
+};
+static constexpr BlockIndexPoWCheck DEFAULT_CHECKBLOCKINDEXPOW{BlockIndexPoWCheck::NONE};
+static constexpr uint64_t BLOCK_INDEX_POW_SAMPLE_RATE{1000};
+//! Number of headers whose PoW checks are handed to the check queue at once while loading the block index
+static constexpr size_t BLOCK_INDEX_POW_BATCH_SIZE{64};
+//! Maximum number of headers with PoW checks in flight while loading the block index
+static constexpr size_t BLOCK_INDEX_POW_MAX_PENDING{16384};
+
+std::optional<BlockIndexPoWCheck> BlockIndexPoWCheckFromString(const std::string& str);
+
+/**
+ * CCoinsView backed by the coin database (chainstate/)
+ *
+ * With write-behind, BatchWrite() only takes the modified coins and leaves
+ * writing them to a background thread, so that the caller need not wait for
+ * the disk. Until the write is committed, lookups are answered from those
+ * coins first. Only one write is in flight at a time; BatchWrite() waits for
+ * the previous one. Its coins count against the coins cache size (see
+ * PendingMemoryUsage()), and a cache that fills up again before it is done is
+ * flushed only once it is, unless the cache outgrows the limit on its own (see
+ * Chainstate::FlushStateToDisk()). A crash in the middle of a write is
+ * recovered from like one during a synchronous write, using the head blocks
+ * marker.
+ */
 class CCoinsViewDB final : public CCoinsView
 {
 protected:
     std::unique_ptr<CDBWrapper> m_db;
     fs::path m_ldb_path;
     bool m_is_memory;
+
+    /** Coins handed to BatchWrite() for the background thread to write. */
+    struct PendingWrite {
+        CCoinsMapMemoryResource resource{};
+        CCoinsMap coins{0, SaltedOutpointHasher{}, CCoinsMap::key_equal{}, &resource};
+        uint256 best_block;
+    };
+
+    mutable Mutex m_write_mutex;
+    mutable std::condition_variable m_write_cv;
+    /** The write in flight, only reset by the background thread once it is committed. */
+    std::unique_ptr<PendingWrite> m_pending_write GUARDED_BY(m_write_mutex);
+    bool m_write_failed GUARDED_BY(m_write_mutex){false};
+    bool m_stop GUARDED_BY(m_write_mutex){false};
+    bool m_writes_paused GUARDED_BY(m_write_mutex){false};
+    /** Memory used by the coins of the write in flight */
+    std::atomic<size_t> m_pending_usage{0};
+    std::thread m_write_thread;
+
+    /** Write the dirty entries of mapCoins to the database in batches. */
+    bool WriteCoins(CCoinsMap& mapCoins, const uint256& hashBlock, bool erase);
+    /** Best block and head blocks as stored in the database, without any pending write. */
+    uint256 ReadBestBlock() const;
+    std::vector<uint256> ReadHeadBlocks() const;
+    void ThreadWrite() EXCLUSIVE_LOCKS_REQUIRED(!m_write_mutex);
+
 public:
     /**
      * @param[in] ldb_path    Location in the filesystem where leveldb data will be stored.
+     * @param[in] write_behind Write the coins passed to BatchWrite() on a background thread.
      */
-    explicit CCoinsViewDB(fs::path ldb_path, size_t nCacheSize, bool fMemory, bool fWipe);
+    explicit CCoinsViewDB(fs::path ldb_path, size_t nCacheSize, bool fMemory, bool fWipe, bool write_behind = false);
+    /** Finishes the write in flight. */
+    ~CCoinsViewDB() override;
+
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const override EXCLUSIVE_LOCKS_REQUIRED(!m_write_mutex);
+    bool HaveCoin(const COutPoint &outpoint) const override EXCLUSIVE_LOCKS_REQUIRED(!m_write_mutex);
+    uint256 GetBestBlock() const override EXCLUSIVE_LOCKS_REQUIRED(!m_write_mutex);
+    std::vector<uint256> GetHeadBlocks() const override EXCLUSIVE_LOCKS_REQUIRED(!m_write_mutex);
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool erase = true) override EXCLUSIVE_LOCKS_REQUIRED(!m_write_mutex);
+    std::unique_ptr<CCoinsViewCursor> Cursor() const override EXCLUSIVE_LOCKS_REQUIRED(!m_write_mutex);
 
-    bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
-    bool HaveCoin(const COutPoint &outpoint) const override;
-    uint256 GetBestBlock() const override;
-    std::vector<uint256> GetHeadBlocks() const override;
-    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
-    std::unique_ptr<CCoinsViewCursor> Cursor() const override;
+    //! Wait for the write in flight, if any. Returns false if a write has failed.
+    bool WaitForWrite() const EXCLUSIVE_LOCKS_REQUIRED(!m_write_mutex);
+    //! Whether a write left to the background thread has failed.
+    bool WriteFailed() const EXCLUSIVE_LOCKS_REQUIRED(!m_write_mutex);
+    //! Whether a write is left to the background thread and not committed yet.
+    bool WriteInFlight() const EXCLUSIVE_LOCKS_REQUIRED(!m_write_mutex);
+    //! Keep the background thread from starting the writes handed to it, for tests.
+    //! Anything waiting for a write while paused waits until it is resumed.
+    void PauseWrites(bool paused) EXCLUSIVE_LOCKS_REQUIRED(!m_write_mutex);
+    //! Memory used by the coins of the write in flight, if any.
+    size_t PendingMemoryUsage() const { return m_pending_usage; }
 
     //! Whether an unsupported database format is used.
     bool NeedsUpgrade();
     size_t EstimateSize() const override;
 
     //! Dynamically alter the underlying leveldb cache size.
-    void ResizeCache(size_t new_cache_size) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    void ResizeCache(size_t new_cache_size) EXCLUSIVE_LOCKS_REQUIRED(cs_main, !m_write_mutex);
 
     //! @returns filesystem path to on-disk storage or std::nullopt if in memory.
     std::optional<fs::path> StoragePath() { return m_db->StoragePath(); }
@@ -79,6 +154,14 @@ public:
 /** Access to the block database (blocks/index/) */
 class CBlockTreeDB : public CDBWrapper
 {
+private:
+    //! SipHash key for the PoW checksums of block index entries, persisted in the database.
+    //! The checksums are kept under their own keys, so entries written by any
+    //! version are read the same way.
+    std::pair<uint64_t, uint64_t> m_pow_checksum_key;
+
+    uint64_t PoWChecksum(const uint256& hash) const;
+
 public:
     explicit CBlockTreeDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 
@@ -89,7 +172,23 @@ public:
     void ReadReindexing(bool &fReindexing);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
-    bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
+    //! Id of the block index snapshot file that matches the database contents, if any.
+    //! Any later WriteBatchSync() clears it.
+    bool WriteIndexSnapshotId(int nLastFile, const uint256& id);
+    bool ReadIndexSnapshotId(uint256& id);
+    bool EraseIndexSnapshotId();
+    /**
+     * Load all block index entries. Header proof-of-work is only recomputed for
+     * entries whose PoW checksum is missing or wrong, and additionally for the
+     * entries selected by pow_check. Those without a valid checksum are returned
+     * in missing_checksum so they can be rewritten.
+     *
+     * If pow_queue is given, the PoW checks are run in batches on its worker
+     * threads while this thread keeps reading the database.
+     */
+    bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex,
+                            BlockIndexPoWCheck pow_check, std::vector<CBlockIndex*>& missing_checksum,
+                            CCheckQueue<CPoWCheck>* pow_queue = nullptr)
         EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
 };
 
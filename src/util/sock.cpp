@@ -11,6 +11,8 @@
 #include <util/threadinterrupt.h>
 #include <util/time.h>
 
+#include <algorithm>
+#include <array>
 #include <memory>
 #include <stdexcept>
 #include <string>
@@ -24,6 +26,14 @@
 #include <poll.h>
 #endif
 
+#ifdef __linux__
+#include <sys/sendfile.h>
+#elif defined(WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
 static inline bool IOErrorIsPermanent(int err)
 {
     return err != WSAEAGAIN && err != WSAEINTR && err != WSAEWOULDBLOCK && err != WSAEINPROGRESS;
@@ -56,6 +66,28 @@ ssize_t Sock::Send(const void* data, size_t len, int flags) const
     return send(m_socket, static_cast<const char*>(data), len, flags);
 }
 
+ssize_t Sock::SendFile(int fd, int64_t offset, size_t len) const
+{
+#ifdef __linux__
+    off_t off = offset;
+    const ssize_t sent = sendfile(m_socket, fd, &off, len);
+#else
+    std::array<char, 16384> buf;
+#ifdef WIN32
+    const ssize_t read = _lseeki64(fd, offset, SEEK_SET) == offset ? _read(fd, buf.data(), std::min(len, buf.size())) : -1;
+#else
+    const ssize_t read = pread(fd, buf.data(), std::min(len, buf.size()), offset);
+#endif
+    if (read < 0) return -1;
+    const ssize_t sent = read > 0 ? Send(buf.data(), read, MSG_NOSIGNAL | MSG_DONTWAIT) : 0;
+#endif
+    if (sent == 0 && len > 0) {
+        errno = EIO;
+        return -1;
+    }
+    return sent;
+}
+
 ssize_t Sock::Recv(void* buf, size_t len, int flags) const
 {
     return recv(m_socket, static_cast<char*>(buf), len, flags);
@@ -74,6 +74,14 @@ public:
      */
     [[nodiscard]] virtual ssize_t Send(const void* data, size_t len, int flags) const;
 
+    /**
+     * sendfile(2) wrapper. Send up to len bytes of the file fd starting at offset, without
+     * copying them through user space. Where sendfile(2) is not available the bytes go
+     * through a small buffer and Send(), so fewer than len may be sent. Running into the end
+     * of the file is an error. Returns the number of bytes sent or -1 like Send().
+     */
+    [[nodiscard]] virtual ssize_t SendFile(int fd, int64_t offset, size_t len) const;
+
     /**
      * recv(2) wrapper. Equivalent to `recv(this->Get(), buf, len, flags);`. Code that uses this
      * wrapper can be unit tested if this method is overridden by a mock Sock implementation.
@@ -895,7 +895,13 @@ void SetSyscallSandboxPolicy(SyscallSandboxPolicy syscall_policy)
     case SyscallSandboxPolicy::TX_INDEX: // Thread: txindex
         seccomp_policy_builder.AllowFileSystem();
         break;
-    case SyscallSandboxPolicy::VALIDATION_SCRIPT_CHECK: // Thread: scriptch.<N>
+    case SyscallSandboxPolicy::VALIDATION_COIN_FETCH: // Thread: coinfetch.<N>
+        seccomp_policy_builder.AllowFileSystem();
+        break;
+    case SyscallSandboxPolicy::VALIDATION_FILE_FLUSH: // Threads: blkflush, coinsflush
+        seccomp_policy_builder.AllowFileSystem();
+        break;
+    case SyscallSandboxPolicy::VALIDATION_SCRIPT_CHECK: // Thread: scriptch.<N>, powch.<N>
         break;
     case SyscallSandboxPolicy::SHUTOFF: // Thread: main thread (state: shutoff)
         seccomp_policy_builder.AllowFileSystem();
@@ -22,6 +22,8 @@ enum class SyscallSandboxPolicy {
     SCHEDULER,
     TOR_CONTROL,
     TX_INDEX,
+    VALIDATION_COIN_FETCH,
+    VALIDATION_FILE_FLUSH,
     VALIDATION_SCRIPT_CHECK,
 
     // 3. Shutdown
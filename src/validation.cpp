@@ -32,6 +32,7 @@
 #include <policy/rbf.h>
 #include <policy/settings.h>
 #include <pow.h>
+#include <powcache.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <random.h>
@@ -50,6 +51,7 @@
 #include <util/moneystr.h>
 #include <util/rbf.h>
 #include <util/strencodings.h>
+#include <util/syscall_sandbox.h>
 #include <util/system.h>
 #include <util/time.h>
 #include <util/trace.h>
@@ -64,6 +66,7 @@
 #include <numeric>
 #include <optional>
 #include <string>
+#include <unordered_set>
 #include <utility>
 
 using kernel::CCoinsStats;
@@ -1526,9 +1529,10 @@ CoinsViews::CoinsViews(
     fs::path ldb_name,
     size_t cache_size_bytes,
     bool in_memory,
-    bool should_wipe) : m_dbview(
-                            gArgs.GetDataDirNet() / ldb_name, cache_size_bytes, in_memory, should_wipe),
-                        m_catcherview(&m_dbview) {}
+    bool should_wipe,
+    bool write_behind) : m_dbview(
+                             gArgs.GetDataDirNet() / ldb_name, cache_size_bytes, in_memory, should_wipe, write_behind),
+                         m_catcherview(&m_dbview) {}
 
 void CoinsViews::InitCache()
 {
@@ -1557,7 +1561,7 @@ void Chainstate::InitCoinsDB(
     }
 
     m_coins_views = std::make_unique<CoinsViews>(
-        leveldb_name, cache_size_bytes, in_memory, should_wipe);
+        leveldb_name, cache_size_bytes, in_memory, should_wipe, m_chainman.m_options.coinsdb_write_behind);
 }
 
 void Chainstate::InitCoinsCache(size_t cache_size_bytes)
@@ -1935,16 +1939,151 @@ DisconnectResult Chainstate::DisconnectBlock(const CBlock& block, const CBlockIn
     return fClean ? DISCONNECT_OK : DISCONNECT_UNCLEAN;
 }
 
+/**
+ * Closure deserializing a block read by LoadExternalBlockFile() and running the
+ * context-free CheckBlock() on it, so that this can be done for many blocks at
+ * once on a CCheckQueue. It always succeeds: a block that does not deserialize
+ * is left null, and one failing CheckBlock() is still handed back for
+ * AcceptBlock() to reject and mark invalid.
+ */
+class CBlockLoadCheck
+{
+private:
+    Span<const unsigned char> m_data;
+    std::shared_ptr<CBlock>* m_block{nullptr};
+    const Consensus::Params* m_params{nullptr};
+
+public:
+    CBlockLoadCheck() = default;
+    CBlockLoadCheck(Span<const unsigned char> data, std::shared_ptr<CBlock>& block, const Consensus::Params& params)
+        : m_data{data}, m_block{&block}, m_params{&params} {}
+
+    bool operator()()
+    {
+        auto block{std::make_shared<CBlock>()};
+        try {
+            SpanReader{SER_DISK, CLIENT_VERSION, m_data} >> *block;
+        } catch (const std::exception&) {
+            return true;
+        }
+        BlockValidationState state;
+        CheckBlock(*block, state, *m_params);
+        *m_block = std::move(block);
+        return true;
+    }
+
+    void swap(CBlockLoadCheck& check) noexcept
+    {
+        std::swap(m_data, check.m_data);
+        std::swap(m_block, check.m_block);
+        std::swap(m_params, check.m_params);
+    }
+};
+
+/**
+ * Closure reading one coin from the coins database for PrefetchBlockInputs(),
+ * so that the reads for a block can be spread over a CCheckQueue. It always
+ * succeeds: a coin that is missing, or fails to read, is left for the lookup
+ * in ConnectBlock() to deal with.
+ */
+class CCoinFetch
+{
+private:
+    const CCoinsView* m_db{nullptr};
+    const COutPoint* m_outpoint{nullptr};
+    std::optional<Coin>* m_coin{nullptr};
+
+public:
+    CCoinFetch() = default;
+    CCoinFetch(const CCoinsView& db, const COutPoint& outpoint, std::optional<Coin>& coin)
+        : m_db{&db}, m_outpoint{&outpoint}, m_coin{&coin} {}
+
+    bool operator()()
+    {
+        Coin coin;
+        try {
+            if (m_db->GetCoin(*m_outpoint, coin)) *m_coin = std::move(coin);
+        } catch (const std::exception&) {
+            // Looked up again, and reported, in ConnectBlock().
+        }
+        return true;
+    }
+
+    void swap(CCoinFetch& check) noexcept
+    {
+        std::swap(m_db, check.m_db);
+        std::swap(m_outpoint, check.m_outpoint);
+        std::swap(m_coin, check.m_coin);
+    }
+};
+
 static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+// Each header PoW check runs a memory-hard hash, so hand them out in small batches.
+static CCheckQueue<CPoWCheck> powcheckqueue(8);
+// Coin reads mostly wait for the disk, so keep the batches small to have many in flight.
+static CCheckQueue<CCoinFetch> coinfetchqueue(16);
+// LoadExternalBlockFile() takes cs_main while its checks run, so they cannot
+// share powcheckqueue, whose control is taken with cs_main held.
+static CCheckQueue<CBlockLoadCheck> blockloadcheckqueue(8);
 
 void StartScriptCheckWorkerThreads(int threads_num)
 {
     scriptcheckqueue.StartWorkerThreads(threads_num);
+    powcheckqueue.StartWorkerThreads(threads_num, "powch");
+    blockloadcheckqueue.StartWorkerThreads(threads_num, "blkload");
+}
+
+void StartCoinFetchWorkerThreads(int threads_num)
+{
+    // The coin reads go to the coins database files.
+    coinfetchqueue.StartWorkerThreads(threads_num, "coinfetch", SyscallSandboxPolicy::VALIDATION_COIN_FETCH);
 }
 
 void StopScriptCheckWorkerThreads()
 {
     scriptcheckqueue.StopWorkerThreads();
+    powcheckqueue.StopWorkerThreads();
+    coinfetchqueue.StopWorkerThreads();
+    blockloadcheckqueue.StopWorkerThreads();
+}
+
+size_t PrefetchBlockInputs(const CBlock& block, CCoinsViewCache& cache, const CCoinsView& db)
+{
+    if (!coinfetchqueue.HasThreads()) return 0;
+
+    std::unordered_set<uint256, SaltedTxidHasher> block_txids;
+    for (const auto& tx : block.vtx) {
+        block_txids.insert(tx->GetHash());
+    }
+    std::vector<COutPoint> outpoints;
+    for (const auto& tx : block.vtx) {
+        if (tx->IsCoinBase()) continue;
+        for (const CTxIn& txin : tx->vin) {
+            if (block_txids.count(txin.prevout.hash) || cache.HaveCoinInCache(txin.prevout)) continue;
+            outpoints.push_back(txin.prevout);
+        }
+    }
+    if (outpoints.empty()) return 0;
+
+    std::vector<std::optional<Coin>> coins(outpoints.size());
+    {
+        std::vector<CCoinFetch> checks;
+        checks.reserve(outpoints.size());
+        for (size_t i = 0; i < outpoints.size(); ++i) {
+            checks.emplace_back(db, outpoints[i], coins[i]);
+        }
+        CCheckQueueControl<CCoinFetch> control(&coinfetchqueue);
+        control.Add(checks);
+        control.Wait();
+    }
+
+    size_t fetched{0};
+    for (size_t i = 0; i < outpoints.size(); ++i) {
+        if (!coins[i]) continue;
+        cache.AddFetchedCoin(outpoints[i], std::move(*coins[i]));
+        ++fetched;
+    }
+    return fetched;
 }
 
 /**
@@ -2378,11 +2517,16 @@ CoinsCacheSizeState Chainstate::GetCoinsCacheSizeState()
 
 CoinsCacheSizeState Chainstate::GetCoinsCacheSizeState(
     size_t max_coins_cache_size_bytes,
-    size_t max_mempool_size_bytes)
+    size_t max_mempool_size_bytes,
+    bool count_pending_write)
 {
     AssertLockHeld(::cs_main);
     const int64_t nMempoolUsage = m_mempool ? m_mempool->DynamicMemoryUsage() : 0;
     int64_t cacheSize = CoinsTip().DynamicMemoryUsage();
+    if (count_pending_write) {
+        // Coins still being written to the database in the background count too.
+        cacheSize += CoinsDB().PendingMemoryUsage();
+    }
     int64_t nTotalSpace =
         max_coins_cache_size_bytes + std::max<int64_t>(int64_t(max_mempool_size_bytes) - nMempoolUsage, 0);
 
@@ -2418,7 +2562,20 @@ bool Chainstate::FlushStateToDisk(
         bool fFlushForPrune = false;
         bool fDoFullFlush = false;
 
+        if (CoinsDB().WriteFailed()) {
+            return AbortNode(state, "Failed to write to coin database");
+        }
+
         CoinsCacheSizeState cache_state = GetCoinsCacheSizeState();
+        // Right after a large flush, the coins of the write in flight make the
+        // cache look full. Flushing again would only wait for that write while
+        // holding cs_main, so hold off until it is done, unless the cache has
+        // outgrown the limit on its own.
+        if (cache_state != CoinsCacheSizeState::OK && CoinsDB().WriteInFlight()) {
+            const CoinsCacheSizeState own_state{GetCoinsCacheSizeState(
+                m_coinstip_cache_size_bytes, m_mempool ? m_mempool->m_max_size_bytes : 0, /*count_pending_write=*/false)};
+            cache_state = own_state == CoinsCacheSizeState::CRITICAL ? own_state : CoinsCacheSizeState::OK;
+        }
         LOCK(m_blockman.cs_LastBlockFile);
         if (fPruneMode && (m_blockman.m_check_for_pruning || nManualPruneHeight > 0) && !fReindex) {
             // make sure we don't prune above any of the prune locks bestblocks
@@ -2485,8 +2642,12 @@ bool Chainstate::FlushStateToDisk(
             {
                 LOG_TIME_MILLIS_WITH_CATEGORY("write block and undo data to disk", BCLog::BENCH);
 
-                // First make sure all block and undo data is flushed to disk.
+                // First make sure all block and undo data is flushed to disk, including
+                // that of the files still being flushed in the background.
                 m_blockman.FlushBlockFile();
+                if (!m_blockman.m_flusher.Wait()) {
+                    return state.Error("Failed to flush block files to disk");
+                }
             }
 
             // Then update all block file information (which may refer to block and undo files).
@@ -2519,8 +2680,16 @@ bool Chainstate::FlushStateToDisk(
                 return AbortNode(state, "Disk space is too low!", _("Disk space is too low!"));
             }
             // Flush the chainstate (which may refer to block index entries).
-            if (!CoinsTip().Flush())
+            // Only empty the cache when asked to or when it is running out of
+            // space; otherwise keep it warm for the blocks that follow.
+            const bool empty_cache{(mode == FlushStateMode::ALWAYS) || fCacheLarge || fCacheCritical};
+            if (empty_cache ? !CoinsTip().Flush() : !CoinsTip().Sync())
+                return AbortNode(state, "Failed to write to coin database");
+            // The coin database may write in the background. On shutdown, and
+            // when block files were just pruned, wait for the coins to be on disk.
+            if ((mode == FlushStateMode::ALWAYS || fFlushForPrune) && !CoinsDB().WaitForWrite()) {
                 return AbortNode(state, "Failed to write to coin database");
+            }
             m_last_flush = nNow;
             full_flush_completed = true;
             TRACE5(utxocache, flush,
@@ -2800,6 +2969,9 @@ bool Chainstate::ConnectTip(BlockValidationState& state, CBlockIndex* pindexNew,
              Ticks<SecondsDouble>(time_read_from_disk_total),
              Ticks<MillisecondsDouble>(time_read_from_disk_total) / num_blocks_total);
     {
+        const size_t prefetched{PrefetchBlockInputs(blockConnecting, CoinsTip(), CoinsDB())};
+        LogPrint(BCLog::BENCH, "  - Prefetch inputs: %u coins in %.2fms\n",
+                 prefetched, Ticks<MillisecondsDouble>(SteadyClock::now() - time_2));
         CCoinsViewCache view(&CoinsTip());
         bool rv = ConnectBlock(blockConnecting, state, pindexNew, view);
         GetMainSignals().BlockChecked(blockConnecting, state);
@@ -3417,7 +3589,7 @@ void Chainstate::ReceivedBlockTransactions(const CBlock& block, CBlockIndex* pin
 static bool CheckBlockHeader(const CBlockHeader& block, BlockValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true)
 {
     // Check proof of work matches claimed amount
-    if (fCheckPOW && !CheckProofOfWork(block.GetPoWHash(), block.nBits, consensusParams))
+    if (fCheckPOW && !CheckBlockHeaderProofOfWork(block, consensusParams))
         return state.Invalid(BlockValidationResult::BLOCK_INVALID_HEADER, "high-hash", "proof of work failed");
 
     return true;
@@ -3536,10 +3708,75 @@ std::vector<unsigned char> ChainstateManager::GenerateCoinbaseCommitment(CBlock&
     return commitment;
 }
 
-bool HasValidProofOfWork(const std::vector<CBlockHeader>& headers, const Consensus::Params& consensusParams)
+size_t FindInvalidProofOfWork(const std::vector<CBlockHeader>& headers, const Consensus::Params& consensusParams)
+{
+    // A single check is not worth handing to the worker threads.
+    const bool parallel{powcheckqueue.HasThreads() && headers.size() > MAX_POW_CHECK_HEADERS};
+    std::deque<uint256> failed_hashes;
+    {
+        CCheckQueueControl<CPoWCheck> control(parallel ? &powcheckqueue : nullptr);
+        std::vector<CPoWCheck> checks;
+        for (auto it = headers.begin(); it != headers.end();) {
+            const auto end{it + std::min<size_t>(headers.end() - it, MAX_POW_CHECK_HEADERS)};
+            CPoWCheck check{std::vector<CBlockHeader>(it, end), consensusParams, &failed_hashes.emplace_back()};
+            it = end;
+            if (!parallel) {
+                if (!check()) break;
+                continue;
+            }
+            checks.emplace_back();
+            check.swap(checks.back());
+        }
+        control.Add(checks);
+        if (control.Wait() && std::all_of(failed_hashes.begin(), failed_hashes.end(), [](const uint256& h) { return h.IsNull(); })) {
+            return headers.size();
+        }
+    }
+
+    // The queue stops at the first failure it sees, which need not be the first
+    // failing header, and may leave earlier headers unchecked. Check those again:
+    // the ones that passed are in the PoW cache, so only the others are hashed.
+    const auto failed{std::find_if(headers.begin(), headers.end(), [&](const CBlockHeader& header) {
+        return std::find(failed_hashes.begin(), failed_hashes.end(), header.GetHash()) != failed_hashes.end();
+    })};
+    // The queue was stopped before anything was found to fail.
+    if (failed == headers.end()) return 0;
+    const size_t first_invalid(failed - headers.begin());
+    const std::vector<CBlockHeader> prefix(headers.begin(), failed);
+    return std::min(first_invalid, FindInvalidProofOfWork(prefix, consensusParams));
+}
+
+bool PreCheckHeaders(const std::vector<CBlockHeader>& headers, const CBlockIndex* prev, const Consensus::Params& consensusParams,
+                     NodeClock::time_point now, BlockValidationState& state)
 {
-    return std::all_of(headers.cbegin(), headers.cend(),
-            [&](const auto& header) { return CheckProofOfWork(header.GetHash(), header.nBits, consensusParams);});
+    if (prev && !PermittedDifficultyTransitions(consensusParams, *prev, headers)) {
+        return state.Invalid(BlockValidationResult::BLOCK_INVALID_HEADER, "bad-diffbits", "impossible difficulty transition");
+    }
+
+    // The timestamps of enough of prev's ancestors for a median time past,
+    // oldest first, followed by those of the headers. Without prev the
+    // median is only known from the 11th header on.
+    std::vector<int64_t> times;
+    for (const CBlockIndex* pindex = prev; pindex && times.size() < CBlockIndex::nMedianTimeSpan; pindex = pindex->pprev) {
+        times.push_back(pindex->GetBlockTime());
+    }
+    std::reverse(times.begin(), times.end());
+    const size_t first{times.size()};
+    for (const CBlockHeader& header : headers) times.push_back(header.GetBlockTime());
+
+    for (size_t pos = first; pos < times.size(); ++pos) {
+        if (times[pos] > TicksSinceEpoch<std::chrono::seconds>(now) + MAX_FUTURE_BLOCK_TIME) {
+            return state.Invalid(BlockValidationResult::BLOCK_TIME_FUTURE, "time-too-new", "block timestamp too far in the future");
+        }
+        const size_t span{std::min<size_t>(pos, CBlockIndex::nMedianTimeSpan)};
+        if (span == 0 || (!prev && span < CBlockIndex::nMedianTimeSpan)) continue;
+        std::vector<int64_t> median(times.begin() + pos - span, times.begin() + pos);
+        std::sort(median.begin(), median.end());
+        if (times[pos] <= median[span / 2]) {
+            return state.Invalid(BlockValidationResult::BLOCK_INVALID_HEADER, "time-too-old", "block's timestamp is too early");
+        }
+    }
+    return true;
 }
 
 arith_uint256 CalculateHeadersWork(const std::vector<CBlockHeader>& headers)
@@ -3693,7 +3930,7 @@ static bool ContextualCheckBlock(const CBlock& block, BlockValidationState& stat
     return true;
 }
 
-bool ChainstateManager::AcceptBlockHeader(const CBlockHeader& block, BlockValidationState& state, CBlockIndex** ppindex, bool min_pow_checked)
+bool ChainstateManager::AcceptBlockHeader(const CBlockHeader& block, BlockValidationState& state, CBlockIndex** ppindex, bool min_pow_checked, bool check_pow)
 {
     AssertLockHeld(cs_main);
 
@@ -3713,7 +3950,7 @@ bool ChainstateManager::AcceptBlockHeader(const CBlockHeader& block, BlockValida
             return true;
         }
 
-        if (!CheckBlockHeader(block, state, GetConsensus())) {
+        if (!CheckBlockHeader(block, state, GetConsensus(), check_pow)) {
             LogPrint(BCLog::VALIDATION, "%s: Consensus::CheckBlockHeader: %s, %s\n", __func__, hash.ToString(), state.ToString());
             return false;
         }
@@ -3792,15 +4029,43 @@ bool ChainstateManager::AcceptBlockHeader(const CBlockHeader& block, BlockValida
     return true;
 }
 
+size_t ChainstateManager::CheckNewHeadersPoW(const std::vector<CBlockHeader>& headers)
+{
+    AssertLockNotHeld(cs_main);
+
+    std::vector<CBlockHeader> unknown;
+    std::vector<size_t> positions;
+    {
+        LOCK(cs_main);
+        for (size_t i = 0; i < headers.size(); ++i) {
+            if (m_blockman.LookupBlockIndex(headers[i].GetHash())) continue;
+            unknown.push_back(headers[i]);
+            positions.push_back(i);
+        }
+    }
+    const size_t first_invalid{FindInvalidProofOfWork(unknown, GetConsensus())};
+    return first_invalid < unknown.size() ? positions[first_invalid] : headers.size();
+}
+
 // Exposed wrapper for AcceptBlockHeader
 bool ChainstateManager::ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, bool min_pow_checked, BlockValidationState& state, const CBlockIndex** ppindex)
 {
     AssertLockNotHeld(cs_main);
+
+    // Hash the new headers before taking cs_main. The headers before the first
+    // one that fails are still accepted, and that one is rejected as it would
+    // have been by AcceptBlockHeader, without hashing anything again.
+    const size_t first_invalid{CheckNewHeadersPoW(headers)};
     {
         LOCK(cs_main);
-        for (const CBlockHeader& header : headers) {
+        for (size_t i = 0; i < headers.size(); ++i) {
+            if (i == first_invalid) {
+                state.Invalid(BlockValidationResult::BLOCK_INVALID_HEADER, "high-hash", "proof of work failed");
+                LogPrint(BCLog::VALIDATION, "%s: Consensus::CheckBlockHeader: %s, %s\n", __func__, headers[i].GetHash().ToString(), state.ToString());
+                return false;
+            }
             CBlockIndex *pindex = nullptr; // Use a temp pindex instead of ppindex to avoid a const_cast
-            bool accepted{AcceptBlockHeader(header, state, &pindex, min_pow_checked)};
+            bool accepted{AcceptBlockHeader(headers[i], state, &pindex, min_pow_checked, /*check_pow=*/false)};
             ActiveChainstate().CheckBlockIndex();
 
             if (!accepted) {
@@ -4120,8 +4385,9 @@ bool CVerifyDB::VerifyDB(
             break;
         }
         CBlock block;
-        // check level 0: read from disk
-        if (!ReadBlockFromDisk(block, pindex, consensus_params)) {
+        // check level 0: read from disk (and verify the header's proof of
+        // work, which CheckBlock takes care of at higher levels)
+        if (!ReadBlockFromDisk(block, pindex, consensus_params, /*check_pow=*/nCheckLevel < 1)) {
             return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
         }
         // check level 1: verify block validity
@@ -4311,7 +4577,7 @@ bool ChainstateManager::LoadBlockIndex()
     // Load block index from databases
     bool needs_init = fReindex;
     if (!fReindex) {
-        bool ret = m_blockman.LoadBlockIndexDB(GetConsensus());
+        bool ret = m_blockman.LoadBlockIndexDB(GetConsensus(), powcheckqueue.HasThreads() ? &powcheckqueue : nullptr);
         if (!ret) return false;
 
         std::vector<CBlockIndex*> vSortedByHeight{m_blockman.GetAllBlockIndices()};
@@ -4427,7 +4693,8 @@ bool Chainstate::LoadGenesisBlock()
 void Chainstate::LoadExternalBlockFile(
     FILE* fileIn,
     FlatFilePos* dbp,
-    std::multimap<uint256, FlatFilePos>* blocks_with_unknown_parent)
+    std::multimap<uint256, FlatFilePos>* blocks_with_unknown_parent,
+    uint64_t batch_bytes)
 {
     AssertLockNotHeld(m_chainstate_mutex);
 
@@ -4437,16 +4704,147 @@ void Chainstate::LoadExternalBlockFile(
     const auto start{SteadyClock::now()};
     const CChainParams& params{m_chainman.GetParams()};
 
+    // Blocks to load go through three overlapping stages: this thread scans
+    // the file and reads them out in batches, blockloadcheckqueue's workers
+    // deserialize them and run CheckBlock(), and this thread then accepts
+    // them in file order. While one batch is checked, the batch before it is
+    // accepted and the one after it is read.
+    struct PendingBlock {
+        uint64_t file_pos;
+        FlatFilePos pos;
+        uint256 hash;
+        std::vector<unsigned char> data;
+        std::shared_ptr<CBlock> block;
+    };
+    std::vector<PendingBlock> reading;
+    std::vector<PendingBlock> checking;
+    uint64_t reading_bytes{0};
+    // Blocks in reading or checking, which are known parents for the blocks after them.
+    // A block can be there more than once, if another copy of it is read before the first
+    // is checked.
+    std::unordered_multiset<uint256, BlockHasher> pending_hashes;
+    std::optional<CCheckQueueControl<CBlockLoadCheck>> control;
+
     int nLoaded = 0;
+
+    // Everything that follows having a block: activating genesis, and loading
+    // earlier encountered successors. Returns false if loading has to stop.
+    const auto process_successors{[&](const uint256& hash) {
+        // Activate the genesis block so normal node progress can continue
+        if (hash == params.GetConsensus().hashGenesisBlock) {
+            BlockValidationState state;
+            if (!ActivateBestChain(state, nullptr)) {
+                return false;
+            }
+        }
+
+        NotifyHeaderTip(*this);
+
+        if (!blocks_with_unknown_parent) return true;
+
+        // Recursively process earlier encountered successors of this block
+        std::deque<uint256> queue;
+        queue.push_back(hash);
+        while (!queue.empty()) {
+            uint256 head = queue.front();
+            queue.pop_front();
+            auto range = blocks_with_unknown_parent->equal_range(head);
+            while (range.first != range.second) {
+                std::multimap<uint256, FlatFilePos>::iterator it = range.first;
+                std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
+                if (ReadBlockFromDisk(*pblockrecursive, it->second, params.GetConsensus())) {
+                    LogPrint(BCLog::REINDEX, "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
+                            head.ToString());
+                    LOCK(cs_main);
+                    BlockValidationState dummy;
+                    if (AcceptBlock(pblockrecursive, dummy, nullptr, true, &it->second, nullptr, true)) {
+                        nLoaded++;
+                        queue.push_back(pblockrecursive->GetHash());
+                    }
+                }
+                range.first++;
+                blocks_with_unknown_parent->erase(it);
+                NotifyHeaderTip(*this);
+            }
+        }
+        return true;
+    }};
+
+    // Wait for the batch being checked, start checking the batch just read,
+    // and accept the checked blocks meanwhile. Returns false if loading has to stop.
+    const auto advance{[&]() {
+        control.reset();
+        std::vector<PendingBlock> ready;
+        ready.swap(checking);
+        checking.swap(reading);
+        reading_bytes = 0;
+
+        std::vector<CBlockLoadCheck> checks;
+        for (PendingBlock& pending : checking) {
+            CBlockLoadCheck check{pending.data, pending.block, params.GetConsensus()};
+            if (!blockloadcheckqueue.HasThreads()) {
+                check();
+                continue;
+            }
+            checks.emplace_back();
+            check.swap(checks.back());
+        }
+        control.emplace(blockloadcheckqueue.HasThreads() ? &blockloadcheckqueue : nullptr);
+        control->Add(checks);
+
+        for (PendingBlock& pending : ready) {
+            pending_hashes.erase(pending_hashes.find(pending.hash));
+            if (!pending.block) {
+                LogPrint(BCLog::REINDEX, "%s: unexpected data at file offset 0x%x - block does not deserialize. continuing\n", __func__, pending.file_pos);
+                continue;
+            }
+            try {
+                LOCK(cs_main);
+                // An earlier copy of this block may have loaded since it was read
+                const CBlockIndex* pindex{m_blockman.LookupBlockIndex(pending.hash)};
+                if (pindex && (pindex->nStatus & BLOCK_HAVE_DATA)) continue;
+                // The parent was read before this block, but may have failed to load
+                if (pending.hash != params.GetConsensus().hashGenesisBlock && !m_blockman.LookupBlockIndex(pending.block->hashPrevBlock)) {
+                    LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__, pending.hash.ToString(),
+                             pending.block->hashPrevBlock.ToString());
+                    if (blocks_with_unknown_parent) {
+                        blocks_with_unknown_parent->emplace(pending.block->hashPrevBlock, pending.pos);
+                    }
+                    continue;
+                }
+                BlockValidationState state;
+                if (AcceptBlock(pending.block, state, nullptr, true, dbp ? &pending.pos : nullptr, nullptr, true)) {
+                    nLoaded++;
+                }
+                if (state.IsError()) {
+                    return false;
+                }
+            } catch (const std::exception& e) {
+                LogPrint(BCLog::REINDEX, "%s: unexpected data at file offset 0x%x - %s. continuing\n", __func__, pending.file_pos, e.what());
+                continue;
+            }
+            if (!process_successors(pending.hash)) {
+                return false;
+            }
+        }
+        return true;
+    }};
+
     try {
         // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
         CBufferedFile blkdat(fileIn, 2*MAX_BLOCK_SERIALIZED_SIZE, MAX_BLOCK_SERIALIZED_SIZE+8, SER_DISK, CLIENT_VERSION);
         // nRewind indicates where to resume scanning in case something goes wrong,
         // such as a block fails to deserialize.
         uint64_t nRewind = blkdat.GetPos();
+        bool stopped{false};
         while (!blkdat.eof()) {
             if (ShutdownRequested()) return;
 
+            if (reading_bytes >= batch_bytes && !advance()) {
+                stopped = true;
+                break;
+            }
+
             blkdat.SetPos(nRewind);
             nRewind++; // start one byte further next time, in case of failure
             blkdat.SetLimit(); // remove former limit
@@ -4485,7 +4883,8 @@ void Chainstate::LoadExternalBlockFile(
                 {
                     LOCK(cs_main);
                     // detect out of order blocks, and store them for later
-                    if (hash != params.GetConsensus().hashGenesisBlock && !m_blockman.LookupBlockIndex(header.hashPrevBlock)) {
+                    if (hash != params.GetConsensus().hashGenesisBlock && !pending_hashes.count(header.hashPrevBlock) &&
+                        !m_blockman.LookupBlockIndex(header.hashPrevBlock)) {
                         LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
                                  header.hashPrevBlock.ToString());
                         if (dbp && blocks_with_unknown_parent) {
@@ -4497,60 +4896,24 @@ void Chainstate::LoadExternalBlockFile(
                     // process in case the block isn't known yet
                     const CBlockIndex* pindex = m_blockman.LookupBlockIndex(hash);
                     if (!pindex || (pindex->nStatus & BLOCK_HAVE_DATA) == 0) {
-                        // This block can be processed immediately; rewind to its start, read and deserialize it.
+                        // This block can be processed; rewind to its start and read it out for the next stages.
+                        // Another copy of it may already be on its way, but that one may turn out not to
+                        // deserialize or check, so which copy is loaded is only decided once both are checked.
+                        pending_hashes.insert(hash);
                         blkdat.SetPos(nBlockPos);
-                        std::shared_ptr<CBlock> pblock{std::make_shared<CBlock>()};
-                        blkdat >> *pblock;
-                        nRewind = blkdat.GetPos();
-
-                        BlockValidationState state;
-                        if (AcceptBlock(pblock, state, nullptr, true, dbp, nullptr, true)) {
-                            nLoaded++;
-                        }
-                        if (state.IsError()) {
-                            break;
-                        }
+                        std::vector<unsigned char> data(nSize);
+                        blkdat.read(MakeWritableByteSpan(data));
+                        reading.push_back({nBlockPos, dbp ? *dbp : FlatFilePos{}, hash, std::move(data), nullptr});
+                        reading_bytes += nSize;
+                        continue;
                     } else if (hash != params.GetConsensus().hashGenesisBlock && pindex->nHeight % 1000 == 0) {
                         LogPrint(BCLog::REINDEX, "Block Import: already had block %s at height %d\n", hash.ToString(), pindex->nHeight);
                     }
                 }
 
-                // Activate the genesis block so normal node progress can continue
-                if (hash == params.GetConsensus().hashGenesisBlock) {
-                    BlockValidationState state;
-                    if (!ActivateBestChain(state, nullptr)) {
-                        break;
-                    }
-                }
-
-                NotifyHeaderTip(*this);
-
-                if (!blocks_with_unknown_parent) continue;
-
-                // Recursively process earlier encountered successors of this block
-                std::deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    auto range = blocks_with_unknown_parent->equal_range(head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, FlatFilePos>::iterator it = range.first;
-                        std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
-                        if (ReadBlockFromDisk(*pblockrecursive, it->second, params.GetConsensus())) {
-                            LogPrint(BCLog::REINDEX, "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
-                                    head.ToString());
-                            LOCK(cs_main);
-                            BlockValidationState dummy;
-                            if (AcceptBlock(pblockrecursive, dummy, nullptr, true, &it->second, nullptr, true)) {
-                                nLoaded++;
-                                queue.push_back(pblockrecursive->GetHash());
-                            }
-                        }
-                        range.first++;
-                        blocks_with_unknown_parent->erase(it);
-                        NotifyHeaderTip(*this);
-                    }
+                if (!process_successors(hash)) {
+                    stopped = true;
+                    break;
                 }
             } catch (const std::exception& e) {
                 // historical bugs added extra data to the block files that does not deserialize cleanly.
@@ -4567,6 +4930,8 @@ void Chainstate::LoadExternalBlockFile(
                 LogPrint(BCLog::REINDEX, "%s: unexpected data at file offset 0x%x - %s. continuing\n", __func__, (nRewind - 1), e.what());
             }
         }
+        // Check and accept the last two batches.
+        if (!stopped && advance()) advance();
     } catch (const std::runtime_error& e) {
         AbortNode(std::string("System error: ") + e.what());
     }
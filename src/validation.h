@@ -64,6 +64,10 @@ struct Params;
 static const int MAX_SCRIPTCHECK_THREADS = 15;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Maximum number of dedicated coin prefetching threads allowed */
+static const int MAX_COIN_FETCH_THREADS = 15;
+/** -coinfetchthreads default (number of coin prefetching threads, 0 = no prefetching) */
+static const int DEFAULT_COIN_FETCH_THREADS = 2;
 /** Default for -stopatheight */
 static const int DEFAULT_STOPATHEIGHT = 0;
 /** Block files containing a block-height within MIN_BLOCKS_TO_KEEP of ActiveChain().Tip() will not be pruned. */
@@ -79,6 +83,8 @@ static constexpr int DEFAULT_CHECKLEVEL{3};
 // one 128MB block file + added 15% undo data = 147MB greater for a total of 545MB
 // Setting the target to >= 550 MiB will make it likely we can respect the target.
 static const uint64_t MIN_DISK_SPACE_FOR_BLOCK_FILES = 550 * 1024 * 1024;
+/** Bytes of blocks LoadExternalBlockFile() reads out in one batch, while the batch before is checked. */
+static constexpr uint64_t DEFAULT_LOAD_BATCH_BYTES{16 << 20};
 
 /** Current sync state passed to tip changed callbacks. */
 enum class SynchronizationState {
@@ -95,11 +101,21 @@ extern uint256 g_best_block;
 /** Documentation for argument 'checklevel'. */
 extern const std::vector<std::string> CHECKLEVEL_DOC;
 
-/** Run instances of script checking worker threads */
+/** Run instances of script checking, header PoW checking and block file loading worker threads */
 void StartScriptCheckWorkerThreads(int threads_num);
-/** Stop all of the script checking worker threads */
+/** Run the worker threads of PrefetchBlockInputs() */
+void StartCoinFetchWorkerThreads(int threads_num);
+/** Stop all of the script checking, header PoW checking, block file loading and coin prefetching worker threads */
 void StopScriptCheckWorkerThreads();
 
+/**
+ * Read the coins spent by block that are neither in cache nor created by the
+ * block itself from db, spread over the worker threads, and add them to cache
+ * so that connecting the block finds them there. Does nothing without worker
+ * threads. Returns the number of coins added.
+ */
+size_t PrefetchBlockInputs(const CBlock& block, CCoinsViewCache& cache, const CCoinsView& db);
+
 CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams);
 
 bool AbortNode(BlockValidationState& state, const std::string& strMessage, const bilingual_str& userMessage = bilingual_str{});
@@ -343,8 +359,22 @@ bool TestBlockValidity(BlockValidationState& state,
                        bool fCheckPOW = true,
                        bool fCheckMerkleRoot = true) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
-/** Check with the proof of work on each blockheader matches the value in nBits */
-bool HasValidProofOfWork(const std::vector<CBlockHeader>& headers, const Consensus::Params& consensusParams);
+/**
+ * Return the position of the first header whose proof of work does not match
+ * the value in nBits, or the number of headers if all of them do.
+ * The headers are hashed on the PoW check threads when there are enough of them.
+ */
+size_t FindInvalidProofOfWork(const std::vector<CBlockHeader>& headers, const Consensus::Params& consensusParams);
+
+/**
+ * Checks of a batch of consecutive headers that are cheap next to their proof
+ * of work, so they can be done first: no header is too far in the future, and
+ * each one's timestamp is above the median time past of the blocks before it.
+ * If prev, the parent of the first header, is given, the nBits transitions are
+ * also checked and the median time past is known for every header.
+ */
+bool PreCheckHeaders(const std::vector<CBlockHeader>& headers, const CBlockIndex* prev, const Consensus::Params& consensusParams,
+                     NodeClock::time_point now, BlockValidationState& state) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
 /** Return the sum of the work on a given set of headers */
 arith_uint256 CalculateHeadersWork(const std::vector<CBlockHeader>& headers);
@@ -408,7 +438,7 @@ public:
     //! state to disk, which should not be done until the health of the database is verified.
     //!
     //! All arguments forwarded onto CCoinsViewDB.
-    CoinsViews(fs::path ldb_name, size_t cache_size_bytes, bool in_memory, bool should_wipe);
+    CoinsViews(fs::path ldb_name, size_t cache_size_bytes, bool in_memory, bool should_wipe, bool write_behind = false);
 
     //! Initialize the CCoinsViewCache member.
     void InitCache() EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
@@ -598,17 +628,21 @@ public:
      * This function can also be used to read blocks from user-specified block files using the
      * -loadblock= option. There's no unknown-parent tracking, so the last two arguments are omitted.
      *
+     * Blocks are read out in batches and deserialized and checked with CheckBlock() on block file
+     * loading worker threads, while this thread accepts the previous batch in file order.
      *
      * @param[in]     fileIn                        FILE handle to file containing blocks to read
      * @param[in]     dbp                           (optional) Disk block position (only for reindex)
      * @param[in,out] blocks_with_unknown_parent    (optional) Map of disk positions for blocks with
      *                                              unknown parent, key is parent block hash
      *                                              (only used for reindex)
+     * @param[in]     batch_bytes                   Bytes of blocks read out in one batch
      * */
     void LoadExternalBlockFile(
         FILE* fileIn,
         FlatFilePos* dbp = nullptr,
-        std::multimap<uint256, FlatFilePos>* blocks_with_unknown_parent = nullptr)
+        std::multimap<uint256, FlatFilePos>* blocks_with_unknown_parent = nullptr,
+        uint64_t batch_bytes = DEFAULT_LOAD_BATCH_BYTES)
         EXCLUSIVE_LOCKS_REQUIRED(!m_chainstate_mutex);
 
     /**
@@ -719,9 +753,12 @@ public:
     //! @return the state of the size of the coins cache.
     CoinsCacheSizeState GetCoinsCacheSizeState() EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
 
+    //! @param[in] count_pending_write Whether the coins of the write in flight
+    //!                                to the coin database count as well.
     CoinsCacheSizeState GetCoinsCacheSizeState(
         size_t max_coins_cache_size_bytes,
-        size_t max_mempool_size_bytes) EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+        size_t max_mempool_size_bytes,
+        bool count_pending_write = true) EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
 
     std::string ToString() EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
 
@@ -858,12 +895,14 @@ private:
      * Caller must set min_pow_checked=true in order to add a new header to the
      * block index (permanent memory storage), indicating that the header is
      * known to be part of a sufficiently high-work chain (anti-dos check).
+     * Pass check_pow=false only if the header's proof of work was already verified.
      */
     bool AcceptBlockHeader(
         const CBlockHeader& block,
         BlockValidationState& state,
         CBlockIndex** ppindex,
-        bool min_pow_checked) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+        bool min_pow_checked,
+        bool check_pow = true) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     friend Chainstate;
 
     /** Most recent headers presync progress update, for rate-limiting. */
@@ -1008,6 +1047,14 @@ public:
      */
     bool ProcessNewBlock(const std::shared_ptr<const CBlock>& block, bool force_processing, bool min_pow_checked, bool* new_block) LOCKS_EXCLUDED(cs_main);
 
+    /**
+     * Check the proof of work of those headers that are not in the block index
+     * yet, spread over the PoW check threads when there are enough of them.
+     * Returns the position of the first one that fails, or the number of
+     * headers if none does.
+     */
+    size_t CheckNewHeadersPoW(const std::vector<CBlockHeader>& headers) LOCKS_EXCLUDED(cs_main);
+
     /**
      * Process incoming block headers.
      *
@@ -39,7 +39,6 @@ namespace Consensus {
 struct Params;
 }
 
-using node::ReadBlockFromDisk;
 
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
 
@@ -247,15 +246,14 @@ bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
 {
     LogPrint(BCLog::ZMQ, "Publish rawblock %s to %s\n", pindex->GetBlockHash().GetHex(), this->address);
 
-    const Consensus::Params& consensusParams = Params().GetConsensus();
     CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-    CBlock block;
-    if (!ReadBlockFromDisk(block, pindex, consensusParams)) {
+    const std::shared_ptr<const CBlock> block{m_get_block_by_index(*pindex)};
+    if (!block) {
         zmqError("Can't read block from disk");
         return false;
     }
 
-    ss << block;
+    ss << *block;
 
     return SendZmqMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());
 }
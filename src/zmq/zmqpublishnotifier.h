@@ -9,7 +9,10 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <memory>
 
+class CBlock;
 class CBlockIndex;
 class CTransaction;
 
@@ -46,7 +49,12 @@ public:
 
 class CZMQPublishRawBlockNotifier : public CZMQAbstractPublishNotifier
 {
+private:
+    const std::function<std::shared_ptr<const CBlock>(const CBlockIndex&)> m_get_block_by_index;
+
 public:
+    explicit CZMQPublishRawBlockNotifier(std::function<std::shared_ptr<const CBlock>(const CBlockIndex&)> get_block_by_index)
+        : m_get_block_by_index{std::move(get_block_by_index)} {}
     bool NotifyBlock(const CBlockIndex *pindex) override;
 };
 
@@ -10,6 +10,7 @@
 
 import copy
 from decimal import Decimal
+import time
 
 from test_framework.blocktools import (
     create_coinbase,
@@ -18,6 +19,7 @@ from test_framework.blocktools import (
     TIME_GENESIS_BLOCK,
 )
 from test_framework.messages import (
+    COIN,
     CBlock,
     CBlockHeader,
     BLOCK_HEADER_SIZE,
@@ -73,6 +75,52 @@ class MiningTest(BitcoinTestFramework):
         self.restart_node(0)
         self.connect_nodes(0, 1)
 
+    def test_template_cache(self):
+        node = self.nodes[0]
+        t = int(time.time())
+        node.setmocktime(t)
+        tmpl = node.getblocktemplate(NORMAL_GBT_REQUEST_PARAMS)
+
+        self.log.info("getblocktemplate: Test that a repeated call only refreshes the time")
+        node.setmocktime(t + 1)
+        cached = node.getblocktemplate(NORMAL_GBT_REQUEST_PARAMS)
+        assert_equal(cached['curtime'], t + 1)
+        assert_equal(cached, {**tmpl, 'curtime': t + 1})
+
+        self.log.info("getblocktemplate: Test that results are kept per set of rules")
+        other_rules = node.getblocktemplate({'rules': ['segwit', 'csv']})
+        assert_equal(other_rules, cached)
+        assert_equal(node.getblocktemplate(NORMAL_GBT_REQUEST_PARAMS), cached)
+
+        self.log.info("getblocktemplate: Test that the mempool is followed at most every few seconds")
+        node.setmocktime(t + 5)
+        txid1 = self.wallet.send_self_transfer(from_node=node)['txid']
+        tmpl = node.getblocktemplate(NORMAL_GBT_REQUEST_PARAMS)
+        assert_equal([tx['txid'] for tx in tmpl['transactions']], [txid1])
+        assert tmpl['longpollid'] != cached['longpollid']
+        txid2 = self.wallet.send_self_transfer(from_node=node)['txid']
+        assert_equal(node.getblocktemplate(NORMAL_GBT_REQUEST_PARAMS), tmpl)
+        node.setmocktime(t + 10)
+        tmpl = node.getblocktemplate(NORMAL_GBT_REQUEST_PARAMS)
+        assert_equal(sorted(tx['txid'] for tx in tmpl['transactions']), sorted([txid1, txid2]))
+        assert_equal(tmpl['curtime'], t + 10)
+
+        self.log.info("getblocktemplate: Test that a fee delta is picked up")
+        node.prioritisetransaction(txid=txid2, fee_delta=-COIN)
+        node.setmocktime(t + 15)
+        tmpl = node.getblocktemplate(NORMAL_GBT_REQUEST_PARAMS)
+        assert_equal([tx['txid'] for tx in tmpl['transactions']], [txid1])
+        node.prioritisetransaction(txid=txid2, fee_delta=COIN)
+
+        self.log.info("getblocktemplate: Test that a new tip is picked up at once")
+        node.setmocktime(t + 16)
+        block_hash = self.generate(node, 1, sync_fun=self.no_op)[0]
+        tmpl = node.getblocktemplate(NORMAL_GBT_REQUEST_PARAMS)
+        assert_equal(tmpl['previousblockhash'], block_hash)
+        assert_equal(tmpl['transactions'], [])
+        assert_equal(tmpl['mintime'], node.getblockheader(block_hash)['mediantime'] + 1)
+        node.setmocktime(0)
+
     def run_test(self):
         node = self.nodes[0]
         self.wallet = MiniWallet(node)
@@ -278,6 +326,8 @@ class MiningTest(BitcoinTestFramework):
         node.submitheader(hexdata=CBlockHeader(bad_block_root).serialize().hex())
         assert_equal(node.submitblock(hexdata=block.serialize().hex()), 'duplicate')  # valid
 
+        self.test_template_cache()
+
 
 if __name__ == '__main__':
     MiningTest().main()